@@ -1,14 +1,387 @@
+#define _POSIX_C_SOURCE 200112L
 #include "runtime.h"
+#include <pthread.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 /*******************************************
  * Memory allocation functions
+ *
+ * Small objects are cut from SlabSize
+ * pages, one size class to a slab, so list
+ * and tree nodes stay packed together, and
+ * dispose puts them on a free list for the
+ * class. The compiler works out the class
+ * from the type, as (size - 1) / 16, or -1
+ * for anything else, which goes to malloc.
+ *
+ * Between Mark and Release, new allocates
+ * from a region instead, see below. The
+ * compiler also passes where new is called
+ * from, for the heap profiler.
  *******************************************
  */
-void *__new(int size) {
-    return malloc(size);
+enum {
+    SizeClassStep = 16,
+    SizeClasses = 16,
+    NoSizeClass = -1,
+    RegionClass = -2,
+    SlabSize = 65536,
+    /* The slab header takes this much of the slab, to keep objects aligned. */
+    SlabHeaderSize = SizeClassStep,
+};
+
+struct FreeObject {
+    struct FreeObject *next;
+};
+
+struct SizeClass {
+    struct FreeObject *freeList;
+    /* Not yet used part of the newest slab. */
+    char *next;
+    char *end;
+};
+
+struct Slab {
+    int sizeClass;
+};
+
+/* A chunk of a region, with the objects following the header. */
+struct RegionChunk {
+    struct Slab         slab;
+    struct RegionChunk *prev;
+    size_t              size;
+};
+
+#define RegionHeaderSize ((sizeof(struct RegionChunk) + SizeClassStep - 1) & -SizeClassStep)
+
+struct Mark {
+    char * pos;
+    size_t profileMark;
+};
+
+struct Region {
+    /* Newest first. */
+    struct RegionChunk *chunks;
+    /* Not yet used part of the newest chunk, NULL if that is a large object. */
+    char *next;
+    char *end;
+    /* Chunks left from Release, to use again. */
+    struct RegionChunk *spare;
+    int                 spareCount;
+    /* The marks not released yet, oldest first. */
+    struct Mark *marks;
+    int          markCount;
+    int          markSize;
+};
+
+/* Each thread has its own free lists, so allocating needs no lock. */
+static __thread struct SizeClass sizeClasses[SizeClasses];
+static __thread struct Region    region;
+static int                       systemMalloc;
+static int                       heapProfile;
+
+/*******************************************
+ * The set of slabs, used to find out if a
+ * pointer of unknown class is in a slab.
+ *******************************************
+ */
+static pthread_mutex_t slabLock = PTHREAD_MUTEX_INITIALIZER;
+static uintptr_t *     slabSet;
+static size_t          slabSetSize;
+static size_t          slabCount;
+
+static size_t SlabHash(uintptr_t base, size_t size) {
+    return (base / SlabSize * 0x9E3779B97F4A7C15ull) & (size - 1);
+}
+
+static void SlabSetInsert(uintptr_t *set, size_t size, uintptr_t base) {
+    size_t i = SlabHash(base, size);
+    while (set[i]) {
+        i = (i + 1) & (size - 1);
+    }
+    set[i] = base;
+}
+
+static void AddSlab(uintptr_t base) {
+    pthread_mutex_lock(&slabLock);
+    if (2 * (slabCount + 1) > slabSetSize) {
+        size_t     size = (slabSetSize) ? 2 * slabSetSize : 256;
+        uintptr_t *set = calloc(size, sizeof(*set));
+        if (!set) {
+            fprintf(stderr, "Out of memory\n");
+            exit(11);
+        }
+        for (size_t i = 0; i < slabSetSize; i++) {
+            if (slabSet[i]) {
+                SlabSetInsert(set, size, slabSet[i]);
+            }
+        }
+        free(slabSet);
+        slabSet = set;
+        slabSetSize = size;
+    }
+    SlabSetInsert(slabSet, slabSetSize, base);
+    slabCount++;
+    pthread_mutex_unlock(&slabLock);
+}
+
+static void RemoveSlab(uintptr_t base) {
+    pthread_mutex_lock(&slabLock);
+    size_t mask = slabSetSize - 1;
+    size_t i = SlabHash(base, slabSetSize);
+    while (slabSet[i] != base) {
+        i = (i + 1) & mask;
+    }
+    /* Move up any later entries that would no longer be found past the gap. */
+    for (size_t j = (i + 1) & mask; slabSet[j]; j = (j + 1) & mask) {
+        size_t h = SlabHash(slabSet[j], slabSetSize);
+        if (((j - h) & mask) >= ((j - i) & mask)) {
+            slabSet[i] = slabSet[j];
+            i = j;
+        }
+    }
+    slabSet[i] = 0;
+    slabCount--;
+    pthread_mutex_unlock(&slabLock);
+}
+
+static struct Slab *FindSlab(void *ptr) {
+    uintptr_t    base = (uintptr_t)ptr & ~(uintptr_t)(SlabSize - 1);
+    struct Slab *slab = NULL;
+    pthread_mutex_lock(&slabLock);
+    if (slabSetSize) {
+        for (size_t i = SlabHash(base, slabSetSize); slabSet[i]; i = (i + 1) & (slabSetSize - 1)) {
+            if (slabSet[i] == base) {
+                slab = (struct Slab *)base;
+                break;
+            }
+        }
+    }
+    pthread_mutex_unlock(&slabLock);
+    return slab;
+}
+
+/*******************************************
+ * Allocation
+ *******************************************
+ */
+void InitAlloc() {
+    /* For comparing against the C library. */
+    const char *s = getenv("LACSAP_SYSTEM_MALLOC");
+    systemMalloc = s && *s && strcmp(s, "0");
+    heapProfile = __profile_init();
+}
+
+static void *OutOfMemory(void) {
+    fprintf(stderr, "Out of memory\n");
+    exit(11);
+}
+
+static void *NewSlab(struct SizeClass *c, int sizeClass) {
+    void *mem;
+    if (posix_memalign(&mem, SlabSize, SlabSize)) {
+        return OutOfMemory();
+    }
+    struct Slab *slab = mem;
+    size_t       size = (sizeClass + 1) * SizeClassStep;
+    slab->sizeClass = sizeClass;
+    AddSlab((uintptr_t)slab);
+    c->next = (char *)slab + SlabHeaderSize + size;
+    c->end = (char *)slab + SlabHeaderSize + (SlabSize - SlabHeaderSize) / size * size;
+    return (char *)slab + SlabHeaderSize;
+}
+
+static void *SystemNew(size_t size) {
+    void *p = malloc(size);
+    return (p || !size) ? p : OutOfMemory();
+}
+
+static void *RegionNew(size_t size);
+
+/* With LACSAP_SYSTEM_MALLOC, regions aren't used either, and Release frees nothing. */
+static inline void *Allocate(int size, int sizeClass) {
+    if (systemMalloc) {
+        return SystemNew(size);
+    }
+    if (region.markCount) {
+        return RegionNew(size);
+    }
+    if (sizeClass == NoSizeClass) {
+        return SystemNew(size);
+    }
+    struct SizeClass * c = &sizeClasses[sizeClass];
+    struct FreeObject *p = c->freeList;
+    if (p) {
+        c->freeList = p->next;
+        return p;
+    }
+    if (c->next != c->end) {
+        void *q = c->next;
+        c->next += (sizeClass + 1) * SizeClassStep;
+        return q;
+    }
+    return NewSlab(c, sizeClass);
+}
+
+void *__new(int size, int sizeClass, const char *site) {
+    void *p = Allocate(size, sizeClass);
+    if (heapProfile) {
+        __profile_new(p, size, site, region.markCount && !systemMalloc);
+    }
+    return p;
+}
+
+/* The class is that of the pointer type, which may not be what was allocated for classes
+ * and untyped pointers, so those come here as NoSizeClass and the slab says what it is.
+ * Objects in a region are left until Release.
+ */
+void __dispose(void *ptr, int sizeClass) {
+    if (!ptr) {
+        return;
+    }
+    if (heapProfile) {
+        __profile_dispose(ptr);
+    }
+    if (systemMalloc) {
+        free(ptr);
+        return;
+    }
+    if (sizeClass == NoSizeClass) {
+        struct Slab *slab = FindSlab(ptr);
+        if (!slab) {
+            free(ptr);
+            return;
+        }
+        sizeClass = slab->sizeClass;
+    } else {
+        /* Small objects are always in the first SlabSize of a slab or chunk. */
+        sizeClass = ((struct Slab *)((uintptr_t)ptr & ~(uintptr_t)(SlabSize - 1)))->sizeClass;
+    }
+    if (sizeClass == RegionClass) {
+        return;
+    }
+    struct FreeObject *p = ptr;
+    p->next = sizeClasses[sizeClass].freeList;
+    sizeClasses[sizeClass].freeList = p;
+}
+
+/*******************************************
+ * Regions: Mark and Release.
+ *
+ * Mark gives the current end of the region,
+ * and from then on new takes objects from
+ * the region by moving that along. Release
+ * goes back to a mark, dropping everything
+ * allocated since then in one go, and new
+ * goes back to normal when the first mark
+ * is released. The region is made of chunks,
+ * SlabSize ones for small objects and one
+ * each for the large ones.
+ *******************************************
+ */
+enum {
+    MaxSpareChunks = 16,
+};
+
+static struct RegionChunk *NewChunk(size_t size) {
+    void *mem;
+    if (posix_memalign(&mem, SlabSize, size)) {
+        return OutOfMemory();
+    }
+    struct RegionChunk *chunk = mem;
+    chunk->slab.sizeClass = RegionClass;
+    chunk->size = size;
+    AddSlab((uintptr_t)chunk);
+    return chunk;
+}
+
+static void FreeChunk(struct RegionChunk *chunk) {
+    if (chunk->size == SlabSize && region.spareCount < MaxSpareChunks) {
+        chunk->prev = region.spare;
+        region.spare = chunk;
+        region.spareCount++;
+        return;
+    }
+    RemoveSlab((uintptr_t)chunk);
+    free(chunk);
+}
+
+static void PushChunk(struct RegionChunk *chunk) {
+    chunk->prev = region.chunks;
+    region.chunks = chunk;
+}
+
+static void StartChunk(void) {
+    struct RegionChunk *chunk = region.spare;
+    if (chunk) {
+        region.spare = chunk->prev;
+        region.spareCount--;
+    } else {
+        chunk = NewChunk(SlabSize);
+    }
+    PushChunk(chunk);
+    region.next = (char *)chunk + RegionHeaderSize;
+    region.end = (char *)chunk + SlabSize;
+}
+
+static void *RegionNew(size_t size) {
+    size = (size + SizeClassStep - 1) & -SizeClassStep;
+    if (size > SlabSize - RegionHeaderSize) {
+        /* Small objects after this go in a new chunk, to keep the chunks in order. */
+        struct RegionChunk *chunk = NewChunk(RegionHeaderSize + size);
+        PushChunk(chunk);
+        region.next = region.end = NULL;
+        return (char *)chunk + RegionHeaderSize;
+    }
+    if (!region.next || (size_t)(region.end - region.next) < size) {
+        StartChunk();
+    }
+    void *p = region.next;
+    region.next += size;
+    return p;
+}
+
+void *__mark(void) {
+    if (!region.next) {
+        StartChunk();
+    }
+    if (region.markCount == region.markSize) {
+        region.markSize = (region.markSize) ? 2 * region.markSize : 16;
+        region.marks = realloc(region.marks, region.markSize * sizeof(*region.marks));
+        if (!region.marks) {
+            OutOfMemory();
+        }
+    }
+    region.marks[region.markCount].pos = region.next;
+    region.marks[region.markCount].profileMark = (heapProfile) ? __profile_mark() : 0;
+    region.markCount++;
+    return region.next;
 }
 
-void __dispose(void *ptr) {
-    free(ptr);
+/* Release also drops any marks made after the one given. */
+void __release(void *mark) {
+    int i = region.markCount - 1;
+    while (i >= 0 && region.marks[i].pos != mark) {
+        i--;
+    }
+    if (i < 0) {
+        fprintf(stderr, "Release without Mark\n");
+        exit(11);
+    }
+    region.markCount = i;
+    if (heapProfile) {
+        __profile_release(region.marks[i].profileMark);
+    }
+    /* The mark may be the very end of its chunk. */
+    struct RegionChunk *chunk =
+        (struct RegionChunk *)(((uintptr_t)mark - 1) & ~(uintptr_t)(SlabSize - 1));
+    while (region.chunks != chunk) {
+        struct RegionChunk *prev = region.chunks->prev;
+        FreeChunk(region.chunks);
+        region.chunks = prev;
+    }
+    region.next = mark;
+    region.end = (char *)chunk + SlabSize;
 }
@@ -2,25 +2,110 @@
 #define __USE_POSIX 1
 #include "runtime.h"
 #include <limits.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 
-struct FileEntry files[MaxPascalFiles] = {};
+struct FileEntry *fileChunks[MaxFileChunks];
+
+/*******************************************
+ * File table
+ *
+ * Entries are handed out from a free list,
+ * and a new chunk is added when that is
+ * empty. The lock covers the free list and
+ * adding chunks; an entry belongs to the
+ * file that has it.
+ *******************************************
+ */
+static pthread_mutex_t tableLock = PTHREAD_MUTEX_INITIALIZER;
+static int             freeList = -1;
+static int             fileCount = 0;
+
+static struct FileEntry *Entry(int handle) {
+    return &fileChunks[handle / FileChunkSize][handle % FileChunkSize];
+}
+
+static int NewEntry(File *f) {
+    pthread_mutex_lock(&tableLock);
+    int h = freeList;
+    if (h >= 0) {
+        freeList = Entry(h)->nextFree;
+    } else {
+        h = fileCount;
+        if (!fileChunks[h / FileChunkSize]) {
+            if (h / FileChunkSize == MaxFileChunks) {
+                fprintf(stderr, "No free files... Exiting\n");
+                exit(1);
+            }
+            fileChunks[h / FileChunkSize] = calloc(FileChunkSize, sizeof(struct FileEntry));
+            if (!fileChunks[h / FileChunkSize]) {
+                fprintf(stderr, "Out of memory for file table\n");
+                exit(11);
+            }
+        }
+        fileCount++;
+    }
+    struct FileEntry *e = Entry(h);
+    e->inUse = 1;
+    e->fileData = f;
+    pthread_mutex_unlock(&tableLock);
+    return h;
+}
+
+/* Give the entry of a closed file back to the table. Unnamed files are deleted. */
+void __release_file(File *f) {
+    struct FileEntry *e = fileEntry(f);
+    if (e->temporary) {
+        remove(e->name);
+    }
+    free(e->name);
+    free(e->readBuffer);
+    free(e->writeBuffer);
+    memset(e, 0, sizeof(*e));
+    pthread_mutex_lock(&tableLock);
+    e->nextFree = freeList;
+    freeList = f->handle;
+    pthread_mutex_unlock(&tableLock);
+    f->handle = 0;
+}
 
 /*******************************************
  * InitFiles
  *******************************************
  */
+/* Write out what is left in the record buffers when the program ends. */
+static void FlushFiles(void) {
+    for (int i = 0; i < fileCount; i++) {
+        struct FileEntry *e = Entry(i);
+        if (e->inUse && e->file) {
+            __async_stop(e);
+            __flush_records(e);
+        }
+        if (e->inUse && e->temporary) {
+            if (e->file) {
+                fclose(e->file);
+                e->file = NULL;
+            }
+            remove(e->name);
+        }
+    }
+}
+
 void InitFiles() {
+    atexit(FlushFiles);
     __assign(&input, "INPUT");
     __assign(&output, "OUTPUT");
 
     SetupFile(&input, 1, 1 | (2 * (!!isatty(fileno(stdin)))));
     SetupFile(&output, 1, 1);
 
-    files[input.handle].file = stdin;
-    files[output.handle].file = stdout;
+    fileEntry(&input)->file = stdin;
+    fileEntry(&output)->file = stdout;
+    if (!(input.isText & 2)) {
+        AdviseSequential(stdin);
+    }
 }
 
 /*******************************************
@@ -28,48 +113,66 @@ void InitFiles() {
  *******************************************
  */
 void SetupFile(File *f, int recSize, int isText) {
-    f->recordSize = (isText) ? 1024 : recSize;
+    f->recordSize = (isText) ? 1 : recSize;
     f->isText = isText;
     f->buffer = malloc(f->recordSize);
-    files[f->handle].readPos = 0;
-    files[f->handle].bufferSize = 0;
-    files[f->handle].readAhead = 0;
+    struct FileEntry *e = fileEntry(f);
+    e->readPos = e->readBuffer;
+    e->readEnd = e->readBuffer;
+    e->writePos = e->writeBuffer;
+    e->readAhead = 0;
 }
 
 /*******************************************
  * File assign
  *******************************************
  */
+/* Assigning a file variable again reuses its entry, so a program can go through any number
+ * of files with one variable.
+ */
+static int OwnEntry(File *f) {
+    return validFile(f) && fileEntry(f)->fileData == f;
+}
+
+static void AssignName(File *f, const char *name, int temporary) {
+    struct FileEntry *e = fileEntry(f);
+    free(e->name);
+    e->name = malloc(strlen(name) + 1);
+    if (!e->name) {
+        fprintf(stderr, "Out of memory for file name\n");
+        exit(11);
+    }
+    strcpy(e->name, name);
+    e->temporary = temporary;
+    e->readAhead = 0;
+}
+
 void __assign(File *f, char *name) {
-    int i;
-    for (i = 0; i < MaxPascalFiles && files[i].inUse; i++)
-        ;
-    if (i == MaxPascalFiles) {
-        fprintf(stderr, "No free files... Exiting\n");
-        exit(1);
+    if (OwnEntry(f) && fileEntry(f)->file) {
+        __close(f);
+    }
+    if (OwnEntry(f) && fileEntry(f)->temporary) {
+        __release_file(f);
+    }
+    if (!OwnEntry(f)) {
+        f->handle = NewEntry(f);
     }
-    f->handle = i;
-    files[i].inUse = 1;
-    files[i].name = malloc(strlen(name) + 1);
-    files[i].fileData = f;
-    files[i].readAhead = 0;
-    strcpy(files[i].name, name);
+    AssignName(f, name, 0);
 }
 
 /*******************************************
  * File assign for unnamed file
+ *
+ * The name is made from the process id and
+ * the handle, so it is unique while the file
+ * exists; it is deleted on close or exit.
  *******************************************
  */
 void __assign_unnamed(File *f) {
-    char       name[] = "lacsap_tmp_file_NNNNNN";
-    static int n = 0;
-    n++;
-    n %= MaxPascalFiles;
-    size_t pos = strlen(name) - 1;
-    for (int i = 0; i < 6; i++) {
-        name[pos] = '0' + (n % 10);
-        n /= 10;
-        pos--;
+    char name[64];
+    if (!OwnEntry(f)) {
+        f->handle = NewEntry(f);
     }
-    __assign(f, name);
+    snprintf(name, sizeof(name), "lacsap_tmp_file_%ld_%d", (long)getpid(), f->handle);
+    AssignName(f, name, 1);
 }
@@ -0,0 +1,247 @@
+#define _POSIX_C_SOURCE 200112L
+#include "runtime.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+/*******************************************
+ * Background file I/O.
+ *
+ * A helper thread reads ahead into, or writes
+ * out from, one of two buffers while the
+ * program works on the other. Used for files
+ * given to AsyncFile, or all files opened by
+ * reset, rewrite and append when LACSAP_ASYNC_IO
+ * is set in the environment.
+ *******************************************
+ */
+enum {
+    AsyncBuffers = 2,
+};
+
+enum BufferState {
+    BS_Free,
+    BS_Full,
+};
+
+struct AsyncIO {
+    pthread_t       thread;
+    pthread_mutex_t lock;
+    pthread_cond_t  changed;
+    FILE *          file;
+    int             writing;
+    int             stop;
+    /* Reads are a whole number of units (records). */
+    size_t unit;
+    size_t size;
+    /* Each read buffer has NumberLookahead characters in front of it, so the end of the
+     * previous one can be put there. */
+    char *data[AsyncBuffers];
+    size_t len[AsyncBuffers];
+    off_t  offset[AsyncBuffers];
+    int    state[AsyncBuffers];
+    /* The buffer the program is using, -1 for none yet. */
+    int   current;
+    off_t start;
+};
+
+static void *ReadAhead(void *arg) {
+    struct AsyncIO *a = arg;
+    for (int i = 0;; i = (i + 1) % AsyncBuffers) {
+        pthread_mutex_lock(&a->lock);
+        while (a->state[i] != BS_Free && !a->stop) {
+            pthread_cond_wait(&a->changed, &a->lock);
+        }
+        int stop = a->stop;
+        pthread_mutex_unlock(&a->lock);
+        if (stop) {
+            break;
+        }
+        off_t  where = ftello(a->file);
+        size_t n = fread(a->data[i], a->unit, a->size / a->unit, a->file) * a->unit;
+        pthread_mutex_lock(&a->lock);
+        a->len[i] = n;
+        a->offset[i] = where;
+        a->state[i] = BS_Full;
+        pthread_cond_broadcast(&a->changed);
+        pthread_mutex_unlock(&a->lock);
+        if (!n) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+static void *WriteBehind(void *arg) {
+    struct AsyncIO *a = arg;
+    for (int i = 0;; i = (i + 1) % AsyncBuffers) {
+        pthread_mutex_lock(&a->lock);
+        while (a->state[i] != BS_Full && !a->stop) {
+            pthread_cond_wait(&a->changed, &a->lock);
+        }
+        int full = a->state[i] == BS_Full;
+        pthread_mutex_unlock(&a->lock);
+        /* Buffers are handed over in order, so all the full ones are written before stopping. */
+        if (!full) {
+            break;
+        }
+        fwrite(a->data[i], 1, a->len[i], a->file);
+        pthread_mutex_lock(&a->lock);
+        a->state[i] = BS_Free;
+        pthread_cond_broadcast(&a->changed);
+        pthread_mutex_unlock(&a->lock);
+    }
+    return NULL;
+}
+
+static int AsyncFromEnvironment(void) {
+    static int fromEnv = -1;
+    if (fromEnv < 0) {
+        const char *s = getenv("LACSAP_ASYNC_IO");
+        fromEnv = s && *s && strcmp(s, "0");
+    }
+    return fromEnv;
+}
+
+/* Use background I/O for f from the next reset, rewrite or append. */
+void __async_file(File *file) {
+    if (!file->handle) {
+        __assign_unnamed(file);
+    }
+    fileEntry(file)->wantAsync = 1;
+}
+
+/* Start background I/O for a file that has just been opened. */
+void __async_start(File *file, int writing) {
+    struct FileEntry *f = fileEntry(file);
+    if (f->async || (file->isText & 2) || !(f->wantAsync || AsyncFromEnvironment())) {
+        return;
+    }
+    struct AsyncIO *a = calloc(1, sizeof(*a));
+    if (!a) {
+        return;
+    }
+    a->file = f->file;
+    a->writing = writing;
+    a->unit = file->recordSize;
+    a->size = (file->isText) ? TextBufferSize : RecordBufferSize / a->unit * a->unit;
+    if (a->size < a->unit) {
+        a->size = a->unit;
+    }
+    for (int i = 0; i < AsyncBuffers; i++) {
+        char *d = malloc(NumberLookahead + a->size);
+        if (!d) {
+            fprintf(stderr, "Out of memory for file buffer\n");
+            exit(11);
+        }
+        a->data[i] = d + NumberLookahead;
+    }
+    a->current = -1;
+    a->start = ftello(f->file);
+    pthread_mutex_init(&a->lock, NULL);
+    pthread_cond_init(&a->changed, NULL);
+    if (pthread_create(&a->thread, NULL, (writing) ? WriteBehind : ReadAhead, a)) {
+        /* Carry on without a helper thread. */
+        for (int i = 0; i < AsyncBuffers; i++) {
+            free(a->data[i] - NumberLookahead);
+        }
+        free(a);
+        return;
+    }
+    f->async = a;
+    if (writing) {
+        free(f->writeBuffer);
+        a->current = 0;
+        f->writeBuffer = f->writePos = a->data[0];
+        f->writeEnd = a->data[0] + a->size;
+    } else {
+        free(f->readBuffer);
+        f->readBuffer = f->readPos = f->readEnd = NULL;
+    }
+}
+
+/* Give the program the next buffer of input in *data, returning its length, 0 at the end of
+ * the file. The buffer the program had before is given back to the helper thread.
+ */
+size_t __async_read(struct FileEntry *f, char **data) {
+    struct AsyncIO *a = f->async;
+    if (a->current >= 0 && !a->len[a->current]) {
+        *data = a->data[a->current];
+        return 0;
+    }
+    pthread_mutex_lock(&a->lock);
+    if (a->current >= 0) {
+        a->state[a->current] = BS_Free;
+        pthread_cond_broadcast(&a->changed);
+    }
+    int next = (a->current + 1) % AsyncBuffers;
+    while (a->state[next] != BS_Full) {
+        pthread_cond_wait(&a->changed, &a->lock);
+    }
+    pthread_mutex_unlock(&a->lock);
+    a->current = next;
+    *data = a->data[next];
+    return a->len[next];
+}
+
+/* Hand the output from writeBuffer to writePos to the helper thread, and carry on in the
+ * other buffer.
+ */
+void __async_write(struct FileEntry *f) {
+    struct AsyncIO *a = f->async;
+    pthread_mutex_lock(&a->lock);
+    a->len[a->current] = f->writePos - f->writeBuffer;
+    a->state[a->current] = BS_Full;
+    pthread_cond_broadcast(&a->changed);
+    int next = (a->current + 1) % AsyncBuffers;
+    while (a->state[next] != BS_Free) {
+        pthread_cond_wait(&a->changed, &a->lock);
+    }
+    pthread_mutex_unlock(&a->lock);
+    a->current = next;
+    f->writeBuffer = f->writePos = a->data[next];
+    f->writeEnd = a->data[next] + a->size;
+}
+
+/* Finish all background I/O for f, and go back to doing it directly. All output is
+ * written, and the file is left at the position the program has read up to.
+ */
+void __async_stop(struct FileEntry *f) {
+    struct AsyncIO *a = f->async;
+    if (!a) {
+        return;
+    }
+    off_t pos = a->start;
+    if (a->writing) {
+        if (f->writePos != f->writeBuffer) {
+            pthread_mutex_lock(&a->lock);
+            a->len[a->current] = f->writePos - f->writeBuffer;
+            a->state[a->current] = BS_Full;
+            pthread_mutex_unlock(&a->lock);
+        }
+        f->writeBuffer = f->writePos = f->writeEnd = NULL;
+    } else if (a->current >= 0) {
+        /* readPos may be in front of the buffer, but that is the end of the one before. */
+        pos = a->offset[a->current] + (f->readPos - a->data[a->current]);
+    }
+    pthread_mutex_lock(&a->lock);
+    a->stop = 1;
+    pthread_cond_broadcast(&a->changed);
+    pthread_mutex_unlock(&a->lock);
+    pthread_join(a->thread, NULL);
+
+    if (a->writing) {
+        fflush(a->file);
+    } else {
+        fseeko(a->file, pos, SEEK_SET);
+        f->readBuffer = f->readPos = f->readEnd = NULL;
+    }
+    for (int i = 0; i < AsyncBuffers; i++) {
+        free(a->data[i] - NumberLookahead);
+    }
+    pthread_mutex_destroy(&a->lock);
+    pthread_cond_destroy(&a->changed);
+    free(a);
+    f->async = NULL;
+}
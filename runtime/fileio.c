@@ -1,4 +1,6 @@
+#define _POSIX_C_SOURCE 200112L
 #include "runtime.h"
+#include <fcntl.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -7,31 +9,73 @@
  *******************************************
  */
 
+/* Tell the OS the file will be read from start to end, so it can read ahead more. */
+void AdviseSequential(FILE *f) {
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(fileno(f), 0, 0, POSIX_FADV_SEQUENTIAL);
+#else
+    (void)f;
+#endif
+}
+
 static void FileError(const char *op) {
     fprintf(stderr, "Attempt to %s file failed\n", op);
     exit(1);
 }
 
+/* Write out and close the stream of f, keeping its entry for the next open. */
+static void CloseStream(File *f) {
+    struct FileEntry *e = fileEntry(f);
+    __async_stop(e);
+    __unmap_file(f);
+    __flush_records(e);
+    fclose(e->file);
+    e->file = NULL;
+}
+
 void __close(File *f) {
-    if (files[f->handle].inUse && files[f->handle].file != NULL) {
-        fclose(files[f->handle].file);
-        files[f->handle].file = NULL;
+    if (validFile(f) && fileEntry(f)->file != NULL) {
+        CloseStream(f);
+        /* An unnamed file can't be found again once closed, so it is deleted. */
+        if (fileEntry(f)->temporary) {
+            __release_file(f);
+        }
         return;
     }
     FileError("close");
 }
 
+/* A record file opened with "a+" would always be written at the end, whatever SeekWrite
+ * says, so it is opened for update instead (creating it if need be), at the end.
+ */
+static FILE *OpenStream(const char *name, const char *mode) {
+    if (strcmp(mode, "a+")) {
+        return fopen(name, mode);
+    }
+    FILE *file = fopen(name, "r+");
+    if (!file) {
+        file = fopen(name, "w+");
+    }
+    if (file) {
+        fseeko(file, 0, SEEK_END);
+    }
+    return file;
+}
+
 static void OpenFile(File *f, int recSize, int isText, const char *mode) {
     if (!f->handle) {
         __assign_unnamed(f);
     }
-    SetupFile(f, recSize, isText);
-    if (files[f->handle].inUse) {
-        if (files[f->handle].file) {
-            __close(f);
+    if (validFile(f)) {
+        struct FileEntry *e = fileEntry(f);
+        if (e->file) {
+            CloseStream(f);
         }
-        files[f->handle].file = fopen(files[f->handle].name, mode);
-        if (files[f->handle].file) {
+        SetupFile(f, recSize, isText);
+        e->file = OpenStream(e->name, mode);
+        e->writable = mode[0] != 'r';
+        if (e->file) {
+            __async_start(f, mode[0] != 'r');
             return;
         }
     }
@@ -40,13 +84,15 @@ static void OpenFile(File *f, int recSize, int isText, const char *mode) {
 
 void __reset(File *f, int recSize, int isText) {
     OpenFile(f, recSize, isText, "r");
+    AdviseSequential(fileEntry(f)->file);
     __get(f);
 }
 
+/* Record files are opened for update, so that they can be read after SeekRead. */
 void __rewrite(File *f, int recSize, int isText) {
-    OpenFile(f, recSize, isText, "w");
+    OpenFile(f, recSize, isText, (isText) ? "w" : "w+");
 }
 
 void __append(File *f, int recSize, int isText) {
-    OpenFile(f, recSize, isText, "a");
+    OpenFile(f, recSize, isText, (isText) ? "a" : "a+");
 }
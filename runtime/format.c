@@ -0,0 +1,181 @@
+#include "runtime.h"
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+/*******************************************
+ * Number formatting, straight into a buffer
+ * without going through stdio.
+ *******************************************
+ */
+static const char digitPairs[] = "00010203040506070809"
+                                 "10111213141516171819"
+                                 "20212223242526272829"
+                                 "30313233343536373839"
+                                 "40414243444546474849"
+                                 "50515253545556575859"
+                                 "60616263646566676869"
+                                 "70717273747576777879"
+                                 "80818283848586878889"
+                                 "90919293949596979899";
+
+static const double powersOf10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11};
+
+/* Powers of ten that are exact as a double. */
+static const double exactPowersOf10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                                         1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                                         1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+static int FormatUInt64(char *buf, uint64_t v) {
+    char  tmp[20];
+    char *p = tmp + sizeof(tmp);
+    while (v >= 100) {
+        unsigned i = (v % 100) * 2;
+        v /= 100;
+        p -= 2;
+        memcpy(p, &digitPairs[i], 2);
+    }
+    if (v >= 10) {
+        p -= 2;
+        memcpy(p, &digitPairs[v * 2], 2);
+    } else {
+        *--p = '0' + v;
+    }
+    int len = tmp + sizeof(tmp) - p;
+    memcpy(buf, p, len);
+    return len;
+}
+
+/* Format v in decimal into buf (FormatIntSize chars), returning the length. */
+int __FormatInt64(char *buf, int64_t v) {
+    if (v < 0) {
+        *buf = '-';
+        return 1 + FormatUInt64(buf + 1, -(uint64_t)v);
+    }
+    return FormatUInt64(buf, v);
+}
+
+/* Fixed point formatting, same result as "%.*f". Returns -1 if the value is too large (or
+ * too close to half way between two results) to be done exactly with integer arithmetic.
+ */
+static int FormatFixed(char *buf, double v, int precision) {
+    const double maxScaled = 1e12;
+    if (precision >= (int)(sizeof(powersOf10) / sizeof(powersOf10[0])) || !isfinite(v)) {
+        return -1;
+    }
+    double scaled = fabs(v) * powersOf10[precision];
+    if (scaled >= maxScaled) {
+        return -1;
+    }
+    double whole = floor(scaled);
+    if (fabs(scaled - whole - 0.5) < 1e-3) {
+        return -1;
+    }
+    uint64_t r = (uint64_t)whole + (scaled - whole > 0.5);
+    uint64_t p = (uint64_t)powersOf10[precision];
+
+    int len = 0;
+    if (signbit(v)) {
+        buf[len++] = '-';
+    }
+    len += FormatUInt64(&buf[len], r / p);
+    if (precision > 0) {
+        char frac[20];
+        int  fracLen = FormatUInt64(frac, r % p);
+        buf[len++] = '.';
+        memset(&buf[len], '0', precision - fracLen);
+        memcpy(&buf[len + precision - fracLen], frac, fracLen);
+        len += precision;
+    }
+    return len;
+}
+
+/* Exponent formatting, same result as "% .*E". Like FormatFixed, returns -1 if it can't be
+ * done exactly: the value is scaled by an exact power of ten, so that there is only one
+ * rounding, and the digits are then rounded as an integer.
+ */
+static int FormatExp(char *buf, double v, int precision) {
+    const int maxPower = sizeof(exactPowersOf10) / sizeof(exactPowersOf10[0]) - 1;
+    int       digits = precision + 1;
+    if (digits >= (int)(sizeof(powersOf10) / sizeof(powersOf10[0])) || !isfinite(v)) {
+        return -1;
+    }
+
+    double   a = fabs(v);
+    int      exp = 0;
+    uint64_t r = 0;
+    if (a != 0) {
+        exp = (int)floor(log10(a));
+        for (;;) {
+            /* Scale so that there are "digits" digits before the decimal point. */
+            int shift = digits - 1 - exp;
+            if (shift > maxPower || shift < -maxPower) {
+                return -1;
+            }
+            double scaled =
+                (shift >= 0) ? a * exactPowersOf10[shift] : a / exactPowersOf10[-shift];
+            if (scaled >= powersOf10[digits]) {
+                exp++;
+            } else if (scaled < powersOf10[digits - 1]) {
+                exp--;
+            } else {
+                double whole = floor(scaled);
+                if (fabs(scaled - whole - 0.5) < 1e-3) {
+                    return -1;
+                }
+                r = (uint64_t)whole + (scaled - whole > 0.5);
+                break;
+            }
+        }
+        if (r == (uint64_t)powersOf10[digits]) {
+            r /= 10;
+            exp++;
+        }
+    }
+
+    char digitBuf[20];
+    memset(digitBuf, '0', digits);
+    if (r) {
+        FormatUInt64(digitBuf, r);
+    }
+
+    int len = 0;
+    buf[len++] = signbit(v) ? '-' : ' ';
+    buf[len++] = digitBuf[0];
+    buf[len++] = '.';
+    memcpy(&buf[len], &digitBuf[1], precision);
+    len += precision;
+    buf[len++] = 'E';
+    buf[len++] = (exp < 0) ? '-' : '+';
+    if (exp < 0) {
+        exp = -exp;
+    }
+    if (exp < 10) {
+        buf[len++] = '0';
+    }
+    return len + FormatUInt64(&buf[len], exp);
+}
+
+/* Format a real the way write does, without the padding to width. With no precision the
+ * number is in exponent form. As with snprintf, the length returned is that of the whole
+ * number, even when only the first size - 1 characters fit in buf.
+ */
+int __FormatReal(char *buf, int size, double v, int width, int precision) {
+    int len;
+    if (precision > 0) {
+        if ((len = FormatFixed(buf, v, precision)) >= 0) {
+            return len;
+        }
+        len = snprintf(buf, size, "%.*f", precision, v);
+    } else {
+        if (width == 0) {
+            width = 13;
+        }
+        precision = (width > 8) ? width - 7 : 1;
+        if ((len = FormatExp(buf, v, precision)) >= 0) {
+            return len;
+        }
+        len = snprintf(buf, size, "% .*E", precision, v);
+    }
+    return len;
+}
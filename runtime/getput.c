@@ -1,30 +1,127 @@
 #include "runtime.h"
+#include <stdlib.h>
+#include <string.h>
 
 /*******************************************
  * File Basics, low level I/O.
+ *
+ * Record files are read and written through
+ * a buffer of RecordBufferSize bytes (or one
+ * record, if that is bigger).
  *******************************************
  */
+static size_t BufferRecords(File *file) {
+    if (file->recordSize >= RecordBufferSize) {
+        return 1;
+    }
+    return RecordBufferSize / file->recordSize;
+}
+
+static char *RecordBuffer(File *file) {
+    char *buffer = malloc(BufferRecords(file) * file->recordSize);
+    if (!buffer) {
+        fprintf(stderr, "Out of memory for file buffer\n");
+        exit(11);
+    }
+    return buffer;
+}
+
+/* Refill the input buffer of a record file, returning the number of records read. */
+static size_t FillRecords(File *file, struct FileEntry *f) {
+    if (f->async) {
+        size_t len = __async_read(f, &f->readBuffer);
+        f->readPos = f->readBuffer;
+        f->readEnd = f->readBuffer + len;
+        return len / file->recordSize;
+    }
+    if (!f->readBuffer) {
+        f->readBuffer = RecordBuffer(file);
+    }
+    size_t n = fread(f->readBuffer, file->recordSize, BufferRecords(file), f->file);
+    f->readPos = f->readBuffer;
+    f->readEnd = f->readBuffer + n * file->recordSize;
+    return n;
+}
+
+/* Write out the buffered records of f. */
+void __flush_records(struct FileEntry *f) {
+    if (f->async) {
+        if (f->writePos != f->writeBuffer) {
+            __async_write(f);
+        }
+    } else if (f->writePos != f->writeBuffer) {
+        fwrite(f->writeBuffer, 1, f->writePos - f->writeBuffer, f->file);
+        f->writePos = f->writeBuffer;
+    }
+}
+
+void __put_record(File *file, const void *rec) {
+    struct FileEntry *f = fileEntry(file);
+    if (f->map) {
+        __unmap_file(file);
+    }
+    if (!f->writeBuffer) {
+        f->writeBuffer = f->writePos = RecordBuffer(file);
+        f->writeEnd = f->writeBuffer + BufferRecords(file) * file->recordSize;
+    }
+    if (f->writePos == f->writeEnd) {
+        __flush_records(f);
+    }
+    memcpy(f->writePos, rec, file->recordSize);
+    f->writePos += file->recordSize;
+}
 
 void __put(File *file) {
-    struct FileEntry *f = 0;
-    if (file->handle < MaxPascalFiles && files[file->handle].inUse) {
-        f = &files[file->handle];
+    if (file->isText) {
+        __write_text(file, file->buffer, 1);
+    } else {
+        /* The buffer variable may point into the mapping, which unmapping moves it out of. */
+        __unmap_file(file);
+        __put_record(file, file->buffer);
+    }
+}
+
+/* Write len characters of text to file. */
+void __write_text(File *file, const char *s, size_t len) {
+    struct FileEntry *f = fileEntry(file);
+    if (!f->async) {
+        fwrite(s, 1, len, getFile(file));
+        return;
+    }
+    while (len) {
+        if (f->writePos == f->writeEnd) {
+            __async_write(f);
+        }
+        size_t n = f->writeEnd - f->writePos;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(f->writePos, s, n);
+        f->writePos += n;
+        s += n;
+        len -= n;
     }
-    fwrite(file->buffer, file->recordSize, 1, f->file);
 }
 
 int __get(File *file) {
     struct FileEntry *f = 0;
-    if (file->handle < MaxPascalFiles && files[file->handle].inUse) {
-        f = &files[file->handle];
+    if (validFile(file)) {
+        f = fileEntry(file);
     }
     if (file->isText) {
-        int ch = fgetc(f->file);
-        *file->buffer = ch;
-        f->readAhead = (ch != EOF);
-        return f->readAhead;
+        return getText(file);
+    } else if (f->map) {
+        char *next = (f->readAhead) ? file->buffer + file->recordSize : f->mapEnd;
+        if (next < f->mapEnd) {
+            file->buffer = next;
+            return 1;
+        }
+        file->buffer = f->ownBuffer;
+        f->readAhead = 0;
     } else {
-        if (fread(file->buffer, file->recordSize, 1, f->file) > 0) {
+        if (f->readPos != f->readEnd || FillRecords(file, f)) {
+            memcpy(file->buffer, f->readPos, file->recordSize);
+            f->readPos += file->recordSize;
             f->readAhead = 1;
             return 1;
         }
@@ -32,3 +129,87 @@ int __get(File *file) {
     }
     return 0;
 }
+
+/*******************************************
+ * Block transfers of whole arrays of records.
+ * Anything that isn't already buffered goes
+ * straight between the array and the file.
+ *******************************************
+ */
+static void BlockSizeError(const char *op, int count, int size) {
+    fprintf(stderr, "%s of %d records into an array of %d\n", op, count, size);
+    exit(12);
+}
+
+/* Read up to count records into dest, which has room for size records. Returns the number
+ * of records read.
+ */
+int __block_read(File *file, void *dest, int count, int size) {
+    struct FileEntry *f = fileEntry(file);
+    char *            d = dest;
+    int               n = 0;
+    size_t            recSize = file->recordSize;
+
+    if (count > size) {
+        BlockSizeError("BlockRead", count, size);
+    }
+    if (count <= 0 || !f->readAhead) {
+        return 0;
+    }
+    if (f->map) {
+        size_t avail = (f->mapEnd - file->buffer) / recSize;
+        n = ((size_t)count < avail) ? count : (int)avail;
+        memcpy(d, file->buffer, n * recSize);
+        __set_read_position(file, __position(file) + n);
+        return n;
+    }
+    /* The current record comes first, then the rest of the buffer. */
+    memcpy(d, file->buffer, recSize);
+    n++;
+    for (;;) {
+        size_t buffered = (f->readEnd - f->readPos) / recSize;
+        if (buffered > (size_t)(count - n)) {
+            buffered = count - n;
+        }
+        memcpy(d + n * recSize, f->readPos, buffered * recSize);
+        f->readPos += buffered * recSize;
+        n += buffered;
+        if (n == count) {
+            break;
+        }
+        if (!f->async) {
+            n += fread(d + n * recSize, recSize, count - n, f->file);
+            break;
+        }
+        /* The helper thread is reading the file, so carry on from its buffers. */
+        if (!FillRecords(file, f)) {
+            break;
+        }
+    }
+    __get(file);
+    return n;
+}
+
+/* Write count records from src, which holds size records. Returns the number of records
+ * written.
+ */
+int __block_write(File *file, const void *src, int count, int size) {
+    struct FileEntry *f = fileEntry(file);
+    const char *      s = src;
+
+    if (count > size) {
+        BlockSizeError("BlockWrite", count, size);
+    }
+    if (count <= 0) {
+        return 0;
+    }
+    __unmap_file(file);
+    if (f->async || (size_t)count < BufferRecords(file)) {
+        for (int i = 0; i < count; i++) {
+            __put_record(file, s + i * file->recordSize);
+        }
+        return count;
+    }
+    __flush_records(f);
+    return fwrite(s, file->recordSize, count, f->file);
+}
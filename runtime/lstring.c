@@ -0,0 +1,236 @@
+#include "runtime.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*******************************************
+ * Long (reference counted) string functions
+ *
+ * A long string is a pointer to the characters (always zero terminated),
+ * with a LongStringHeader just before them. NULL is the empty string.
+ * A reference count of zero means the string is a temporary: it is
+ * owned by the expression that produced it, and the function that uses
+ * it either takes it over or frees it.
+ *******************************************
+ */
+static inline LongStringHeader *Header(char *s) {
+    return ((LongStringHeader *)s) - 1;
+}
+
+static inline int Length(char *s) {
+    return (s) ? Header(s)->length : 0;
+}
+
+static char *Allocate(int len) {
+    LongStringHeader *h = malloc(sizeof(LongStringHeader) + len + 1);
+    if (!h) {
+        fprintf(stderr, "Out of memory for string of length %d\n", len);
+        exit(11);
+    }
+    h->refCount = 0;
+    h->length = len;
+    h->capacity = len;
+    char *s = (char *)(h + 1);
+    s[len] = 0;
+    return s;
+}
+
+/* Free the string if it is a temporary */
+void __LStrReleaseTemp(char *s) {
+    if (s && Header(s)->refCount == 0) {
+        free(Header(s));
+    }
+}
+
+/* Take a reference to the string (a temporary is taken over). */
+void __LStrIncRef(char *s) {
+    if (s) {
+        Header(s)->refCount++;
+    }
+}
+
+/* Drop a reference to the string, freeing it when no references are left. */
+void __LStrDecRef(char *s) {
+    if (s) {
+        LongStringHeader *h = Header(s);
+        if (h->refCount <= 1) {
+            free(h);
+        } else {
+            h->refCount--;
+        }
+    }
+}
+
+/* Turn a reference held by a function result into a temporary for the caller. */
+char *__LStrResult(char *s) {
+    if (s) {
+        Header(s)->refCount--;
+    }
+    return s;
+}
+
+void __LStrAssign(char **dest, char *src) {
+    char *old = *dest;
+    __LStrIncRef(src);
+    *dest = src;
+    __LStrDecRef(old);
+}
+
+/* Make sure the string is only referenced by *s, so that it can be modified. */
+void __LStrUnique(char **s) {
+    char *old = *s;
+    if (old && Header(old)->refCount > 1) {
+        int   len = Length(old);
+        char *copy = Allocate(len);
+        memcpy(copy, old, len);
+        Header(copy)->refCount = 1;
+        Header(old)->refCount--;
+        *s = copy;
+    }
+}
+
+char *__LStrFromChars(const char *str, int len) {
+    if (len <= 0) {
+        return NULL;
+    }
+    char *s = Allocate(len);
+    memcpy(s, str, len);
+    return s;
+}
+
+char *__LStrFromChar(char c) {
+    return __LStrFromChars(&c, 1);
+}
+
+char *__LStrFromStr(String *str) {
+    return __LStrFromChars((const char *)str->str, str->len);
+}
+
+/* Convert to a short string, truncating to the maximum length of a short string */
+void __StrFromLStr(String *dest, char *s) {
+    int len = Length(s);
+    if (len > MaxStringLen) {
+        len = MaxStringLen;
+    }
+    dest->len = len;
+    memcpy(dest->str, s, len);
+    __LStrReleaseTemp(s);
+}
+
+int __LStrLength(char *s) {
+    int len = Length(s);
+    __LStrReleaseTemp(s);
+    return len;
+}
+
+/* The length, leaving a temporary for the caller to release once done with it. */
+int __LStrPeekLength(char *s) {
+    return Length(s);
+}
+
+char *__LStrConcat(char *a, char *b) {
+    int alen = Length(a);
+    int blen = Length(b);
+    if (!blen) {
+        return a;
+    }
+    if (!alen) {
+        return b;
+    }
+
+    char *res;
+    if (Header(a)->refCount == 0) {
+        /* A temporary can be extended in place. */
+        LongStringHeader *h = realloc(Header(a), sizeof(LongStringHeader) + alen + blen + 1);
+        if (!h) {
+            fprintf(stderr, "Out of memory for string of length %d\n", alen + blen);
+            exit(11);
+        }
+        h->length = alen + blen;
+        h->capacity = alen + blen;
+        res = (char *)(h + 1);
+    } else {
+        res = Allocate(alen + blen);
+        memcpy(res, a, alen);
+    }
+    memcpy(res + alen, b, blen);
+    res[alen + blen] = 0;
+    __LStrReleaseTemp(b);
+    return res;
+}
+
+/* Append src to *dest, where old is what *dest was before src was evaluated, with a
+ * reference taken by the caller. When *dest is still old and nothing else refers to it,
+ * the string is extended in place, with room to spare, so that appending in a loop doesn't
+ * copy the whole string every time.
+ */
+void __LStrAppend(char **dest, char *old, char *src) {
+    int alen = Length(old);
+    int blen = Length(src);
+    if (*dest != old || !alen || Header(old)->refCount > 2) {
+        __LStrAssign(dest, __LStrConcat(old, src));
+        __LStrDecRef(old);
+        return;
+    }
+    Header(old)->refCount--;
+    if (!blen) {
+        return;
+    }
+
+    LongStringHeader *h = Header(old);
+    if (h->capacity < alen + blen) {
+        int size = (alen + blen > 2 * alen) ? alen + blen : 2 * alen;
+        h = realloc(h, sizeof(LongStringHeader) + size + 1);
+        if (!h) {
+            fprintf(stderr, "Out of memory for string of length %d\n", size);
+            exit(11);
+        }
+        h->capacity = size;
+    }
+    char *s = (char *)(h + 1);
+    /* s := s + s */
+    if (src == old) {
+        src = s;
+    }
+    memcpy(s + alen, src, blen);
+    h->length = alen + blen;
+    s[alen + blen] = 0;
+    *dest = s;
+    __LStrReleaseTemp(src);
+}
+
+/* Return >0 if a is greater than b,
+ * Return <0 if a is less than b.
+ * Return 0 if a == b.
+ */
+int __LStrCompare(char *a, char *b) {
+    int alen = Length(a);
+    int blen = Length(b);
+    int shortest = (alen < blen) ? alen : blen;
+    int res = 0;
+    if (shortest) {
+        res = memcmp(a, b, shortest);
+    }
+    if (!res) {
+        res = alen - blen;
+    }
+    __LStrReleaseTemp(a);
+    __LStrReleaseTemp(b);
+    return res;
+}
+
+/* Return substring of input */
+char *__LStrCopy(char *str, int start, int len) {
+    assert(start >= 1);
+    assert(len >= 0);
+
+    int slen = Length(str);
+    if (start > slen) {
+        len = 0;
+    } else if (start - 1 + len > slen) {
+        len = slen - (start - 1);
+    }
+
+    char *res = __LStrFromChars(str + start - 1, len);
+    __LStrReleaseTemp(str);
+    return res;
+}
@@ -21,6 +21,7 @@ static void InitModules() {
 int main(int argc, char **argv) {
     c_argv = argv;
     c_argc = argc;
+    InitAlloc();
     InitFiles();
     InitModules();
     __PascalMain();
@@ -0,0 +1,253 @@
+#include "runtime.h"
+#include <float.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*******************************************
+ * Number parsing, straight from a range of
+ * characters (which needn't be terminated).
+ *******************************************
+ */
+enum {
+    /* The most decimal digits that always fit in a uint64_t. */
+    MaxSignificantDigits = 19,
+    /* Reals longer than this are copied into allocated memory for strtod. */
+    RealTextSize = 128,
+};
+
+/* Powers of ten that are exact as a double. */
+static const double exactPowersOf10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                                         1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                                         1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+static inline int IsDigit(char c) {
+    return (unsigned char)(c - '0') < 10;
+}
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define PARSE_SWAR 1
+
+/* Eight characters at a time, as one (little endian) word. */
+static inline uint64_t Load8(const char *s) {
+    uint64_t x;
+    memcpy(&x, s, sizeof(x));
+    return x;
+}
+
+/* Are all eight characters in x digits? */
+static inline int AllDigits8(uint64_t x) {
+    return (((x & 0xF0F0F0F0F0F0F0F0) | (((x + 0x0606060606060606) & 0xF0F0F0F0F0F0F0F0) >> 4)) ==
+            0x3333333333333333);
+}
+
+/* The value of the eight digits in x, combining pairs, then quads, then the two halves. */
+static inline uint32_t Value8(uint64_t x) {
+    const uint64_t mask = 0x000000FF000000FF;
+    const uint64_t mul1 = 100 + (1000000ULL << 32);
+    const uint64_t mul2 = 1 + (10000ULL << 32);
+    x -= 0x3030303030303030;
+    x = (x * 10) + (x >> 8);
+    return (uint32_t)((((x & mask) * mul1) + (((x >> 16) & mask) * mul2)) >> 32);
+}
+#endif
+
+/* Accumulate the run of digits from s into *n. Sets *overflow if the value doesn't fit in
+ * a uint64_t, but still skips all the digits. Returns the end of the run.
+ */
+static const char *DigitRun(const char *s, const char *end, uint64_t *n, int *overflow) {
+    uint64_t v = 0;
+#if PARSE_SWAR
+    /* Below 10^11, another eight digits can't overflow. */
+    while (end - s >= 8 && v < 100000000000ULL) {
+        uint64_t x = Load8(s);
+        if (!AllDigits8(x)) {
+            break;
+        }
+        v = v * 100000000 + Value8(x);
+        s += 8;
+    }
+#endif
+    for (; s < end && IsDigit(*s); s++) {
+        unsigned d = *s - '0';
+        if (v > (UINT64_MAX - d) / 10) {
+            *overflow = 1;
+        } else {
+            v = v * 10 + d;
+        }
+    }
+    *n = v;
+    return s;
+}
+
+/* Parse an optionally signed integer at s, which should be in the range min..max. Returns
+ * PS_NoNumber if there are no digits, with *next set to s. Otherwise *next is set to the
+ * character after the number, and *v to its value unless the result is PS_Overflow.
+ */
+int __ParseInt64(const char *s, const char *end, int64_t min, int64_t max, int64_t *v,
+                 const char **next) {
+    const char *p = s;
+    int         neg = 0;
+    if (p < end && (*p == '-' || *p == '+')) {
+        neg = *p == '-';
+        p++;
+    }
+    uint64_t    n;
+    int         overflow = 0;
+    const char *digits = p;
+    p = DigitRun(p, end, &n, &overflow);
+    if (p == digits) {
+        *next = s;
+        return PS_NoNumber;
+    }
+    *next = p;
+
+    uint64_t limit = (neg) ? ((min < 0) ? -(uint64_t)min : 0) : (uint64_t)max;
+    if (overflow || n > limit) {
+        return PS_Overflow;
+    }
+    if (neg) {
+        *v = (n) ? -(int64_t)(n - 1) - 1 : 0;
+    } else {
+        *v = n;
+    }
+    return PS_Ok;
+}
+
+/* Add the digits from s to the significand *w, keeping up to MaxSignificantDigits of them.
+ * *exp10 is adjusted for digits of the whole part that are dropped, and for digits of the
+ * fraction part that are kept. *inexact is set if a non-zero digit is dropped.
+ */
+static const char *Significand(const char *s, const char *end, int fraction, uint64_t *w,
+                               int *digits, int *exp10, int *inexact) {
+    if (!*w) {
+        /* Leading zeros aren't significant. */
+        for (; s < end && *s == '0'; s++) {
+            *exp10 -= fraction;
+        }
+    }
+#if PARSE_SWAR
+    while (*digits + 8 <= MaxSignificantDigits && end - s >= 8) {
+        uint64_t x = Load8(s);
+        if (!AllDigits8(x)) {
+            break;
+        }
+        *w = *w * 100000000 + Value8(x);
+        *digits += 8;
+        *exp10 -= 8 * fraction;
+        s += 8;
+    }
+#endif
+    for (; s < end && IsDigit(*s); s++) {
+        if (*digits < MaxSignificantDigits) {
+            *w = *w * 10 + (*s - '0');
+            *digits += 1;
+            *exp10 -= fraction;
+        } else {
+            *inexact |= *s != '0';
+            *exp10 += !fraction;
+        }
+    }
+    return s;
+}
+
+/* Convert the text of a real from s to end with strtod, which rounds correctly. */
+static double SlowReal(const char *s, const char *end) {
+    char   text[RealTextSize];
+    size_t len = end - s;
+    char * buf = (len < sizeof(text)) ? text : malloc(len + 1);
+    if (!buf) {
+        fprintf(stderr, "Out of memory for number of length %zu\n", len);
+        exit(11);
+    }
+    memcpy(buf, s, len);
+    buf[len] = 0;
+    double r = strtod(buf, NULL);
+    if (buf != text) {
+        free(buf);
+    }
+    return r;
+}
+
+/* Parse a real at s: [sign] digits [. digits] [e [sign] digits], where either the whole or
+ * the fraction digits may be left out. The result is correctly rounded: the common case of
+ * at most 19 significant digits and a small exponent is done exactly with one floating
+ * point operation, anything else goes through strtod. Returns like __ParseInt64, with
+ * PS_Overflow for a value too large for a double.
+ */
+int __ParseReal(const char *s, const char *end, double *v, const char **next) {
+    const char *p = s;
+    int         neg = 0;
+    if (p < end && (*p == '-' || *p == '+')) {
+        neg = *p == '-';
+        p++;
+    }
+    uint64_t    w = 0;
+    int         digits = 0;
+    int         exp10 = 0;
+    int         inexact = 0;
+    const char *whole = p;
+    p = Significand(p, end, 0, &w, &digits, &exp10, &inexact);
+    int haveDigits = p != whole;
+    if (p < end && *p == '.') {
+        const char *fraction = p + 1;
+        const char *q = Significand(fraction, end, 1, &w, &digits, &exp10, &inexact);
+        if (haveDigits || q != fraction) {
+            haveDigits = 1;
+            p = q;
+        }
+    }
+    if (!haveDigits) {
+        *next = s;
+        return PS_NoNumber;
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char *q = p + 1;
+        int         expNeg = 0;
+        if (q < end && (*q == '-' || *q == '+')) {
+            expNeg = *q == '-';
+            q++;
+        }
+        if (q < end && IsDigit(*q)) {
+            int e = 0;
+            for (; q < end && IsDigit(*q); q++) {
+                if (e < 100000) {
+                    e = e * 10 + (*q - '0');
+                }
+            }
+            exp10 += (expNeg) ? -e : e;
+            p = q;
+        }
+    }
+    *next = p;
+
+    double r;
+    if (!w) {
+        r = 0.0;
+    }
+#if FLT_EVAL_METHOD == 0
+    /* Both w and the power of ten are exact, so one rounding gives the right answer. */
+    else if (!inexact && w <= (1ULL << 53) && exp10 >= -22 && exp10 <= 22) {
+        r = (exp10 < 0) ? (double)w / exactPowersOf10[-exp10] : (double)w * exactPowersOf10[exp10];
+    } else if (!inexact && exp10 > 22 && exp10 <= 22 + 15 &&
+               w <= (1ULL << 53) / (uint64_t)exactPowersOf10[exp10 - 22]) {
+        r = (double)(w * (uint64_t)exactPowersOf10[exp10 - 22]) * 1e22;
+    }
+#endif
+    else {
+        r = SlowReal(s, p);
+        neg = 0;
+    }
+    if (isinf(r)) {
+        return PS_Overflow;
+    }
+    *v = (neg) ? -r : r;
+    return PS_Ok;
+}
+
+/* Report a number that is out of range for its variable, and exit. */
+void __NumberRangeError(const char *s, const char *end) {
+    fprintf(stderr, "Number out of range: %.*s\n", (int)(end - s), s);
+    exit(12);
+}
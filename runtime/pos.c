@@ -0,0 +1,209 @@
+#include "runtime.h"
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/*******************************************
+ * Substring search (Pos and PosFrom).
+ *
+ * All the functions take the 1-based position to start searching from,
+ * and return the 1-based position of the match, or 0 if not found.
+ *******************************************
+ */
+enum {
+    /* Needles longer than this use Two-Way. Must match the compiler. */
+    PosShortNeedle = 32,
+};
+
+typedef const unsigned char *Chars;
+
+/* Make start 0-based, return -1 if there is no room for the needle. */
+static int StartOffset(int start, int nlen, int hlen) {
+    if (start < 1) {
+        start = 1;
+    }
+    start--;
+    if (nlen > hlen - start) {
+        return -1;
+    }
+    return start;
+}
+
+int __PosChar(char c, const char *hay, int hlen, int start) {
+    if ((start = StartOffset(start, 1, hlen)) < 0) {
+        return 0;
+    }
+    const char *p = memchr(hay + start, c, hlen - start);
+    return (p) ? p - hay + 1 : 0;
+}
+
+/* Candidates found by the first character, verified by memcmp. */
+static int PosShortGeneric(Chars needle, int nlen, Chars hay, int hlen, int start) {
+    const int last = hlen - nlen;
+    for (int i = start; i <= last;) {
+        Chars p = memchr(hay + i, needle[0], last - i + 1);
+        if (!p) {
+            return 0;
+        }
+        i = p - hay;
+        if (!memcmp(hay + i + 1, needle + 1, nlen - 1)) {
+            return i + 1;
+        }
+        i++;
+    }
+    return 0;
+}
+
+/* Needle of 2 to PosShortNeedle characters. */
+static int PosShort(Chars needle, int nlen, Chars hay, int hlen, int start) {
+#if defined(__SSE2__)
+    /* Compare 16 positions at a time with the first and the last character of the needle,
+     * and only check the middle of the candidates where both match.
+     */
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i lastc = _mm_set1_epi8(needle[nlen - 1]);
+    int           i = start;
+    for (; i + nlen - 1 + 16 <= hlen; i += 16) {
+        __m128i  bf = _mm_loadu_si128((const __m128i *)(hay + i));
+        __m128i  bl = _mm_loadu_si128((const __m128i *)(hay + i + nlen - 1));
+        unsigned mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(bf, first),
+                                                        _mm_cmpeq_epi8(bl, lastc)));
+        while (mask) {
+            int bit = __builtin_ctz(mask);
+            if (!memcmp(hay + i + bit + 1, needle + 1, nlen - 2)) {
+                return i + bit + 1;
+            }
+            mask &= mask - 1;
+        }
+    }
+    return PosShortGeneric(needle, nlen, hay, hlen, i);
+#else
+    return PosShortGeneric(needle, nlen, hay, hlen, start);
+#endif
+}
+
+/* Critical factorization of the needle for Two-Way: returns the position of the
+ * factorization, and the period of the needle (or a bound used as the shift
+ * when the needle is not periodic, with *periodic set to 0).
+ */
+static int CriticalFactorization(Chars needle, int nlen, int *period, int *periodic) {
+    int suffix[2];
+    int per[2];
+    for (int rev = 0; rev < 2; rev++) {
+        int ms = -1;
+        int j = 0;
+        int k = 1;
+        int p = 1;
+        while (j + k < nlen) {
+            unsigned char a = needle[j + k];
+            unsigned char b = needle[ms + k];
+            if ((rev) ? (a > b) : (a < b)) {
+                j += k;
+                k = 1;
+                p = j - ms;
+            } else if (a == b) {
+                if (k != p) {
+                    k++;
+                } else {
+                    j += p;
+                    k = 1;
+                }
+            } else {
+                ms = j++;
+                k = p = 1;
+            }
+        }
+        suffix[rev] = ms + 1;
+        per[rev] = p;
+    }
+    int r = (suffix[1] < suffix[0]) ? 0 : 1;
+    int s = suffix[r];
+    *period = per[r];
+    *periodic = !memcmp(needle, needle + *period, s);
+    if (!*periodic) {
+        *period = ((s > nlen - s) ? s : nlen - s) + 1;
+    }
+    return s;
+}
+
+/* Two-Way search, with the factorization of the needle already done. */
+int __PosTwoWay(const char *needleIn, int nlen, const char *hayIn, int hlen, int start,
+                int suffix, int period, int periodic) {
+    Chars needle = (Chars)needleIn;
+    Chars hay = (Chars)hayIn;
+    if ((start = StartOffset(start, nlen, hlen)) < 0) {
+        return 0;
+    }
+    const int last = hlen - nlen;
+    int       j = start;
+    if (periodic) {
+        int memory = 0;
+        while (j <= last) {
+            int i = (suffix > memory) ? suffix : memory;
+            while (i < nlen && needle[i] == hay[i + j]) {
+                i++;
+            }
+            if (i >= nlen) {
+                i = suffix - 1;
+                while (i >= memory && needle[i] == hay[i + j]) {
+                    i--;
+                }
+                if (i < memory) {
+                    return j + 1;
+                }
+                j += period;
+                memory = nlen - period;
+            } else {
+                j += i - suffix + 1;
+                memory = 0;
+            }
+        }
+    } else {
+        while (j <= last) {
+            int i = suffix;
+            while (i < nlen && needle[i] == hay[i + j]) {
+                i++;
+            }
+            if (i >= nlen) {
+                i = suffix - 1;
+                while (i >= 0 && needle[i] == hay[i + j]) {
+                    i--;
+                }
+                if (i < 0) {
+                    return j + 1;
+                }
+                j += period;
+            } else {
+                j += i - suffix + 1;
+            }
+        }
+    }
+    return 0;
+}
+
+int __PosShort(const char *needle, int nlen, const char *hay, int hlen, int start) {
+    if ((start = StartOffset(start, nlen, hlen)) < 0) {
+        return 0;
+    }
+    return PosShort((Chars)needle, nlen, (Chars)hay, hlen, start);
+}
+
+/* Search for a needle that is not known at compile time. */
+int __Pos(const char *needle, int nlen, const char *hay, int hlen, int start) {
+    if (nlen == 0) {
+        return 0;
+    }
+    if (nlen == 1) {
+        return __PosChar(needle[0], hay, hlen, start);
+    }
+    if (nlen <= PosShortNeedle) {
+        return __PosShort(needle, nlen, hay, hlen, start);
+    }
+    int period;
+    int periodic;
+    int suffix = CriticalFactorization((Chars)needle, nlen, &period, &periodic);
+    return __PosTwoWay(needle, nlen, hay, hlen, start, suffix, period, periodic);
+}
@@ -0,0 +1,404 @@
+#include "runtime.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*******************************************
+ * Heap profiler.
+ *
+ * With LACSAP_HEAP_PROFILE=text or json,
+ * every new and dispose is counted against
+ * the place in the source where the object
+ * was made, which the compiler passes to
+ * new. At exit there is a report of the
+ * totals for each place, the peak of live
+ * bytes, and what is still allocated, to
+ * stderr or LACSAP_HEAP_PROFILE_FILE.
+ *******************************************
+ */
+enum ProfileFormat {
+    PF_Off,
+    PF_Text,
+    PF_Json,
+};
+
+struct Site {
+    const char *name;
+    uint64_t    allocs;
+    uint64_t    bytes;
+    uint64_t    frees;
+    uint64_t    liveBlocks;
+    uint64_t    liveBytes;
+};
+
+struct Block {
+    void * ptr;
+    size_t size;
+    int    site;
+    int    inRegion;
+};
+
+/* Open addressing tables, sized as powers of two and kept at most half full. */
+struct Table {
+    void * entries;
+    size_t size;
+    size_t count;
+};
+
+static int             profileFormat;
+static pthread_mutex_t profileLock = PTHREAD_MUTEX_INITIALIZER;
+static struct Site *   sites;
+static int             siteCount;
+static int             siteMax;
+static struct Table    siteTable;
+static struct Table    blockTable;
+static uint64_t        liveBytes;
+static uint64_t        peakLiveBytes;
+
+/* The objects allocated in the region of each thread, newest last, for Release. */
+static __thread void **regionLog;
+static __thread size_t regionLogCount;
+static __thread size_t regionLogMax;
+
+static void *ProfileAlloc(size_t n, size_t size) {
+    void *p = calloc(n, size);
+    if (!p) {
+        fprintf(stderr, "Out of memory for heap profile\n");
+        exit(11);
+    }
+    return p;
+}
+
+static size_t PtrHash(const void *p, size_t size) {
+    return ((uintptr_t)p / 16 * 0x9E3779B97F4A7C15ull) & (size - 1);
+}
+
+/*******************************************
+ * Sites, by the address of the name.
+ *******************************************
+ */
+static void SiteTableInsert(int *table, size_t size, int site) {
+    size_t i = PtrHash(sites[site].name, size);
+    while (table[i]) {
+        i = (i + 1) & (size - 1);
+    }
+    /* Stored plus one, so zero is empty. */
+    table[i] = site + 1;
+}
+
+static int FindSite(const char *name) {
+    int *  table = siteTable.entries;
+    size_t mask = siteTable.size - 1;
+    for (size_t i = PtrHash(name, siteTable.size); table && table[i]; i = (i + 1) & mask) {
+        if (sites[table[i] - 1].name == name) {
+            return table[i] - 1;
+        }
+    }
+    if (siteCount == siteMax) {
+        siteMax = (siteMax) ? 2 * siteMax : 64;
+        sites = realloc(sites, siteMax * sizeof(*sites));
+        if (!sites) {
+            fprintf(stderr, "Out of memory for heap profile\n");
+            exit(11);
+        }
+    }
+    int site = siteCount++;
+    memset(&sites[site], 0, sizeof(sites[site]));
+    sites[site].name = name;
+    if (2 * siteCount > (int)siteTable.size) {
+        size_t size = (siteTable.size) ? 2 * siteTable.size : 128;
+        free(siteTable.entries);
+        siteTable.entries = ProfileAlloc(size, sizeof(int));
+        siteTable.size = size;
+        for (int s = 0; s < siteCount; s++) {
+            SiteTableInsert(siteTable.entries, size, s);
+        }
+    } else {
+        SiteTableInsert(siteTable.entries, siteTable.size, site);
+    }
+    return site;
+}
+
+/*******************************************
+ * Live blocks, by address.
+ *******************************************
+ */
+static void BlockTableInsert(struct Block *table, size_t size, const struct Block *b) {
+    size_t i = PtrHash(b->ptr, size);
+    while (table[i].ptr) {
+        i = (i + 1) & (size - 1);
+    }
+    table[i] = *b;
+}
+
+static void AddBlock(const struct Block *b) {
+    if (2 * (blockTable.count + 1) > blockTable.size) {
+        size_t        size = (blockTable.size) ? 2 * blockTable.size : 1024;
+        struct Block *table = ProfileAlloc(size, sizeof(*table));
+        struct Block *old = blockTable.entries;
+        for (size_t i = 0; i < blockTable.size; i++) {
+            if (old[i].ptr) {
+                BlockTableInsert(table, size, &old[i]);
+            }
+        }
+        free(old);
+        blockTable.entries = table;
+        blockTable.size = size;
+    }
+    BlockTableInsert(blockTable.entries, blockTable.size, b);
+    blockTable.count++;
+}
+
+/* Take p out of the table, returning 0 if it isn't there. */
+static int RemoveBlock(void *p, int fromRegion, struct Block *found) {
+    struct Block *table = blockTable.entries;
+    size_t        mask = blockTable.size - 1;
+    if (!table) {
+        return 0;
+    }
+    size_t i = PtrHash(p, blockTable.size);
+    while (table[i].ptr != p) {
+        if (!table[i].ptr) {
+            return 0;
+        }
+        i = (i + 1) & mask;
+    }
+    /* Objects in a region are only freed by Release. */
+    if (table[i].inRegion && !fromRegion) {
+        return 0;
+    }
+    *found = table[i];
+    /* Move up any later entries that would no longer be found past the gap. */
+    for (size_t j = (i + 1) & mask; table[j].ptr; j = (j + 1) & mask) {
+        size_t h = PtrHash(table[j].ptr, blockTable.size);
+        if (((j - h) & mask) >= ((j - i) & mask)) {
+            table[i] = table[j];
+            i = j;
+        }
+    }
+    table[i].ptr = NULL;
+    blockTable.count--;
+    return 1;
+}
+
+static void FreeBlock(void *p, int fromRegion) {
+    struct Block b;
+    if (RemoveBlock(p, fromRegion, &b)) {
+        struct Site *s = &sites[b.site];
+        s->frees++;
+        s->liveBlocks--;
+        s->liveBytes -= b.size;
+        liveBytes -= b.size;
+    }
+}
+
+/*******************************************
+ * Called from new, dispose, Mark and Release
+ * when profiling.
+ *******************************************
+ */
+void __profile_new(void *p, size_t size, const char *site, int inRegion) {
+    if (!p) {
+        return;
+    }
+    pthread_mutex_lock(&profileLock);
+    struct Block b = {p, size, FindSite(site), inRegion};
+    struct Site *s = &sites[b.site];
+    s->allocs++;
+    s->bytes += size;
+    s->liveBlocks++;
+    s->liveBytes += size;
+    liveBytes += size;
+    if (liveBytes > peakLiveBytes) {
+        peakLiveBytes = liveBytes;
+    }
+    AddBlock(&b);
+    pthread_mutex_unlock(&profileLock);
+    if (inRegion) {
+        if (regionLogCount == regionLogMax) {
+            regionLogMax = (regionLogMax) ? 2 * regionLogMax : 1024;
+            regionLog = realloc(regionLog, regionLogMax * sizeof(*regionLog));
+            if (!regionLog) {
+                fprintf(stderr, "Out of memory for heap profile\n");
+                exit(11);
+            }
+        }
+        regionLog[regionLogCount++] = p;
+    }
+}
+
+void __profile_dispose(void *p) {
+    pthread_mutex_lock(&profileLock);
+    FreeBlock(p, 0);
+    pthread_mutex_unlock(&profileLock);
+}
+
+size_t __profile_mark(void) {
+    return regionLogCount;
+}
+
+void __profile_release(size_t mark) {
+    pthread_mutex_lock(&profileLock);
+    while (regionLogCount > mark) {
+        FreeBlock(regionLog[--regionLogCount], 1);
+    }
+    pthread_mutex_unlock(&profileLock);
+}
+
+/*******************************************
+ * The report
+ *******************************************
+ */
+static int ByName(const void *a, const void *b) {
+    return strcmp(((const struct Site *)a)->name, ((const struct Site *)b)->name);
+}
+
+static int ByBytes(const void *a, const void *b) {
+    const struct Site *x = a;
+    const struct Site *y = b;
+    if (x->bytes != y->bytes) {
+        return (x->bytes < y->bytes) ? 1 : -1;
+    }
+    return strcmp(x->name, y->name);
+}
+
+static int ByLiveBytes(const void *a, const void *b) {
+    const struct Site *x = a;
+    const struct Site *y = b;
+    if (x->liveBytes != y->liveBytes) {
+        return (x->liveBytes < y->liveBytes) ? 1 : -1;
+    }
+    return strcmp(x->name, y->name);
+}
+
+/* new called twice on one line has two copies of the name, so put them together. */
+static int MergeSites(void) {
+    int n = 0;
+    qsort(sites, siteCount, sizeof(*sites), ByName);
+    for (int i = 0; i < siteCount; i++) {
+        if (n && !strcmp(sites[n - 1].name, sites[i].name)) {
+            struct Site *s = &sites[n - 1];
+            s->allocs += sites[i].allocs;
+            s->bytes += sites[i].bytes;
+            s->frees += sites[i].frees;
+            s->liveBlocks += sites[i].liveBlocks;
+            s->liveBytes += sites[i].liveBytes;
+        } else {
+            sites[n++] = sites[i];
+        }
+    }
+    return n;
+}
+
+static void Totals(int n, uint64_t *allocs, uint64_t *bytes, uint64_t *liveBlocks) {
+    *allocs = *bytes = *liveBlocks = 0;
+    for (int i = 0; i < n; i++) {
+        *allocs += sites[i].allocs;
+        *bytes += sites[i].bytes;
+        *liveBlocks += sites[i].liveBlocks;
+    }
+}
+
+static void TextReport(FILE *out, int n) {
+    uint64_t allocs, bytes, liveBlocks;
+    Totals(n, &allocs, &bytes, &liveBlocks);
+    fprintf(out, "Heap profile: %llu allocations, %llu bytes, peak live %llu bytes\n",
+            (unsigned long long)allocs, (unsigned long long)bytes,
+            (unsigned long long)peakLiveBytes);
+    fprintf(out, "%12s %14s %12s  %s\n", "Allocations", "Bytes", "Frees", "Site");
+    qsort(sites, n, sizeof(*sites), ByBytes);
+    for (int i = 0; i < n; i++) {
+        fprintf(out, "%12llu %14llu %12llu  %s\n", (unsigned long long)sites[i].allocs,
+                (unsigned long long)sites[i].bytes, (unsigned long long)sites[i].frees,
+                sites[i].name);
+    }
+    fprintf(out, "Live at exit: %llu blocks, %llu bytes\n", (unsigned long long)liveBlocks,
+            (unsigned long long)liveBytes);
+    qsort(sites, n, sizeof(*sites), ByLiveBytes);
+    for (int i = 0; i < n && sites[i].liveBlocks; i++) {
+        fprintf(out, "%12llu %14llu %12s  %s\n", (unsigned long long)sites[i].liveBlocks,
+                (unsigned long long)sites[i].liveBytes, "", sites[i].name);
+    }
+}
+
+static void JsonString(FILE *out, const char *s) {
+    fputc('"', out);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') {
+            fprintf(out, "\\%c", *s);
+        } else if ((unsigned char)*s < ' ') {
+            fprintf(out, "\\u%04x", *s);
+        } else {
+            fputc(*s, out);
+        }
+    }
+    fputc('"', out);
+}
+
+static void JsonSites(FILE *out, int n, int liveOnly) {
+    const char *sep = "";
+    fprintf(out, "[");
+    for (int i = 0; i < n && (!liveOnly || sites[i].liveBlocks); i++) {
+        fprintf(out, "%s\n    {\"site\": ", sep);
+        JsonString(out, sites[i].name);
+        if (liveOnly) {
+            fprintf(out, ", \"blocks\": %llu, \"bytes\": %llu}",
+                    (unsigned long long)sites[i].liveBlocks,
+                    (unsigned long long)sites[i].liveBytes);
+        } else {
+            fprintf(out, ", \"allocations\": %llu, \"bytes\": %llu, \"frees\": %llu}",
+                    (unsigned long long)sites[i].allocs, (unsigned long long)sites[i].bytes,
+                    (unsigned long long)sites[i].frees);
+        }
+        sep = ",";
+    }
+    fprintf(out, "]");
+}
+
+static void JsonReport(FILE *out, int n) {
+    uint64_t allocs, bytes, liveBlocks;
+    Totals(n, &allocs, &bytes, &liveBlocks);
+    fprintf(out, "{\n  \"allocations\": %llu,\n  \"bytes\": %llu,\n  \"peakLiveBytes\": %llu,\n",
+            (unsigned long long)allocs, (unsigned long long)bytes,
+            (unsigned long long)peakLiveBytes);
+    fprintf(out, "  \"liveBlocks\": %llu,\n  \"liveBytes\": %llu,\n  \"sites\": ",
+            (unsigned long long)liveBlocks, (unsigned long long)liveBytes);
+    qsort(sites, n, sizeof(*sites), ByBytes);
+    JsonSites(out, n, 0);
+    fprintf(out, ",\n  \"live\": ");
+    qsort(sites, n, sizeof(*sites), ByLiveBytes);
+    JsonSites(out, n, 1);
+    fprintf(out, "\n}\n");
+}
+
+static void Report(void) {
+    const char *name = getenv("LACSAP_HEAP_PROFILE_FILE");
+    FILE *      out = stderr;
+    if (name && *name && !(out = fopen(name, "w"))) {
+        fprintf(stderr, "Can't write heap profile to %s\n", name);
+        return;
+    }
+    pthread_mutex_lock(&profileLock);
+    int n = MergeSites();
+    if (profileFormat == PF_Json) {
+        JsonReport(out, n);
+    } else {
+        TextReport(out, n);
+    }
+    pthread_mutex_unlock(&profileLock);
+    if (out != stderr) {
+        fclose(out);
+    }
+}
+
+/* Returns true if profiling is on. */
+int __profile_init(void) {
+    const char *s = getenv("LACSAP_HEAP_PROFILE");
+    if (!s || !*s || !strcmp(s, "0")) {
+        return 0;
+    }
+    profileFormat = (!strcmp(s, "json")) ? PF_Json : PF_Text;
+    atexit(Report);
+    return 1;
+}
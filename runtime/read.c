@@ -1,47 +1,102 @@
 #include "runtime.h"
 #include <ctype.h>
+#include <limits.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
-static int read_chunk_text(struct FileEntry *f) {
-    File *file = f->fileData;
-    if (file->isText & 2) {
-        int ch = fgetc(f->file);
-        f->readAhead = f->bufferSize = (ch != EOF);
-        return ch;
-    } else {
-        if (f->readPos != f->bufferSize) {
-            f->readAhead = 1;
-            return f->fileData->buffer[f->readPos++];
+/*******************************************
+ * Text input buffer
+ *******************************************
+ */
+/* Read more text into the buffer of f at to, with room for size characters. Returns the
+ * number of characters read.
+ */
+static size_t read_text(struct FileEntry *f, char *to, size_t size) {
+    if (f->fileData->isText & 2) {
+        /* Interactive, so only read a line at a time. */
+        if (size > 1 && fgets(to, size, f->file)) {
+            return strlen(to);
         }
+        return 0;
+    }
+    return fread(to, 1, size, f->file);
+}
 
-        int n;
-        if ((n = fread(file->buffer, 1, file->recordSize, f->file))) {
-            if (n > 0) {
-                f->bufferSize = n;
-                f->readAhead = 1;
-                f->readPos = 1;
-                return *file->buffer;
-            }
-        }
+/* Refill the text buffer of f, returning the number of characters read. */
+int __fill_text(struct FileEntry *f) {
+    if (f->async) {
+        size_t n = __async_read(f, &f->readBuffer);
+        f->readPos = f->readBuffer;
+        f->readEnd = f->readBuffer + n;
+        return n;
+    }
+    if (!f->readBuffer && !(f->readBuffer = malloc(TextBufferSize))) {
+        fprintf(stderr, "Out of memory for file buffer\n");
+        exit(11);
     }
-    return EOF;
+    size_t n = read_text(f, f->readBuffer, TextBufferSize);
+    f->readPos = f->readBuffer;
+    f->readEnd = f->readBuffer + n;
+    return n;
 }
 
-int get_next(struct FileEntry *f) {
-    return read_chunk_text(f);
+/* Move the unread text from start on to the front of the buffer of f, and read more behind
+ * it. Returns the number of characters added.
+ */
+static size_t extend_text(struct FileEntry *f, char **start) {
+    size_t keep = f->readEnd - *start;
+    size_t current = f->readPos - *start;
+    if (f->async) {
+        /* The next buffer has room in front of it for what is kept. */
+        char   kept[NumberLookahead];
+        char * data;
+        memcpy(kept, *start, keep);
+        size_t n = __async_read(f, &data);
+        *start = data - keep;
+        memcpy(*start, kept, keep);
+        f->readBuffer = *start;
+        f->readPos = *start + current;
+        f->readEnd = data + n;
+        return n;
+    }
+    memmove(f->readBuffer, *start, keep);
+    size_t n = read_text(f, f->readBuffer + keep, TextBufferSize - keep);
+    *start = f->readBuffer;
+    f->readPos = f->readBuffer + current;
+    f->readEnd = f->readBuffer + keep + n;
+    return n;
+}
+
+/* Make sure there is a current character, unless at end of file. */
+static inline int have_text(File *file) {
+    return fileEntry(file)->readAhead || getText(file);
 }
 
-/* Make a local function so it can inline */
-static int __get_text(File *file) {
-    struct FileEntry *f = &files[file->handle];
-    int               ch = get_next(f);
-    *file->buffer = ch;
-    if (ch == EOF) {
-        f->readAhead = 0;
+/* Copy up to max characters of the current line into dest, leaving the newline (or the
+ * character after the last one copied) as the current character. Returns the number of
+ * characters copied.
+ */
+static size_t read_line(File *file, char *dest, size_t max) {
+    struct FileEntry *f = fileEntry(file);
+    size_t            count = 0;
+    if (!have_text(file)) {
         return 0;
     }
-    return 1;
+    while (count < max && f->readAhead && *file->buffer != '\n') {
+        dest[count++] = *file->buffer;
+        size_t avail = f->readEnd - f->readPos;
+        if (avail > max - count) {
+            avail = max - count;
+        }
+        char * nl = memchr(f->readPos, '\n', avail);
+        size_t run = (nl) ? (size_t)(nl - f->readPos) : avail;
+        memcpy(&dest[count], f->readPos, run);
+        count += run;
+        f->readPos += run;
+        getText(file);
+    }
+    return count;
 }
 
 /*******************************************
@@ -49,19 +104,15 @@ static int __get_text(File *file) {
  *******************************************
  */
 int __eof(File *file) {
-    if (!files[file->handle].readAhead) {
-        if (!__get_text(file)) {
-            return 1;
-        }
+    if (!file->isText) {
+        return !fileEntry(file)->readAhead;
     }
-    return 0;
+    return !have_text(file);
 }
 
 int __eoln(File *file) {
-    if (!files[file->handle].readAhead) {
-        if (!__get_text(file)) {
-            return 1;
-        }
+    if (!have_text(file)) {
+        return 1;
     }
     return *file->buffer == '\n';
 }
@@ -72,174 +123,163 @@ int __eoln(File *file) {
  */
 static void skip_spaces(File *file) {
     while (isspace(*file->buffer) && !__eof(file)) {
-        __get_text(file);
+        getText(file);
     }
 }
 
-static int get_sign(File *file) {
-    if (*file->buffer == '-') {
-        __get_text(file);
-        return -1;
-    } else if (*file->buffer == '+') {
-        __get_text(file);
+/* Skip to the number that starts at the current character, and return where it is in the
+ * buffer. Numbers are parsed straight from the buffer, so make sure that the unread text
+ * holds a whole number - unless it is longer than NumberLookahead characters.
+ */
+static char *number_start(File *file) {
+    struct FileEntry *f = fileEntry(file);
+    if (!f->readAhead) {
+        getText(file);
     }
-    return 1;
-}
-
-// Turn an exponent into a multiplier value.
-static double exponent_to_multi(int exponent) {
-    double m = 1.0;
-    int    oneover = 0;
-    if (exponent < 0) {
-        oneover = 1;
-        exponent = -exponent;
+    skip_spaces(file);
+    if (!f->readAhead) {
+        return f->readPos;
     }
-    while (exponent > 0) {
-        if (exponent & 1) {
-            m *= 10.0;
-            exponent--;
-        } else {
-            m *= 100.0;
-            exponent -= 2;
-        }
+    char *start = f->readPos - 1;
+    if (f->readEnd - start < NumberLookahead && !memchr(start, '\n', f->readEnd - start)) {
+        extend_text(f, &start);
     }
-    if (oneover) {
-        return 1.0 / m;
+    return start;
+}
+
+/* Continue reading after the number that finished at next. */
+static void number_end(File *file, const char *start, const char *next, int status) {
+    if (status == PS_Overflow) {
+        __NumberRangeError(start, next);
     }
-    return m;
+    fileEntry(file)->readPos = (char *)next;
+    getText(file);
 }
 
 void __read_int(File *file, int *v) {
-    int n = 0;
-    int sign;
+    int64_t     n = 0;
+    const char *next;
 
-    if (file->handle >= MaxPascalFiles) {
+    if (!validFile(file)) {
         return;
     }
-    if (!files[file->handle].readAhead) {
-        __get_text(file);
+    char *start = number_start(file);
+    int   status = __ParseInt64(start, fileEntry(file)->readEnd, INT_MIN, INT_MAX, &n, &next);
+    number_end(file, start, next, status);
+    *v = n;
+}
+
+void __read_int64(File *file, int64_t *v) {
+    int64_t     n = 0;
+    const char *next;
+
+    if (!validFile(file)) {
+        return;
     }
-    skip_spaces(file);
-    sign = get_sign(file);
-    while (isdigit(*file->buffer)) {
-        n *= 10;
-        n += (*file->buffer) - '0';
-        if (!__get_text(file)) {
-            break;
-        }
+    char *start = number_start(file);
+    int status = __ParseInt64(start, fileEntry(file)->readEnd, INT64_MIN, INT64_MAX, &n, &next);
+    number_end(file, start, next, status);
+    *v = n;
+}
+
+/* Read into an unsigned subrange: there can't be a minus sign, and the value must be at
+ * most max.
+ */
+void __read_uint(File *file, int *v, int max) {
+    int64_t     n = 0;
+    const char *next;
+
+    if (!validFile(file)) {
+        return;
     }
-    *v = n * sign;
+    char *start = number_start(file);
+    int   status = __ParseInt64(start, fileEntry(file)->readEnd, 0, max, &n, &next);
+    number_end(file, start, next, status);
+    *v = n;
 }
 
 void __read_chr(File *file, char *v) {
-    if (file->handle >= MaxPascalFiles) {
+    if (!validFile(file)) {
         return;
     }
 
-    if (!files[file->handle].readAhead) {
-        __get_text(file);
+    if (!fileEntry(file)->readAhead) {
+        getText(file);
     }
 
     *v = *file->buffer;
-    __get_text(file);
+    getText(file);
 }
 
 void __read_real(File *file, double *v) {
-    double n = 0;
-    double divisor = 1.0;
-    double multiplicand = 1.0;
-    int    exponent = 0;
-    int    sign;
+    double      n = 0;
+    const char *next;
 
-    if (file->handle >= MaxPascalFiles) {
+    if (!validFile(file)) {
         return;
     }
-    if (!files[file->handle].readAhead) {
-        __get_text(file);
-    }
-
-    skip_spaces(file);
-    sign = get_sign(file);
-
-    while (isdigit(*file->buffer)) {
-        n *= 10.0;
-        n += (*file->buffer) - '0';
-        if (!__get_text(file)) {
-            break;
-        }
-    }
-    if (*file->buffer == '.') {
-        __get_text(file);
-        while (isdigit(*file->buffer)) {
-            n *= 10.0;
-            n += (*file->buffer) - '0';
-            divisor *= 10.0;
-            if (!__get_text(file)) {
-                break;
-            }
-        }
-    }
-    if (*file->buffer == 'e' || *file->buffer == 'E') {
-        __get_text(file);
-        int expsign = get_sign(file);
-        while (isdigit(*file->buffer) && !__eoln(file)) {
-            exponent *= 10;
-            exponent += (*file->buffer) - '0';
-            if (!__get_text(file)) {
-                break;
-            }
-        }
-        exponent *= expsign;
-        multiplicand = exponent_to_multi(exponent);
-    }
-    n = n * sign / divisor * multiplicand;
+    char *start = number_start(file);
+    int   status = __ParseReal(start, fileEntry(file)->readEnd, &n, &next);
+    number_end(file, start, next, status);
     *v = n;
 }
 
 void __read_nl(File *file) {
-    if (!files[file->handle].readAhead) {
-        if (!__get_text(file)) {
-            return;
-        }
+    struct FileEntry *f = fileEntry(file);
+    if (!have_text(file)) {
+        return;
     }
     while (*file->buffer != '\n') {
-        if (!__get_text(file))
+        char *nl = memchr(f->readPos, '\n', f->readEnd - f->readPos);
+        if (nl) {
+            f->readPos = nl;
+        } else {
+            f->readPos = f->readEnd;
+        }
+        if (!getText(file)) {
             break;
+        }
     }
-    files[file->handle].readAhead = 0;
+    f->readAhead = 0;
 }
 
 void __read_str(File *file, String *val) {
-    char   buffer[256];
+    if (!validFile(file)) {
+        return;
+    }
+    val->len = read_line(file, (char *)val->str, MaxStringLen);
+}
+
+void __read_lstr(File *file, char **val) {
+    size_t size = 256;
     size_t count = 0;
+    char * buffer;
 
-    if (file->handle >= MaxPascalFiles) {
+    if (!validFile(file)) {
         return;
     }
-    if (!files[file->handle].readAhead) {
-        __get_text(file);
+    if (!(buffer = malloc(size))) {
+        fprintf(stderr, "Out of memory for string\n");
+        exit(11);
     }
-    while (*file->buffer != '\n' && count < sizeof(buffer)) {
-        buffer[count++] = *file->buffer;
-        if (!__get_text(file)) {
+    for (;;) {
+        count += read_line(file, &buffer[count], size - count);
+        if (count < size) {
             break;
         }
+        size *= 2;
+        if (!(buffer = realloc(buffer, size))) {
+            fprintf(stderr, "Out of memory for string of length %zu\n", size);
+            exit(11);
+        }
     }
-    val->len = count;
-    memcpy(val->str, buffer, count);
+    __LStrAssign(val, __LStrFromChars(buffer, count));
+    free(buffer);
 }
 
-void __read_chars(File *file, char *v) {
-    if (file->handle >= MaxPascalFiles) {
+void __read_chars(File *file, char *v, int len) {
+    if (!validFile(file)) {
         return;
     }
-    if (!files[file->handle].readAhead) {
-        __get_text(file);
-    }
-    while (*file->buffer != '\n') {
-        *v++ = *file->buffer;
-        if (!__get_text(file)) {
-            break;
-        }
-    }
+    read_line(file, v, len);
 }
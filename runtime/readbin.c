@@ -3,8 +3,8 @@
 
 void __read_bin(File *file, void *val) {
     struct FileEntry *f = 0;
-    if (file->handle < MaxPascalFiles && files[file->handle].inUse) {
-        f = &files[file->handle];
+    if (validFile(file)) {
+        f = fileEntry(file);
     }
     if (!f) {
         fprintf(stderr, "Invalid file used for read binary\n");
@@ -1,5 +1,6 @@
 #include <assert.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 
 /*******************************************
@@ -8,8 +9,15 @@
  */
 /* Max number/size values */
 enum {
-    MaxPascalFiles = 1000,
+    FileChunkSize = 1024,
+    MaxFileChunks = 16384,
     MaxStringLen = 255,
+    FormatIntSize = 20,
+    FormatRealSize = 512,
+    WriteBufferSize = 4096,
+    TextBufferSize = 65536,
+    RecordBufferSize = 65536,
+    NumberLookahead = 512,
 };
 
 /*******************************************
@@ -29,9 +37,27 @@ struct FileEntry {
     FILE *file;
     char *name;
     int   inUse;
+    int   temporary;
+    int   nextFree;
     int   readAhead;
-    int   readPos;
-    int   bufferSize;
+    int   writable;
+    /* Input: the characters (or records) from readPos to readEnd haven't been read yet. */
+    char *readBuffer;
+    char *readPos;
+    char *readEnd;
+    /* Record output: the records from writeBuffer to writePos haven't been written yet. */
+    char *writeBuffer;
+    char *writePos;
+    char *writeEnd;
+    /* Mapped record file: the file is from map to mapEnd, and the buffer variable points
+     * into it. ownBuffer is the buffer variable to go back to when it isn't mapped. */
+    char *map;
+    char *mapEnd;
+    char *ownBuffer;
+
+    /* Background I/O, when there is a helper thread for the file. */
+    struct AsyncIO *async;
+    int             wantAsync;
 };
 
 typedef struct {
@@ -39,11 +65,47 @@ typedef struct {
     unsigned char str[MaxStringLen];
 } String;
 
+/* Kinds of argument to __write_args and __writestr_args. Note: This should match the compiler
+ * too.
+ */
+enum WriteKind {
+    WK_Int,
+    WK_Real,
+    WK_Char,
+    WK_Bool,
+    WK_Str,
+    WK_Chars,
+    WK_LStr,
+};
+
+/* Describes one argument of a write or writeln. */
+typedef struct {
+    int kind;
+    int width;
+    int precision;
+    int len;
+    union {
+        int64_t     i;
+        double      r;
+        const void *p;
+    } v;
+} WriteArg;
+
+/* Stored just before the characters of a long string. */
+typedef struct {
+    int refCount;
+    int length;
+    /* Characters there is room for, which may be more than length after an append. */
+    int capacity;
+} LongStringHeader;
+
 /*******************************************
  * Local variables
  *******************************************
  */
-extern struct FileEntry files[];
+/* The file table grows a chunk at a time, and chunks never move, so an entry stays put while
+ * other threads open files. */
+extern struct FileEntry *fileChunks[MaxFileChunks];
 
 /*******************************************
  * External variables
@@ -56,23 +118,112 @@ extern File output;
  * Function declarations
  *******************************************
  */
+void InitAlloc();
 void InitFiles();
 void SetupFile(File *f, int recSize, int isText);
+void AdviseSequential(FILE *f);
 
 /*******************************************
  * File Basics, low level I/O.
  *******************************************
  */
+static inline struct FileEntry *fileEntry(File *f) {
+    return &fileChunks[f->handle / FileChunkSize][f->handle % FileChunkSize];
+}
+
+static inline int validFile(File *f) {
+    unsigned h = f->handle;
+    return h < FileChunkSize * MaxFileChunks && fileChunks[h / FileChunkSize] &&
+           fileEntry(f)->inUse;
+}
+
 static inline FILE *getFile(File *f) {
-    if (f->handle < MaxPascalFiles && files[f->handle].inUse) {
-        return files[f->handle].file;
+    if (validFile(f)) {
+        return fileEntry(f)->file;
     }
     return NULL;
 }
 
+int __fill_text(struct FileEntry *f);
+
+/* Make the next character of a text file the current one, in the file buffer. Returns 0 at
+ * the end of the file.
+ */
+static inline int getText(File *file) {
+    struct FileEntry *f = fileEntry(file);
+    if (f->readPos == f->readEnd && !__fill_text(f)) {
+        *file->buffer = EOF;
+        f->readAhead = 0;
+        return 0;
+    }
+    *file->buffer = *f->readPos++;
+    f->readAhead = 1;
+    return 1;
+}
+
 int  __get(File *file);
 void __put(File *file);
+void __put_record(File *file, const void *rec);
+void __flush_records(struct FileEntry *f);
+void __write_text(File *file, const char *s, size_t len);
+void __seek_read(File *file, int n);
+void __set_read_position(File *file, int n);
+int  __position(File *file);
+int  __last_position(File *file);
+void __unmap_file(File *file);
 int  __eof(File *file);
 int  __eoln(File *file);
 void __assign(File *f, char *name);
 void __assign_unnamed(File *f);
+void __release_file(File *f);
+void __close(File *f);
+
+/*******************************************
+ * Heap profiler
+ *******************************************
+ */
+int    __profile_init(void);
+void   __profile_new(void *p, size_t size, const char *site, int inRegion);
+void   __profile_dispose(void *p);
+size_t __profile_mark(void);
+void   __profile_release(size_t mark);
+
+/*******************************************
+ * Background I/O
+ *******************************************
+ */
+void   __async_start(File *file, int writing);
+size_t __async_read(struct FileEntry *f, char **data);
+void   __async_write(struct FileEntry *f);
+void   __async_stop(struct FileEntry *f);
+
+/*******************************************
+ * Number formatting
+ *******************************************
+ */
+int __FormatInt64(char *buf, int64_t v);
+int __FormatReal(char *buf, int size, double v, int width, int precision);
+
+/*******************************************
+ * Number parsing
+ *******************************************
+ */
+enum ParseStatus {
+    PS_Ok,
+    PS_NoNumber,
+    PS_Overflow,
+};
+
+int  __ParseInt64(const char *s, const char *end, int64_t min, int64_t max, int64_t *v,
+                  const char **next);
+int  __ParseReal(const char *s, const char *end, double *v, const char **next);
+void __NumberRangeError(const char *s, const char *end);
+
+/*******************************************
+ * Long strings
+ *******************************************
+ */
+char *__LStrFromChars(const char *str, int len);
+char *__LStrConcat(char *a, char *b);
+void  __LStrAssign(char **dest, char *src);
+void  __LStrReleaseTemp(char *s);
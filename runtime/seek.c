@@ -0,0 +1,158 @@
+#define _POSIX_C_SOURCE 200112L
+#include "runtime.h"
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+/*******************************************
+ * Random access to record files.
+ *
+ * Positions count records from zero. Moving
+ * to a position discards the input buffer
+ * and writes out the output buffer.
+ *******************************************
+ */
+static void SeekRecord(File *file, struct FileEntry *f, int n) {
+    __async_stop(f);
+    __flush_records(f);
+    fseeko(f->file, (off_t)n * file->recordSize, SEEK_SET);
+    f->readPos = f->readEnd = f->readBuffer;
+    f->readAhead = 0;
+}
+
+static void SeekError(const char *op, int n, int last) {
+    fprintf(stderr, "%s of element %d in a file with elements 0..%d\n", op, n, last);
+    exit(1);
+}
+
+/* Make element n the current one, for reading, where n may also be the end of the file. */
+void __set_read_position(File *file, int n) {
+    struct FileEntry *f = fileEntry(file);
+    if (f->map) {
+        char *rec = f->map + (size_t)n * file->recordSize;
+        if (n >= 0 && rec < f->mapEnd) {
+            file->buffer = rec;
+            f->readAhead = 1;
+        } else {
+            file->buffer = f->ownBuffer;
+            f->readAhead = 0;
+        }
+        return;
+    }
+    SeekRecord(file, f, n);
+    __get(file);
+}
+
+void __seek_read(File *file, int n) {
+    int last = __last_position(file);
+    if (n < 0 || n > last) {
+        SeekError("SeekRead", n, last);
+    }
+    __set_read_position(file, n);
+}
+
+/* Make element n the next one to be written. */
+void __seek_write(File *file, int n) {
+    struct FileEntry *f = fileEntry(file);
+    int               last = __last_position(file);
+    if (n < 0 || n > last + 1) {
+        SeekError("SeekWrite", n, last);
+    }
+    __unmap_file(file);
+    if (!f->writable) {
+        /* Opened by reset, so reopen for update. */
+        f->file = freopen(f->name, "r+", f->file);
+        if (!f->file) {
+            fprintf(stderr, "Attempt to open file for writing failed\n");
+            exit(1);
+        }
+        f->writable = 1;
+    }
+    SeekRecord(file, f, n);
+}
+
+/* The position of the current element (when reading) or the next one to be written. */
+int __position(File *file) {
+    struct FileEntry *f = fileEntry(file);
+    if (f->map) {
+        char *rec = (f->readAhead) ? file->buffer : f->mapEnd;
+        return (rec - f->map) / file->recordSize;
+    }
+    __async_stop(f);
+    off_t pos = ftello(f->file) + (f->writePos - f->writeBuffer) - (f->readEnd - f->readPos);
+    return pos / file->recordSize - f->readAhead;
+}
+
+/* The position of the last element, -1 if the file is empty. */
+int __last_position(File *file) {
+    struct FileEntry *f = fileEntry(file);
+    if (f->map) {
+        return (f->mapEnd - f->map) / file->recordSize - 1;
+    }
+    __async_stop(f);
+    __flush_records(f);
+    off_t pos = ftello(f->file);
+    fseeko(f->file, 0, SEEK_END);
+    off_t size = ftello(f->file);
+    fseeko(f->file, pos, SEEK_SET);
+    return size / file->recordSize - 1;
+}
+
+/*******************************************
+ * Memory mapped record files.
+ *
+ * The whole file is mapped, and the buffer
+ * variable points at the current element,
+ * so get and SeekRead are just pointer
+ * arithmetic. The mapping is private, so
+ * changing the buffer variable is fine, but
+ * writing to the file goes back to normal
+ * buffered I/O.
+ *******************************************
+ */
+void __map_file(File *file) {
+    struct FileEntry *f = fileEntry(file);
+    struct stat       st;
+    if (f->map || !f->file || file->isText) {
+        return;
+    }
+    /* __position also stops any background I/O. */
+    int n = __position(file);
+    __flush_records(f);
+    fflush(f->file);
+    if (fstat(fileno(f->file), &st) || st.st_size < file->recordSize) {
+        return;
+    }
+    size_t size = st.st_size / file->recordSize * file->recordSize;
+    void * map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno(f->file), 0);
+    if (map == MAP_FAILED) {
+        /* Mapping is only an optimisation, so carry on as before. */
+        return;
+    }
+    /* Mostly used for lookups, so don't read ahead much. */
+    posix_madvise(map, size, POSIX_MADV_RANDOM);
+    f->map = map;
+    f->mapEnd = f->map + size;
+    f->ownBuffer = file->buffer;
+    __set_read_position(file, n);
+}
+
+/* Go back to buffered I/O, at the same position. */
+void __unmap_file(File *file) {
+    struct FileEntry *f = fileEntry(file);
+    if (!f->map) {
+        return;
+    }
+    int n = __position(file);
+    if (f->readAhead) {
+        memcpy(f->ownBuffer, file->buffer, file->recordSize);
+    }
+    file->buffer = f->ownBuffer;
+    munmap(f->map, f->mapEnd - f->map);
+    f->map = f->mapEnd = NULL;
+    /* The current element has been read already. */
+    fseeko(f->file, (off_t)(n + f->readAhead) * file->recordSize, SEEK_SET);
+    f->readPos = f->readEnd = f->readBuffer;
+}
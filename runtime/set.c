@@ -1,6 +1,12 @@
 #include "runtime.h"
+#include <pthread.h>
 #include <string.h>
 
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define SET_SIMD 1
+#include <immintrin.h>
+#endif
+
 /*******************************************
  * Set functions
  *******************************************
@@ -11,36 +17,236 @@ typedef struct {
 } Set;
 
 /*******************************************
- * Set functions
+ * Generic (word by word) kernels.
  *******************************************
  */
-int __SetEqual(Set *a, Set *b, int setWords) {
+static int SetEqualWords(Set *a, Set *b, int setWords) {
     return !memcmp(a->v, b->v, sizeof(*a) * setWords);
 }
 
-void __SetUnion(Set *res, Set *a, Set *b, int setWords) {
+static void SetUnionWords(Set *res, Set *a, Set *b, int setWords) {
     for (int i = 0; i < setWords; i++) {
         res->v[i] = a->v[i] | b->v[i];
     }
 }
 
-void __SetDiff(Set *res, Set *a, Set *b, int setWords) {
+static void SetDiffWords(Set *res, Set *a, Set *b, int setWords) {
     for (int i = 0; i < setWords; i++) {
         res->v[i] = a->v[i] & ~b->v[i];
     }
 }
 
-void __SetIntersect(Set *res, Set *a, Set *b, int setWords) {
+static void SetIntersectWords(Set *res, Set *a, Set *b, int setWords) {
     for (int i = 0; i < setWords; i++) {
         res->v[i] = a->v[i] & b->v[i];
     }
 }
 
-/* Check if all values in a are in set b. */
-int __SetContains(Set *a, Set *b, int setWords) {
+static int SetContainsWords(Set *a, Set *b, int setWords) {
     for (int i = 0; i < setWords; i++) {
         if ((a->v[i] & b->v[i]) != a->v[i])
             return 0;
     }
     return 1;
 }
+
+#if SET_SIMD
+/*******************************************
+ * SSE2 kernels, 4 words at a time.
+ *******************************************
+ */
+#define SSE2_WORDS 4
+
+__attribute__((target("sse2"))) static int SetEqualSSE2(Set *a, Set *b, int setWords) {
+    int i = 0;
+    for (; i + SSE2_WORDS <= setWords; i += SSE2_WORDS) {
+        __m128i x = _mm_loadu_si128((const __m128i *)&a->v[i]);
+        __m128i y = _mm_loadu_si128((const __m128i *)&b->v[i]);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(x, y)) != 0xFFFF)
+            return 0;
+    }
+    return SetEqualWords((Set *)&a->v[i], (Set *)&b->v[i], setWords - i);
+}
+
+__attribute__((target("sse2"))) static void SetUnionSSE2(Set *res, Set *a, Set *b, int setWords) {
+    int i = 0;
+    for (; i + SSE2_WORDS <= setWords; i += SSE2_WORDS) {
+        __m128i x = _mm_loadu_si128((const __m128i *)&a->v[i]);
+        __m128i y = _mm_loadu_si128((const __m128i *)&b->v[i]);
+        _mm_storeu_si128((__m128i *)&res->v[i], _mm_or_si128(x, y));
+    }
+    SetUnionWords((Set *)&res->v[i], (Set *)&a->v[i], (Set *)&b->v[i], setWords - i);
+}
+
+__attribute__((target("sse2"))) static void SetDiffSSE2(Set *res, Set *a, Set *b, int setWords) {
+    int i = 0;
+    for (; i + SSE2_WORDS <= setWords; i += SSE2_WORDS) {
+        __m128i x = _mm_loadu_si128((const __m128i *)&a->v[i]);
+        __m128i y = _mm_loadu_si128((const __m128i *)&b->v[i]);
+        /* andnot computes ~first & second */
+        _mm_storeu_si128((__m128i *)&res->v[i], _mm_andnot_si128(y, x));
+    }
+    SetDiffWords((Set *)&res->v[i], (Set *)&a->v[i], (Set *)&b->v[i], setWords - i);
+}
+
+__attribute__((target("sse2"))) static void SetIntersectSSE2(Set *res, Set *a, Set *b,
+                                                             int setWords) {
+    int i = 0;
+    for (; i + SSE2_WORDS <= setWords; i += SSE2_WORDS) {
+        __m128i x = _mm_loadu_si128((const __m128i *)&a->v[i]);
+        __m128i y = _mm_loadu_si128((const __m128i *)&b->v[i]);
+        _mm_storeu_si128((__m128i *)&res->v[i], _mm_and_si128(x, y));
+    }
+    SetIntersectWords((Set *)&res->v[i], (Set *)&a->v[i], (Set *)&b->v[i], setWords - i);
+}
+
+__attribute__((target("sse2"))) static int SetContainsSSE2(Set *a, Set *b, int setWords) {
+    int     i = 0;
+    __m128i outside = _mm_setzero_si128();
+    for (; i + SSE2_WORDS <= setWords; i += SSE2_WORDS) {
+        __m128i x = _mm_loadu_si128((const __m128i *)&a->v[i]);
+        __m128i y = _mm_loadu_si128((const __m128i *)&b->v[i]);
+        outside = _mm_or_si128(outside, _mm_andnot_si128(y, x));
+    }
+    if (_mm_movemask_epi8(_mm_cmpeq_epi32(outside, _mm_setzero_si128())) != 0xFFFF)
+        return 0;
+    return SetContainsWords((Set *)&a->v[i], (Set *)&b->v[i], setWords - i);
+}
+
+/*******************************************
+ * AVX2 kernels, 8 words at a time, with the
+ * remainder handled by the SSE2 kernels.
+ *******************************************
+ */
+#define AVX2_WORDS 8
+
+__attribute__((target("avx2"))) static int SetEqualAVX2(Set *a, Set *b, int setWords) {
+    int i = 0;
+    for (; i + AVX2_WORDS <= setWords; i += AVX2_WORDS) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)&a->v[i]);
+        __m256i y = _mm256_loadu_si256((const __m256i *)&b->v[i]);
+        if (!_mm256_testz_si256(_mm256_xor_si256(x, y), _mm256_xor_si256(x, y)))
+            return 0;
+    }
+    return SetEqualSSE2((Set *)&a->v[i], (Set *)&b->v[i], setWords - i);
+}
+
+__attribute__((target("avx2"))) static void SetUnionAVX2(Set *res, Set *a, Set *b, int setWords) {
+    int i = 0;
+    for (; i + AVX2_WORDS <= setWords; i += AVX2_WORDS) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)&a->v[i]);
+        __m256i y = _mm256_loadu_si256((const __m256i *)&b->v[i]);
+        _mm256_storeu_si256((__m256i *)&res->v[i], _mm256_or_si256(x, y));
+    }
+    SetUnionSSE2((Set *)&res->v[i], (Set *)&a->v[i], (Set *)&b->v[i], setWords - i);
+}
+
+__attribute__((target("avx2"))) static void SetDiffAVX2(Set *res, Set *a, Set *b, int setWords) {
+    int i = 0;
+    for (; i + AVX2_WORDS <= setWords; i += AVX2_WORDS) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)&a->v[i]);
+        __m256i y = _mm256_loadu_si256((const __m256i *)&b->v[i]);
+        _mm256_storeu_si256((__m256i *)&res->v[i], _mm256_andnot_si256(y, x));
+    }
+    SetDiffSSE2((Set *)&res->v[i], (Set *)&a->v[i], (Set *)&b->v[i], setWords - i);
+}
+
+__attribute__((target("avx2"))) static void SetIntersectAVX2(Set *res, Set *a, Set *b,
+                                                             int setWords) {
+    int i = 0;
+    for (; i + AVX2_WORDS <= setWords; i += AVX2_WORDS) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)&a->v[i]);
+        __m256i y = _mm256_loadu_si256((const __m256i *)&b->v[i]);
+        _mm256_storeu_si256((__m256i *)&res->v[i], _mm256_and_si256(x, y));
+    }
+    SetIntersectSSE2((Set *)&res->v[i], (Set *)&a->v[i], (Set *)&b->v[i], setWords - i);
+}
+
+__attribute__((target("avx2"))) static int SetContainsAVX2(Set *a, Set *b, int setWords) {
+    int i = 0;
+    for (; i + AVX2_WORDS <= setWords; i += AVX2_WORDS) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)&a->v[i]);
+        __m256i y = _mm256_loadu_si256((const __m256i *)&b->v[i]);
+        /* testc returns 1 if (~y & x) is all zeros, i.e. x is a subset of y */
+        if (!_mm256_testc_si256(y, x))
+            return 0;
+    }
+    return SetContainsSSE2((Set *)&a->v[i], (Set *)&b->v[i], setWords - i);
+}
+#endif
+
+/*******************************************
+ * Runtime dispatch.
+ *******************************************
+ */
+typedef int (*SetCompareFunc)(Set *a, Set *b, int setWords);
+typedef void (*SetOperFunc)(Set *res, Set *a, Set *b, int setWords);
+
+static struct {
+    SetCompareFunc equal;
+    SetCompareFunc contains;
+    SetOperFunc    unionOp;
+    SetOperFunc    diff;
+    SetOperFunc    intersect;
+} setOps;
+
+static void SetSelectKernels(void) {
+    setOps.equal = SetEqualWords;
+    setOps.contains = SetContainsWords;
+    setOps.unionOp = SetUnionWords;
+    setOps.diff = SetDiffWords;
+    setOps.intersect = SetIntersectWords;
+#if SET_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        setOps.equal = SetEqualAVX2;
+        setOps.contains = SetContainsAVX2;
+        setOps.unionOp = SetUnionAVX2;
+        setOps.diff = SetDiffAVX2;
+        setOps.intersect = SetIntersectAVX2;
+    } else if (__builtin_cpu_supports("sse2")) {
+        setOps.equal = SetEqualSSE2;
+        setOps.contains = SetContainsSSE2;
+        setOps.unionOp = SetUnionSSE2;
+        setOps.diff = SetDiffSSE2;
+        setOps.intersect = SetIntersectSSE2;
+    }
+#endif
+}
+
+/* The kernels are picked by the first set operation, which may be in any thread. */
+static pthread_once_t setOpsOnce = PTHREAD_ONCE_INIT;
+
+static inline void SetEnsureKernels(void) {
+    pthread_once(&setOpsOnce, SetSelectKernels);
+}
+
+/*******************************************
+ * Set functions
+ *******************************************
+ */
+int __SetEqual(Set *a, Set *b, int setWords) {
+    SetEnsureKernels();
+    return setOps.equal(a, b, setWords);
+}
+
+void __SetUnion(Set *res, Set *a, Set *b, int setWords) {
+    SetEnsureKernels();
+    setOps.unionOp(res, a, b, setWords);
+}
+
+void __SetDiff(Set *res, Set *a, Set *b, int setWords) {
+    SetEnsureKernels();
+    setOps.diff(res, a, b, setWords);
+}
+
+void __SetIntersect(Set *res, Set *a, Set *b, int setWords) {
+    SetEnsureKernels();
+    setOps.intersect(res, a, b, setWords);
+}
+
+/* Check if all values in a are in set b. */
+int __SetContains(Set *a, Set *b, int setWords) {
+    SetEnsureKernels();
+    return setOps.contains(a, b, setWords);
+}
@@ -18,6 +18,57 @@ void __StrConcat(String *res, String *a, String *b) {
     memcpy(&res->str[a->len], b->str, blen);
 }
 
+typedef struct {
+    const unsigned char *str;
+    int                  len;
+} StrPiece;
+
+static int Overlaps(const StrPiece *p, const String *s) {
+    return p->str < (const unsigned char *)(s + 1) && p->str + p->len > (const unsigned char *)s;
+}
+
+/* Concatenate count pieces into res, copying each piece once. If the first piece is
+ * res itself, the rest is appended to it in place. A later piece that overlaps res is
+ * read before res is modified.
+ */
+void __StrConcatN(String *res, const StrPiece *pieces, int count) {
+    String  tmp;
+    String *dest = res;
+    int     first = 0;
+    int     pos = 0;
+    int     total = 0;
+    for (int i = 0; i < count; i++) {
+        total += pieces[i].len;
+    }
+    if (total > MaxStringLen) {
+        total = MaxStringLen;
+    }
+    if (count && pieces[0].str == res->str) {
+        first = 1;
+        pos = pieces[0].len;
+    }
+    for (int i = first; i < count; i++) {
+        if (Overlaps(&pieces[i], res)) {
+            dest = &tmp;
+            break;
+        }
+    }
+
+    int start = pos;
+    for (int i = first; i < count && pos < total; i++) {
+        int len = pieces[i].len;
+        if (len > total - pos) {
+            len = total - pos;
+        }
+        memcpy(&dest->str[pos], pieces[i].str, len);
+        pos += len;
+    }
+    if (dest != res) {
+        memcpy(&res->str[start], &tmp.str[start], pos - start);
+    }
+    res->len = total;
+}
+
 /* Assign string b to string a. */
 void __StrAssign(String *a, String *b) {
     a->len = b->len;
@@ -35,30 +86,24 @@ int __StrCompare(String *a, String *b) {
     if (blen < shortest) {
         shortest = blen;
     }
-    for (int i = 0; i < shortest; i++) {
-        if (a->str[i] != b->str[i]) {
-            return a->str[i] - b->str[i];
-        }
+    int res = memcmp(a->str, b->str, shortest);
+    if (res) {
+        return res;
     }
     return alen - blen;
 }
 
-/* Return substring of input */
-String __StrCopy(String *str, int start, int len) {
+/* Return substring of input in result */
+void __StrCopy(String *result, String *str, int start, int len) {
     assert(start >= 1);
     assert(len >= 0);
 
     if (start > str->len) {
         len = 0;
-    }
-    if (start + len > str->len) {
-        len = str->len - start;
-        if (len < 0) {
-            len = 0;
-        }
+    } else if (start - 1 + len > str->len) {
+        len = str->len - (start - 1);
     }
 
-    String result = {len, ""};
-    memcpy(result.str, &str->str[start - 1], len);
-    return result;
+    result->len = len;
+    memcpy(result->str, &str->str[start - 1], len);
 }
@@ -1,12 +1,75 @@
 #include "runtime.h"
-#include <inttypes.h>
+#include <ctype.h>
+#include <limits.h>
 #include <stdint.h>
-#include <string.h>
 
-void __Val_int(const String *s, int *res) {
-    sscanf((const char *)s->str, "%d", res);
+/*******************************************
+ * Val: convert a string to a number.
+ *
+ * With a code variable, code is set to 0 if the whole string (after any leading spaces) is
+ * a valid number, otherwise to the position of the first bad character, or to the start of
+ * the number if it is out of range, and the result is left alone. Without one, a number at
+ * the start of the string is converted, and out of range is a runtime error.
+ *******************************************
+ */
+static inline const char *End(const String *s) {
+    return (const char *)s->str + s->len;
 }
 
-void __Val_long(const String *s, int64_t *res) {
-    sscanf((const char *)s->str, "%" PRId64, res);
+static const char *SkipSpaces(const String *s) {
+    const char *p = (const char *)s->str;
+    while (p < End(s) && isspace(*p)) {
+        p++;
+    }
+    return p;
+}
+
+/* Returns true if the result should be stored. */
+static int ValResult(const String *s, const char *start, const char *next, int status,
+                     int *code) {
+    const char *str = (const char *)s->str;
+    if (!code) {
+        if (status == PS_Overflow) {
+            __NumberRangeError(start, next);
+        }
+        return status == PS_Ok;
+    }
+    if (status != PS_Ok) {
+        *code = start - str + 1;
+    } else if (next != End(s)) {
+        *code = next - str + 1;
+    } else {
+        *code = 0;
+    }
+    return *code == 0;
+}
+
+void __Val_int(const String *s, int *res, int *code) {
+    const char *start = SkipSpaces(s);
+    const char *next;
+    int64_t     v;
+    int         status = __ParseInt64(start, End(s), INT_MIN, INT_MAX, &v, &next);
+    if (ValResult(s, start, next, status, code)) {
+        *res = v;
+    }
+}
+
+void __Val_long(const String *s, int64_t *res, int *code) {
+    const char *start = SkipSpaces(s);
+    const char *next;
+    int64_t     v;
+    int         status = __ParseInt64(start, End(s), INT64_MIN, INT64_MAX, &v, &next);
+    if (ValResult(s, start, next, status, code)) {
+        *res = v;
+    }
+}
+
+void __Val_real(const String *s, double *res, int *code) {
+    const char *start = SkipSpaces(s);
+    const char *next;
+    double      v;
+    int         status = __ParseReal(start, End(s), &v, &next);
+    if (ValResult(s, start, next, status, code)) {
+        *res = v;
+    }
 }
@@ -1,80 +1,204 @@
 #include "runtime.h"
-#include <inttypes.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 /*******************************************
  * Write Functionality
+ *
+ * A whole write or writeln is done by one call, which formats all the
+ * arguments into a buffer and hands it to stdio in one go. WriteStr and
+ * Str go through the same formatting, into a string instead.
  *******************************************
  */
-void __write_int(File *file, int v, int width) {
-    FILE *f = getFile(file);
-    fprintf(f, "%*d", width, v);
+typedef struct {
+    File *file;
+    /* For WriteStr, the string written to instead of file. */
+    String *str;
+    /* For WriteStr to a long string, the temporary long string built up instead. */
+    char *lstr;
+    int   pos;
+    char    buf[WriteBufferSize];
+} OutBuffer;
+
+static void Output(OutBuffer *out, const char *s, int len) {
+    if (out->file) {
+        __write_text(out->file, s, len);
+        return;
+    }
+    if (!out->str) {
+        out->lstr = __LStrConcat(out->lstr, __LStrFromChars(s, len));
+        return;
+    }
+    String *str = out->str;
+    if (len > MaxStringLen - str->len) {
+        len = MaxStringLen - str->len;
+    }
+    memcpy(&str->str[str->len], s, len);
+    str->len += len;
 }
 
-void __write_int64(File *file, int64_t v, int width) {
-    FILE *f = getFile(file);
-    fprintf(f, "%*" PRId64, width, v);
+static void Flush(OutBuffer *out) {
+    if (out->pos) {
+        Output(out, out->buf, out->pos);
+        out->pos = 0;
+    }
 }
 
-void __write_real(File *file, double v, int width, int precision) {
-    FILE *f = getFile(file);
-    if (precision > 0) {
-        fprintf(f, "%*.*f", width, precision, v);
-    } else {
-        if (width == 0) {
-            width = 13;
+static void PutChars(OutBuffer *out, const char *s, int len) {
+    if (len > WriteBufferSize - out->pos) {
+        Flush(out);
+        if (len > WriteBufferSize) {
+            Output(out, s, len);
+            return;
         }
-        precision = (width > 8) ? width - 7 : 1;
-        fprintf(f, "% *.*E", width, precision, v);
     }
+    memcpy(&out->buf[out->pos], s, len);
+    out->pos += len;
 }
 
-void __write_char(File *file, char v, int width) {
-    FILE *f = getFile(file);
-    if (width > 0) {
-        fprintf(f, "%*c", width, v);
-    } else {
-        fprintf(f, "%c", v);
+static void PutSpaces(OutBuffer *out, int n) {
+    while (n > 0) {
+        if (out->pos == WriteBufferSize) {
+            Flush(out);
+        }
+        int count = WriteBufferSize - out->pos;
+        if (count > n) {
+            count = n;
+        }
+        memset(&out->buf[out->pos], ' ', count);
+        out->pos += count;
+        n -= count;
     }
 }
 
-void __write_bool(File *file, int v, int width) {
-    FILE *      f = getFile(file);
-    const char *vstr = (v & 1) ? "TRUE" : "FALSE";
+/* The length up to any NUL, where printf's "%s" used to stop. */
+static int TextLength(const char *s, int len) {
+    const char *end = memchr(s, 0, len);
+    return (end) ? end - s : len;
+}
+
+/* Put len characters in a field of width characters. As with printf, a negative width
+ * means the characters are aligned to the left.
+ */
+static void PutField(OutBuffer *out, const char *s, int len, int width) {
+    int pad = abs(width) - len;
     if (width > 0) {
-        fprintf(f, "%*s", width, vstr);
-    } else {
-        fprintf(f, "%s", vstr);
+        PutSpaces(out, pad);
+    }
+    PutChars(out, s, len);
+    if (width < 0) {
+        PutSpaces(out, pad);
     }
 }
 
-void __write_chars(File *file, const char *v, int len, int width) {
-    FILE *f = getFile(file);
-    if (width > 0) {
-        if (len > width) {
-            len = width;
+static void PutArgs(OutBuffer *out, const WriteArg *args, int count) {
+    for (int i = 0; i < count; i++) {
+        const WriteArg *a = &args[i];
+        char            buf[FormatRealSize];
+        char *          big = NULL;
+        const char *    s = buf;
+        int             len = 0;
+        int             width = a->width;
+        switch (a->kind) {
+        case WK_Int:
+            len = __FormatInt64(buf, a->v.i);
+            break;
+
+        case WK_Real:
+            len = __FormatReal(buf, sizeof(buf), a->v.r, width, a->precision);
+            if (len >= (int)sizeof(buf)) {
+                /* Only a huge number or precision in fixed point gets here. */
+                if (!(big = malloc(len + 1))) {
+                    fprintf(stderr, "Out of memory\n");
+                    exit(11);
+                }
+                s = big;
+                __FormatReal(big, len + 1, a->v.r, width, a->precision);
+            }
+            if (a->precision <= 0 && width == 0) {
+                width = 13;
+            }
+            break;
+
+        case WK_Char:
+            buf[0] = (char)a->v.i;
+            len = 1;
+            break;
+
+        case WK_Bool:
+            s = (a->v.i & 1) ? "TRUE" : "FALSE";
+            len = strlen(s);
+            break;
+
+        case WK_Chars:
+            s = a->v.p;
+            len = a->len;
+            if (width > 0 && len > width) {
+                len = width;
+            }
+            len = TextLength(s, len);
+            break;
+
+        case WK_Str: {
+            const String *str = a->v.p;
+            s = (const char *)str->str;
+            len = TextLength(s, str->len);
+            /* Never padded on the left, only the right (for negative width). */
+            if (width > 0) {
+                width = 0;
+            }
+            break;
+        }
+
+        case WK_LStr:
+            s = a->v.p;
+            len = (s) ? ((LongStringHeader *)s)[-1].length : 0;
+            break;
+        }
+        /* Characters, booleans and long strings are never aligned left. */
+        if (width < 0 && a->kind != WK_Int && a->kind != WK_Real && a->kind != WK_Str) {
+            width = 0;
+        }
+        PutField(out, s, len, width);
+        free(big);
+        if (a->kind == WK_LStr) {
+            __LStrReleaseTemp((char *)a->v.p);
         }
-        fprintf(f, "%*.*s", width, len, v);
-    } else {
-        fprintf(f, "%.*s", len, v);
     }
 }
 
-void __write_str(File *file, const String *v, int width) {
-    FILE *f = getFile(file);
-    char  s[256];
-    memcpy(s, v->str, v->len);
-    s[v->len] = 0;
-    if (width < v->len) {
-        fprintf(f, "%*s", width, s);
-    } else {
-        fprintf(f, "%s", s);
+void __write_args(File *file, const WriteArg *args, int count, int newline) {
+    OutBuffer out;
+    out.file = file;
+    out.str = NULL;
+    out.pos = 0;
+    PutArgs(&out, args, count);
+    if (newline) {
+        PutChars(&out, "\n", 1);
     }
+    Flush(&out);
+}
+
+/* Append the arguments to s, keeping what fits. */
+void __writestr_args(String *s, const WriteArg *args, int count) {
+    OutBuffer out;
+    out.file = NULL;
+    out.str = s;
+    out.pos = 0;
+    PutArgs(&out, args, count);
+    Flush(&out);
 }
 
-void __write_nl(File *file) {
-    FILE *f = getFile(file);
-    fputc('\n', f);
+/* Assign the written arguments to *dest, however long they are. */
+void __writelstr_args(char **dest, const WriteArg *args, int count) {
+    OutBuffer out;
+    out.file = NULL;
+    out.str = NULL;
+    out.lstr = NULL;
+    out.pos = 0;
+    PutArgs(&out, args, count);
+    Flush(&out);
+    __LStrAssign(dest, out.lstr);
 }
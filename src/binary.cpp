@@ -139,7 +139,8 @@ bool CreateBinary(llvm::Module *module, const std::string &filename, EmitType em
             debugFlag = " -g";
         }
         std::string cmd = compiler + " " + modelStr + verboseflags + " " + objname + " -L\"" +
-                          libpath + "\" -lruntime" + modelStr + debugFlag + " -lm -o " + exename;
+                          libpath + "\" -lruntime" + modelStr + debugFlag + " -lm -lpthread -o " +
+                          exename;
         if (verbosity) {
             std::cerr << "Executing final link command: " << cmd << std::endl;
         }
@@ -166,6 +166,7 @@ class BuiltinFunctionVoid : public BuiltinFunctionBase {
   public:
     BuiltinFunctionVoid(const std::vector<ExprAST *> &a) : BuiltinFunctionBase(a) {}
     Types::TypeDecl *Type() const override { return Types::GetVoidType(); }
+    bool             ModifiesArgs() const override { return true; }
 };
 
 class BuiltinFunctionNew : public BuiltinFunctionVoid {
@@ -181,6 +182,18 @@ class BuiltinFunctionDispose : public BuiltinFunctionNew {
     llvm::Value *CodeGen(llvm::IRBuilder<> &builder) override;
 };
 
+class BuiltinFunctionMark : public BuiltinFunctionNew {
+  public:
+    BuiltinFunctionMark(const std::vector<ExprAST *> &a) : BuiltinFunctionNew(a) {}
+    llvm::Value *CodeGen(llvm::IRBuilder<> &builder) override;
+};
+
+class BuiltinFunctionRelease : public BuiltinFunctionNew {
+  public:
+    BuiltinFunctionRelease(const std::vector<ExprAST *> &a) : BuiltinFunctionNew(a) {}
+    llvm::Value *CodeGen(llvm::IRBuilder<> &builder) override;
+};
+
 class BuiltinFunctionHalt : public BuiltinFunctionVoid {
   public:
     BuiltinFunctionHalt(const std::vector<ExprAST *> &a) : BuiltinFunctionVoid(a) {}
@@ -248,6 +261,40 @@ class BuiltinFunctionFileBool : public BuiltinFunctionFile {
     Types::TypeDecl *Type() const override { return Types::GetBooleanType(); }
 };
 
+// Only for record files (file of T), not text.
+class BuiltinFunctionRecordFile : public BuiltinFunctionFile {
+  public:
+    BuiltinFunctionRecordFile(const std::string &fn, const std::vector<ExprAST *> &a)
+        : BuiltinFunctionFile(fn, a) {}
+    bool Semantics() override;
+};
+
+class BuiltinFunctionRecordFileInt : public BuiltinFunctionRecordFile {
+  public:
+    BuiltinFunctionRecordFileInt(const std::string &fn, const std::vector<ExprAST *> &a)
+        : BuiltinFunctionRecordFile(fn, a) {}
+    Types::TypeDecl *Type() const override { return Types::GetIntegerType(); }
+};
+
+class BuiltinFunctionSeek : public BuiltinFunctionRecordFile {
+  public:
+    BuiltinFunctionSeek(const std::string &fn, const std::vector<ExprAST *> &a)
+        : BuiltinFunctionRecordFile(fn, a) {}
+    llvm::Value *CodeGen(llvm::IRBuilder<> &builder) override;
+    bool         Semantics() override;
+};
+
+class BuiltinFunctionBlockIO : public BuiltinFunctionFile {
+  public:
+    BuiltinFunctionBlockIO(const std::string &fn, const std::vector<ExprAST *> &a)
+        : BuiltinFunctionFile(fn, a) {}
+    llvm::Value *CodeGen(llvm::IRBuilder<> &builder) override;
+    bool         Semantics() override;
+
+  private:
+    size_t BufferRecords() const;
+};
+
 class BuiltinFunctionAssign : public BuiltinFunctionVoid {
   public:
     BuiltinFunctionAssign(const std::vector<ExprAST *> &a) : BuiltinFunctionVoid(a) {}
@@ -300,10 +347,23 @@ class BuiltinFunctionCopy : public BuiltinFunctionBase {
   public:
     BuiltinFunctionCopy(const std::vector<ExprAST *> &a) : BuiltinFunctionBase(a) {}
     llvm::Value *    CodeGen(llvm::IRBuilder<> &builder) override;
-    Types::TypeDecl *Type() const override { return Types::GetStringType(); }
+    Types::TypeDecl *Type() const override;
     bool             Semantics() override;
 };
 
+class BuiltinFunctionPos : public BuiltinFunctionInt {
+  public:
+    BuiltinFunctionPos(const std::vector<ExprAST *> &a) : BuiltinFunctionInt(a) {}
+    llvm::Value *CodeGen(llvm::IRBuilder<> &builder) override;
+    bool         Semantics() override;
+};
+
+class BuiltinFunctionPosFrom : public BuiltinFunctionPos {
+  public:
+    BuiltinFunctionPosFrom(const std::vector<ExprAST *> &a) : BuiltinFunctionPos(a) {}
+    bool Semantics() override;
+};
+
 class BuiltinFunctionMin : public BuiltinFunctionSameAsArg2 {
   public:
     BuiltinFunctionMin(const std::vector<ExprAST *> &a) : BuiltinFunctionSameAsArg2(a) {}
@@ -444,6 +504,21 @@ llvm::Value *BuiltinFunctionPred::CodeGen(llvm::IRBuilder<> &builder) {
     return builder.CreateSub(a, MakeConstant(1, args[0]->Type()), "pred");
 }
 
+// Small types are allocated from a pool for their size class. Must match "runtime".
+static const size_t SizeClassStep = 16;
+static const size_t SizeClasses = 16;
+
+// Classes may be disposed through a pointer to a base class, so they are left to the runtime
+// to sort out, as are untyped pointers.
+static int SizeClass(Types::PointerDecl *pd) {
+    Types::TypeDecl *ty = pd->SubType();
+    size_t           size = ty->Size();
+    if (llvm::isa<Types::ClassDecl>(ty) || size == 0 || size > SizeClassStep * SizeClasses) {
+        return -1;
+    }
+    return (size - 1) / SizeClassStep;
+}
+
 llvm::Value *BuiltinFunctionNew::CodeGen(llvm::IRBuilder<> &builder) {
     Types::PointerDecl *pd = llvm::dyn_cast<Types::PointerDecl>(args[0]->Type());
     size_t              size = pd->SubType()->Size();
@@ -451,9 +526,15 @@ llvm::Value *BuiltinFunctionNew::CodeGen(llvm::IRBuilder<> &builder) {
 
     // Result is "void *"
     llvm::Type *    resTy = Types::GetVoidPtrType();
-    llvm::Constant *f = GetFunction(resTy, {ty}, "__new");
+    llvm::Type *    strTy = llvm::PointerType::getUnqual(Types::GetCharType()->LlvmType());
+    llvm::Constant *f = GetFunction(resTy, {ty, ty, strTy}, "__new");
 
-    llvm::Value *retVal = builder.CreateCall(f, {MakeIntegerConstant(size)}, "new");
+    // Where the object is made, for the heap profiler.
+    const Location &loc = args[0]->Loc();
+    llvm::Value *   site =
+        builder.CreateGlobalStringPtr(loc.FileName() + ":" + std::to_string(loc.LineNumber()));
+    llvm::Value *retVal = builder.CreateCall(
+        f, {MakeIntegerConstant(size), MakeIntegerConstant(SizeClass(pd)), site}, "new");
 
     VariableExprAST *var = llvm::dyn_cast<VariableExprAST>(args[0]);
     // TODO: Fix this to be a proper TypeCast...
@@ -468,10 +549,31 @@ bool BuiltinFunctionNew::Semantics() {
 }
 
 llvm::Value *BuiltinFunctionDispose::CodeGen(llvm::IRBuilder<> &builder) {
-    llvm::Type *    ty = args[0]->Type()->LlvmType();
-    llvm::Constant *f = GetFunction(Types::GetVoidType(), {ty}, "__dispose");
+    Types::PointerDecl *pd = llvm::dyn_cast<Types::PointerDecl>(args[0]->Type());
+    llvm::Type *        ty = pd->LlvmType();
+    llvm::Type *        intTy = Types::GetIntegerType()->LlvmType();
+    llvm::Constant *    f = GetFunction(Types::GetVoidType(), {ty, intTy}, "__dispose");
 
-    return builder.CreateCall(f, {args[0]->CodeGen()});
+    return builder.CreateCall(f, {args[0]->CodeGen(), MakeIntegerConstant(SizeClass(pd))});
+}
+
+llvm::Value *BuiltinFunctionMark::CodeGen(llvm::IRBuilder<> &builder) {
+    llvm::Type *    resTy = Types::GetVoidPtrType();
+    llvm::Constant *f = GetFunction(resTy, {}, "__mark");
+
+    llvm::Value *retVal = builder.CreateCall(f, {}, "mark");
+
+    VariableExprAST *var = llvm::dyn_cast<VariableExprAST>(args[0]);
+    retVal = builder.CreateBitCast(retVal, args[0]->Type()->LlvmType(), "cast");
+    return builder.CreateStore(retVal, var->Address());
+}
+
+llvm::Value *BuiltinFunctionRelease::CodeGen(llvm::IRBuilder<> &builder) {
+    llvm::Type *    ty = Types::GetVoidPtrType();
+    llvm::Constant *f = GetFunction(Types::GetVoidType(), {ty}, "__release");
+
+    llvm::Value *mark = builder.CreateBitCast(args[0]->CodeGen(), ty, "cast");
+    return builder.CreateCall(f, {mark});
 }
 
 bool BuiltinFunctionHalt::Semantics() {
@@ -484,8 +586,9 @@ llvm::Value *BuiltinFunctionHalt::CodeGen(llvm::IRBuilder<> &builder) {
         v = args[0]->CodeGen();
     }
 
+    llvm::Type *    voidTy = Types::GetVoidType()->LlvmType();
     llvm::Constant *f =
-        GetFunction(Types::GetVoidType(), {Types::GetIntegerType()->LlvmType()}, "exit");
+        GetNoReturnFunction(voidTy, {Types::GetIntegerType()->LlvmType()}, "exit");
 
     return builder.CreateCall(f, {v});
 }
@@ -586,10 +689,18 @@ llvm::Value *BuiltinFunctionUnpack::CodeGen(llvm::IRBuilder<> &builder) {
 }
 
 bool BuiltinFunctionVal::Semantics() {
-    return args.size() == 2 && args[0]->Type()->IsStringLike() &&
-           llvm::isa<VariableExprAST>(args[1]) &&
-           (args[1]->Type()->Type() == Types::TypeDecl::TK_Integer ||
-            args[1]->Type()->Type() == Types::TypeDecl::TK_LongInt);
+    if (args.size() < 2 || args.size() > 3 || !args[0]->Type()->IsStringLike() ||
+        !llvm::isa<VariableExprAST>(args[1])) {
+        return false;
+    }
+    // Optional error code.
+    if (args.size() == 3 && !(llvm::isa<VariableExprAST>(args[2]) &&
+                              args[2]->Type()->Type() == Types::TypeDecl::TK_Integer)) {
+        return false;
+    }
+    return args[1]->Type()->Type() == Types::TypeDecl::TK_Integer ||
+           args[1]->Type()->Type() == Types::TypeDecl::TK_LongInt ||
+           args[1]->Type()->Type() == Types::TypeDecl::TK_Real;
 }
 
 llvm::Value *BuiltinFunctionVal::CodeGen(llvm::IRBuilder<> &builder) {
@@ -603,16 +714,24 @@ llvm::Value *BuiltinFunctionVal::CodeGen(llvm::IRBuilder<> &builder) {
     case Types::TypeDecl::TK_LongInt:
         name += "long";
         break;
+    case Types::TypeDecl::TK_Real:
+        name += "real";
+        break;
     default:
         assert(0 && "What happened here?");
         return 0;
     }
-    llvm::Value *   res = var1->Address();
+    llvm::Value *res = var1->Address();
+    llvm::Type * codeTy = llvm::PointerType::getUnqual(Types::GetIntegerType()->LlvmType());
+    llvm::Value *code = llvm::Constant::getNullValue(codeTy);
+    if (args.size() == 3) {
+        code = llvm::dyn_cast<VariableExprAST>(args[2])->Address();
+    }
     llvm::Type *    ty0 = str->getType();
     llvm::Type *    ty1 = res->getType();
-    llvm::Constant *f = GetFunction(Types::GetVoidType(), {ty0, ty1}, name);
+    llvm::Constant *f = GetFunction(Types::GetVoidType(), {ty0, ty1, codeTy}, name);
 
-    return builder.CreateCall(f, {str, res});
+    return builder.CreateCall(f, {str, res, code});
 }
 
 llvm::Value *BuiltinFunctionFile::CodeGen(llvm::IRBuilder<> &builder) {
@@ -660,7 +779,91 @@ bool BuiltinFunctionFileBool::Semantics() {
     return BuiltinFunctionFile::Semantics();
 }
 
+bool BuiltinFunctionRecordFile::Semantics() {
+    return BuiltinFunctionFile::Semantics() &&
+           args[0]->Type()->Type() != Types::TypeDecl::TK_Text;
+}
+
+llvm::Value *BuiltinFunctionSeek::CodeGen(llvm::IRBuilder<> &builder) {
+    VariableExprAST *fvar = llvm::dyn_cast<VariableExprAST>(args[0]);
+    llvm::Value *    faddr = fvar->Address();
+    llvm::Value *    pos = args[1]->CodeGen();
+    llvm::Constant * f =
+        GetFunction(Types::GetVoidType(), {faddr->getType(), pos->getType()}, "__" + funcname);
+
+    return builder.CreateCall(f, {faddr, pos});
+}
+
+// SeekRead/SeekWrite(f, n), where n counts the records of the file from zero.
+bool BuiltinFunctionSeek::Semantics() {
+    return args.size() == 2 && llvm::isa<VariableExprAST>(args[0]) &&
+           llvm::isa<Types::FileDecl>(args[0]->Type()) &&
+           args[0]->Type()->Type() != Types::TypeDecl::TK_Text &&
+           args[1]->Type()->Type() == Types::TypeDecl::TK_Integer;
+}
+
+// Number of records that the buffer argument of BlockRead/BlockWrite holds, or zero if it
+// isn't made of records of the file.
+size_t BuiltinFunctionBlockIO::BufferRecords() const {
+    Types::TypeDecl *recTy = args[0]->Type()->SubType();
+    Types::TypeDecl *ty = args[1]->Type();
+    if (ty->SameAs(recTy)) {
+        return 1;
+    }
+    if (Types::ArrayDecl *ad = llvm::dyn_cast<Types::ArrayDecl>(ty)) {
+        if (ad->SubType()->SameAs(recTy)) {
+            return ad->Size() / recTy->Size();
+        }
+    }
+    return 0;
+}
+
+llvm::Value *BuiltinFunctionBlockIO::CodeGen(llvm::IRBuilder<> &builder) {
+    VariableExprAST *fvar = llvm::dyn_cast<VariableExprAST>(args[0]);
+    VariableExprAST *bvar = llvm::dyn_cast<VariableExprAST>(args[1]);
+    llvm::Value *    faddr = fvar->Address();
+    llvm::Value *    buffer = builder.CreateBitCast(bvar->Address(), Types::GetVoidPtrType());
+    llvm::Value *    count = args[2]->CodeGen();
+    llvm::Value *    size = MakeIntegerConstant(BufferRecords());
+    llvm::Type *     intTy = Types::GetIntegerType()->LlvmType();
+    llvm::Constant * f = GetFunction(Types::GetIntegerType(),
+                                    {faddr->getType(), Types::GetVoidPtrType(), intTy, intTy},
+                                    "__" + funcname);
+
+    llvm::Value *res = builder.CreateCall(f, {faddr, buffer, count, size}, "records");
+    if (args.size() == 4) {
+        // Optional number of records actually transferred.
+        VariableExprAST *rvar = llvm::dyn_cast<VariableExprAST>(args[3]);
+        builder.CreateStore(res, rvar->Address());
+    }
+    return res;
+}
+
+// BlockRead/BlockWrite(f, buffer, count [, result]): buffer is a record of the file, or an
+// array of them, so that it can be moved to or from the file in one go.
+bool BuiltinFunctionBlockIO::Semantics() {
+    if (args.size() < 3 || args.size() > 4 || !llvm::isa<VariableExprAST>(args[0]) ||
+        !llvm::isa<VariableExprAST>(args[1])) {
+        return false;
+    }
+    if (!llvm::isa<Types::FileDecl>(args[0]->Type()) ||
+        args[0]->Type()->Type() == Types::TypeDecl::TK_Text || !BufferRecords()) {
+        return false;
+    }
+    if (args[2]->Type()->Type() != Types::TypeDecl::TK_Integer) {
+        return false;
+    }
+    return args.size() == 3 || (llvm::isa<VariableExprAST>(args[3]) &&
+                                args[3]->Type()->Type() == Types::TypeDecl::TK_Integer);
+}
+
 llvm::Value *BuiltinFunctionLength::CodeGen(llvm::IRBuilder<> &builder) {
+    if (llvm::isa<Types::LongStringDecl>(args[0]->Type())) {
+        llvm::Value *   v = args[0]->CodeGen();
+        llvm::Constant *f = GetFunction(Types::GetIntegerType(), {v->getType()}, "__LStrLength");
+        return builder.CreateCall(f, {v}, "len");
+    }
+
     llvm::Value *              v = MakeAddressable(args[0]);
     std::vector<llvm::Value *> ind = {MakeIntegerConstant(0), MakeIntegerConstant(0)};
     v = builder.CreateGEP(v, ind, "str_0");
@@ -670,7 +873,8 @@ llvm::Value *BuiltinFunctionLength::CodeGen(llvm::IRBuilder<> &builder) {
 }
 
 bool BuiltinFunctionLength::Semantics() {
-    return args.size() == 1 && args[0]->Type()->Type() == Types::TypeDecl::TK_String;
+    return args.size() == 1 && (args[0]->Type()->Type() == Types::TypeDecl::TK_String ||
+                                args[0]->Type()->Type() == Types::TypeDecl::TK_LongString);
 }
 
 llvm::Value *BuiltinFunctionAssign::CodeGen(llvm::IRBuilder<> &builder) {
@@ -701,26 +905,170 @@ bool BuiltinFunctionAssign::Semantics() {
     return true;
 }
 
+Types::TypeDecl *BuiltinFunctionCopy::Type() const {
+    if (llvm::isa<Types::LongStringDecl>(args[0]->Type())) {
+        return Types::GetLongStringType();
+    }
+    return Types::GetStringType();
+}
+
 llvm::Value *BuiltinFunctionCopy::CodeGen(llvm::IRBuilder<> &builder) {
+    if (llvm::isa<Types::LongStringDecl>(args[0]->Type())) {
+        llvm::Value *   str = args[0]->CodeGen();
+        llvm::Value *   start = args[1]->CodeGen();
+        llvm::Value *   len = args[2]->CodeGen();
+        llvm::Constant *f = GetFunction(Types::GetLongStringType(),
+                                        {str->getType(), start->getType(), len->getType()},
+                                        "__LStrCopy");
+        return builder.CreateCall(f, {str, start, len}, "copy");
+    }
+
     llvm::Value *str = MakeAddressable(args[0]);
     llvm::Value *start = args[1]->CodeGen();
     llvm::Value *len = args[2]->CodeGen();
+    llvm::Value *res = CreateTempAlloca(Types::GetStringType());
 
-    std::vector<llvm::Type *> argTypes = {str->getType(), start->getType(), len->getType()};
-    llvm::Type *              strTy = Types::GetStringType()->LlvmType();
-    llvm::Constant *          f = GetFunction(strTy, argTypes, "__StrCopy");
-
-    std::vector<llvm::Value *> argsV = {str, start, len};
+    std::vector<llvm::Type *> argTypes = {res->getType(), str->getType(), start->getType(),
+                                          len->getType()};
+    llvm::Constant *          f = GetFunction(Types::GetVoidType(), argTypes, "__StrCopy");
 
-    return builder.CreateCall(f, argsV, "copy");
+    std::vector<llvm::Value *> argsV = {res, str, start, len};
+    builder.CreateCall(f, argsV);
+    return builder.CreateLoad(res, "copy");
 }
 
 bool BuiltinFunctionCopy::Semantics() {
-    return args.size() == 3 && args[0]->Type()->Type() == Types::TypeDecl::TK_String &&
+    return args.size() == 3 &&
+           (args[0]->Type()->Type() == Types::TypeDecl::TK_String ||
+            args[0]->Type()->Type() == Types::TypeDecl::TK_LongString) &&
            args[1]->Type()->Type() == Types::TypeDecl::TK_Integer &&
            args[2]->Type()->Type() == Types::TypeDecl::TK_Integer;
 }
 
+// Needles longer than this use Two-Way search. Must match "runtime".
+static const size_t PosShortNeedle = 32;
+
+// Critical factorization of the needle for Two-Way search, as done by the runtime for needles
+// that are not constant.
+static size_t CriticalFactorization(const std::string &needle, size_t &period, bool &periodic) {
+    size_t n = needle.size();
+    size_t suffix[2];
+    size_t per[2];
+    for (int rev = 0; rev < 2; rev++) {
+        // ms is one less than the start of the maximal suffix, and starts "before" the needle.
+        size_t ms = SIZE_MAX;
+        size_t j = 0;
+        size_t k = 1;
+        size_t p = 1;
+        while (j + k < n) {
+            unsigned char a = needle[j + k];
+            unsigned char b = needle[ms + k];
+            if ((rev) ? (a > b) : (a < b)) {
+                j += k;
+                k = 1;
+                p = j - ms;
+            } else if (a == b) {
+                if (k != p) {
+                    k++;
+                } else {
+                    j += p;
+                    k = 1;
+                }
+            } else {
+                ms = j++;
+                k = p = 1;
+            }
+        }
+        suffix[rev] = ms + 1;
+        per[rev] = p;
+    }
+    int    r = (suffix[1] < suffix[0]) ? 0 : 1;
+    size_t s = suffix[r];
+    period = per[r];
+    periodic = needle.compare(0, s, needle, period, s) == 0;
+    if (!periodic) {
+        period = std::max(s, n - s) + 1;
+    }
+    return s;
+}
+
+static bool IsPosString(ExprAST *e) {
+    Types::TypeDecl *ty = e->Type();
+    if (ty->Type() == Types::TypeDecl::TK_Char || llvm::isa<Types::StringDecl>(ty) ||
+        llvm::isa<Types::LongStringDecl>(ty)) {
+        return true;
+    }
+    if (Types::ArrayDecl *ad = llvm::dyn_cast<Types::ArrayDecl>(ty)) {
+        return ad->Ranges().size() == 1 && ad->SubType()->Type() == Types::TypeDecl::TK_Char;
+    }
+    return false;
+}
+
+// Pos(needle, haystack [, start]) and PosFrom(needle, haystack, start). A char needle uses
+// memchr, a constant needle has the search method (and for Two-Way, the factorization of the
+// needle) chosen here, and anything else is left to the runtime.
+llvm::Value *BuiltinFunctionPos::CodeGen(llvm::IRBuilder<> &builder) {
+    llvm::Type * intTy = Types::GetIntegerType()->LlvmType();
+    llvm::Type * pty = Types::GetVoidPtrType();
+    llvm::Value *start = (args.size() > 2) ? args[2]->CodeGen() : MakeIntegerConstant(1);
+    llvm::Value *hPtr;
+    llvm::Value *hLen;
+
+    if (args[0]->Type()->Type() == Types::TypeDecl::TK_Char) {
+        llvm::Value *c = args[0]->CodeGen();
+        StringPiece(args[1], hPtr, hLen);
+        llvm::Constant *f = GetFunction(intTy, {c->getType(), pty, intTy, intTy}, "__PosChar");
+        llvm::Value *   pos =
+            builder.CreateCall(f, {c, builder.CreateBitCast(hPtr, pty), hLen, start}, "pos");
+        ReleaseStringPiece(args[1], hPtr);
+        return pos;
+    }
+
+    llvm::Value *nPtr;
+    llvm::Value *nLen;
+    StringPiece(args[0], nPtr, nLen);
+    StringPiece(args[1], hPtr, hLen);
+
+    std::vector<llvm::Type *>  argTypes = {pty, intTy, pty, intTy, intTy};
+    std::vector<llvm::Value *> argsV = {builder.CreateBitCast(nPtr, pty), nLen,
+                                        builder.CreateBitCast(hPtr, pty), hLen, start};
+    std::string                name = "__Pos";
+    if (StringExprAST *se = llvm::dyn_cast<StringExprAST>(args[0])) {
+        const std::string &needle = se->Str();
+        if (needle.size() > PosShortNeedle) {
+            size_t period;
+            bool   periodic;
+            size_t suffix = CriticalFactorization(needle, period, periodic);
+            argTypes.insert(argTypes.end(), {intTy, intTy, intTy});
+            argsV.push_back(MakeIntegerConstant(suffix));
+            argsV.push_back(MakeIntegerConstant(period));
+            argsV.push_back(MakeIntegerConstant(periodic));
+            name = "__PosTwoWay";
+        } else if (needle.size() > 1) {
+            name = "__PosShort";
+        }
+    }
+    llvm::Constant *f = GetFunction(intTy, argTypes, name);
+    llvm::Value *   pos = builder.CreateCall(f, argsV, "pos");
+    ReleaseStringPiece(args[0], nPtr);
+    ReleaseStringPiece(args[1], hPtr);
+    return pos;
+}
+
+bool BuiltinFunctionPos::Semantics() {
+    if (args.size() != 2 && args.size() != 3) {
+        return false;
+    }
+    if (args.size() == 3 && args[2]->Type()->Type() != Types::TypeDecl::TK_Integer) {
+        return false;
+    }
+    return IsPosString(args[0]) && IsPosString(args[1]);
+}
+
+bool BuiltinFunctionPosFrom::Semantics() {
+    return args.size() == 3 && BuiltinFunctionPos::Semantics();
+}
+
 llvm::Value *BuiltinFunctionClock::CodeGen(llvm::IRBuilder<> &builder) {
     llvm::Constant *f = GetFunction(Types::GetLongIntType(), {}, "__Clock");
 
@@ -734,7 +1082,7 @@ bool BuiltinFunctionClock::Semantics() {
 llvm::Value *BuiltinFunctionPanic::CodeGen(llvm::IRBuilder<> &builder) {
     llvm::Value *   message = args[0]->CodeGen();
     llvm::Type *    ty = message->getType();
-    llvm::Constant *f = GetFunction(Types::GetVoidType(), {ty}, "__Panic");
+    llvm::Constant *f = GetNoReturnFunction(Types::GetVoidType()->LlvmType(), {ty}, "__Panic");
 
     return builder.CreateCall(f, {message});
 }
@@ -920,6 +1268,8 @@ void InitBuiltins() {
     AddBIFCreator("pred", NEW(Pred));
     AddBIFCreator("new", NEW(New));
     AddBIFCreator("dispose", NEW(Dispose));
+    AddBIFCreator("mark", NEW(Mark));
+    AddBIFCreator("release", NEW(Release));
     AddBIFCreator("halt", NEW(Halt));
     AddBIFCreator("length", NEW(Length));
     AddBIFCreator("popcnt", NEW(Popcnt));
@@ -930,6 +1280,8 @@ void InitBuiltins() {
     AddBIFCreator("paramcount", NEW(Paramcount));
     AddBIFCreator("paramstr", NEW(Paramstr));
     AddBIFCreator("copy", NEW(Copy));
+    AddBIFCreator("pos", NEW(Pos));
+    AddBIFCreator("posfrom", NEW(PosFrom));
     AddBIFCreator("max", NEW(Max));
     AddBIFCreator("min", NEW(Min));
     AddBIFCreator("sign", NEW(Sign));
@@ -955,5 +1307,13 @@ void InitBuiltins() {
     AddBIFCreator("put", NEW2(File, "put"));
     AddBIFCreator("eof", NEW2(FileBool, "eof"));
     AddBIFCreator("eoln", NEW2(FileBool, "eoln"));
+    AddBIFCreator("blockread", NEW2(BlockIO, "block_read"));
+    AddBIFCreator("blockwrite", NEW2(BlockIO, "block_write"));
+    AddBIFCreator("seekread", NEW2(Seek, "seek_read"));
+    AddBIFCreator("seekwrite", NEW2(Seek, "seek_write"));
+    AddBIFCreator("position", NEW2(RecordFileInt, "position"));
+    AddBIFCreator("lastposition", NEW2(RecordFileInt, "last_position"));
+    AddBIFCreator("mapfile", NEW2(RecordFile, "map_file"));
+    AddBIFCreator("asyncfile", NEW2(File, "async_file"));
 }
 } // namespace Builtin
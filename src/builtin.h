@@ -28,7 +28,9 @@ class BuiltinFunctionBase {
     virtual Types::TypeDecl *Type() const = 0;
     virtual bool             Semantics() = 0;
     virtual void             accept(ASTVisitor &v);
+    virtual bool             ModifiesArgs() const { return false; }
     virtual ~BuiltinFunctionBase() {}
+    const std::vector<ExprAST *> &Args() const { return args; }
 
   protected:
     std::vector<ExprAST *> args;
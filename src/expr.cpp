@@ -20,6 +20,7 @@
 #include <cctype>
 #include <iostream>
 #include <map>
+#include <set>
 #include <sstream>
 
 template <> void Stack<llvm::Value *>::dump(std::ostream &out) const {
@@ -133,7 +134,12 @@ std::string ShortName(const std::string &name) {
 llvm::Constant *GetFunction(llvm::Type *resTy, const std::vector<llvm::Type *> &args,
                             const std::string &name) {
     llvm::FunctionType *ft = llvm::FunctionType::get(resTy, args, false);
-    return theModule->getOrInsertFunction(name, ft);
+    llvm::Constant *    f = theModule->getOrInsertFunction(name, ft);
+    // Neither Pascal code nor the runtime throws exceptions.
+    if (llvm::Function *fn = llvm::dyn_cast<llvm::Function>(f)) {
+        fn->addFnAttr(llvm::Attribute::NoUnwind);
+    }
+    return f;
 }
 
 llvm::Constant *GetFunction(Types::TypeDecl *res, const std::vector<llvm::Type *> &args,
@@ -142,6 +148,17 @@ llvm::Constant *GetFunction(Types::TypeDecl *res, const std::vector<llvm::Type *
     return GetFunction(resTy, args, name);
 }
 
+// Get a runtime function that exits the program, so calls to it are rare and never return.
+llvm::Constant *GetNoReturnFunction(llvm::Type *resTy, const std::vector<llvm::Type *> &args,
+                                    const std::string &name) {
+    llvm::Constant *f = GetFunction(resTy, args, name);
+    if (llvm::Function *fn = llvm::dyn_cast<llvm::Function>(f)) {
+        fn->addFnAttr(llvm::Attribute::NoReturn);
+        fn->addFnAttr(llvm::Attribute::Cold);
+    }
+    return f;
+}
+
 static bool IsConstant(ExprAST *e) {
     return llvm::isa<IntegerExprAST>(e) || llvm::isa<CharExprAST>(e);
 }
@@ -151,7 +168,7 @@ size_t AlignOfType(llvm::Type *ty) {
     return dl.getPrefTypeAlignment(ty);
 }
 
-static llvm::AllocaInst *CreateNamedAlloca(llvm::Function *fn, Types::TypeDecl *ty,
+static llvm::AllocaInst *CreateNamedAlloca(llvm::Function *fn, llvm::Type *type, size_t align,
                                            const std::string &name) {
     TRACE();
     /* Save where we were... */
@@ -160,11 +177,8 @@ static llvm::AllocaInst *CreateNamedAlloca(llvm::Function *fn, Types::TypeDecl *
 
     llvm::IRBuilder<> bld(&fn->getEntryBlock(), fn->getEntryBlock().begin());
 
-    assert(ty && "Must have type passed in");
-    llvm::Type *type = ty->LlvmType();
-
     llvm::AllocaInst *a = bld.CreateAlloca(type, 0, name);
-    size_t            align = std::max(ty->AlignSize(), MIN_ALIGN);
+    align = std::max(align, MIN_ALIGN);
     if (a->getAlignment() < align) {
         a->setAlignment(align);
     }
@@ -174,6 +188,12 @@ static llvm::AllocaInst *CreateNamedAlloca(llvm::Function *fn, Types::TypeDecl *
     return a;
 }
 
+static llvm::AllocaInst *CreateNamedAlloca(llvm::Function *fn, Types::TypeDecl *ty,
+                                           const std::string &name) {
+    assert(ty && "Must have type passed in");
+    return CreateNamedAlloca(fn, ty->LlvmType(), ty->AlignSize(), name);
+}
+
 static llvm::AllocaInst *CreateAlloca(llvm::Function *fn, const VarDef &var) {
     if (Types::FieldCollection *fc = llvm::dyn_cast<Types::FieldCollection>(var.Type())) {
         fc->EnsureSized();
@@ -182,11 +202,105 @@ static llvm::AllocaInst *CreateAlloca(llvm::Function *fn, const VarDef &var) {
     return CreateNamedAlloca(fn, var.Type(), var.Name());
 }
 
-static llvm::AllocaInst *CreateTempAlloca(Types::TypeDecl *ty) {
-    /* Get the "entry" block */
+/* Temporaries are handed out per statement. The lifetime.start of each one goes where the
+ * statement starts, and its lifetime.end where the statement ends, so that every path
+ * through the statement (which may branch, even inside an expression) sees the start before
+ * the end. After the end, the stack slot is free for a temporary of the same type and
+ * alignment in a statement that starts later; not one that is still going on, such as the
+ * statement around a nested block, which has already started using the slot.
+ */
+typedef std::pair<llvm::Type *, size_t> TempKey;
+
+struct FreeTemp {
+    llvm::AllocaInst *alloca;
+    unsigned          freedAt;
+};
+
+struct TempScope {
+    llvm::Function *fn;
+    // The last instruction before the statement, or null if it starts its block.
+    llvm::BasicBlock *                                  block;
+    llvm::Instruction *                                 before;
+    unsigned                                            startedAt;
+    std::vector<std::pair<TempKey, llvm::AllocaInst *>> used;
+};
+
+static std::vector<TempScope> tempScopes;
+// Only used while generating the body of a function, and cleared after it.
+static std::multimap<TempKey, FreeTemp> freeTemps;
+static unsigned                         tempClock;
+
+static llvm::ConstantInt *TempSize(llvm::Type *ty) {
+    const llvm::DataLayout dl(theModule);
+    return builder.getInt64(dl.getTypeAllocSize(ty));
+}
+
+static void BeginTempScope() {
+    llvm::BasicBlock *bb = builder.GetInsertBlock();
+    llvm::Instruction *before = 0;
+    if (builder.GetInsertPoint() != bb->begin()) {
+        before = &*std::prev(builder.GetInsertPoint());
+    }
+    tempScopes.push_back(TempScope{bb->getParent(), bb, before, ++tempClock, {}});
+}
+
+static void EndTempScope() {
+    TempScope &scope = tempScopes.back();
+    // No need to mark the end if we can't get here.
+    bool     reachable = !builder.GetInsertBlock()->getTerminator();
+    unsigned now = ++tempClock;
+    for (auto it = scope.used.rbegin(); it != scope.used.rend(); it++) {
+        if (reachable) {
+            builder.CreateLifetimeEnd(it->second, TempSize(it->first.first));
+        }
+        freeTemps.insert({it->first, FreeTemp{it->second, now}});
+    }
+    tempScopes.pop_back();
+}
+
+static void ClearFreeTemps() {
+    freeTemps.clear();
+}
+
+static llvm::AllocaInst *CreateTempAlloca(llvm::Type *ty, size_t align) {
     llvm::Function *fn = builder.GetInsertBlock()->getParent();
 
-    return CreateNamedAlloca(fn, ty, "tmp");
+    if (tempScopes.empty() || tempScopes.back().fn != fn) {
+        return CreateNamedAlloca(fn, ty, align, "tmp");
+    }
+
+    TempScope &       scope = tempScopes.back();
+    TempKey           key(ty, align);
+    llvm::AllocaInst *a = 0;
+    auto              range = freeTemps.equal_range(key);
+    for (auto it = range.first; it != range.second; it++) {
+        if (it->second.freedAt < scope.startedAt) {
+            a = it->second.alloca;
+            freeTemps.erase(it);
+            break;
+        }
+    }
+    if (!a) {
+        a = CreateNamedAlloca(fn, ty, align, "tmp");
+    }
+
+    llvm::IRBuilderBase::InsertPointGuard guard(builder);
+    if (scope.before) {
+        builder.SetInsertPoint(scope.block, std::next(scope.before->getIterator()));
+    } else {
+        builder.SetInsertPoint(scope.block, scope.block->begin());
+    }
+    builder.CreateLifetimeStart(a, TempSize(ty));
+    scope.used.push_back({key, a});
+    return a;
+}
+
+llvm::AllocaInst *CreateTempAlloca(Types::TypeDecl *ty) {
+    return CreateTempAlloca(ty->LlvmType(), ty->AlignSize());
+}
+
+static llvm::AllocaInst *CreateTempAlloca(llvm::Type *ty) {
+    return CreateTempAlloca(ty, AlignOfType(ty));
 }
 
 llvm::Value *MakeAddressable(ExprAST *e) {
@@ -196,6 +310,14 @@ llvm::Value *MakeAddressable(ExprAST *e) {
         return v;
     }
 
+    if (CallExprAST *call = llvm::dyn_cast<CallExprAST>(e)) {
+        if (call->Proto()->IsSRet()) {
+            llvm::Value *v = CreateTempAlloca(e->Type());
+            call->CodeGenInto(v);
+            return v;
+        }
+    }
+
     llvm::Value *store = e->CodeGen();
     if (store->getType()->isPointerTy()) {
         return store;
@@ -437,6 +559,65 @@ void ArrayExprAST::accept(ASTVisitor &v) {
     v.visit(this);
 }
 
+void LongStrIndexExprAST::DoDump(std::ostream &out) const {
+    out << "LongStrIndex: " << name << "[";
+    index->dump(out);
+    out << "]";
+}
+
+// The index is always checked against the length, which also catches the empty (nil) string.
+llvm::Value *LongStrIndexExprAST::CharAddress(llvm::Value *str) {
+    llvm::Value *   pos = index->CodeGen();
+    llvm::Type *    intTy = Types::GetIntegerType()->LlvmType();
+    llvm::Constant *lenFn = GetFunction(Types::GetIntegerType(), {str->getType()}, "__LStrLength");
+    llvm::Value *   len = builder.CreateCall(lenFn, {str}, "len");
+    llvm::Value *   idx = builder.CreateSub(pos, MakeIntegerConstant(1));
+    llvm::Value *   cmp = builder.CreateICmpUGE(idx, len, "rangecheck");
+
+    llvm::Function *  theFunction = builder.GetInsertBlock()->getParent();
+    llvm::BasicBlock *oorBlock = llvm::BasicBlock::Create(theContext, "out_of_range");
+    llvm::BasicBlock *contBlock = llvm::BasicBlock::Create(theContext, "continue", theFunction);
+    builder.CreateCondBr(cmp, oorBlock, contBlock);
+
+    theFunction->getBasicBlockList().push_back(oorBlock);
+    builder.SetInsertPoint(oorBlock);
+    std::vector<llvm::Value *> args = {builder.CreateGlobalStringPtr(Loc().FileName()),
+                                       MakeIntegerConstant(Loc().LineNumber()),
+                                       MakeIntegerConstant(1), len, pos};
+    std::vector<llvm::Type *> argTypes = {
+        llvm::PointerType::getUnqual(Types::GetCharType()->LlvmType()), intTy, intTy, intTy,
+        intTy};
+    llvm::Constant *fn = GetNoReturnFunction(Types::GetVoidPtrType(), argTypes, "range_error");
+    builder.CreateCall(fn, args, "");
+    builder.CreateUnreachable();
+
+    builder.SetInsertPoint(contBlock);
+    return builder.CreateGEP(str, idx, "valueindex");
+}
+
+llvm::Value *LongStrIndexExprAST::CodeGen() {
+    TRACE();
+
+    BasicDebugInfo(this);
+
+    llvm::Value *str = builder.CreateLoad(expr->Address(), "lstr");
+    return builder.CreateLoad(CharAddress(str), "char");
+}
+
+llvm::Value *LongStrIndexExprAST::Address() {
+    TRACE();
+    llvm::Value *   v = expr->Address();
+    llvm::Constant *f = GetFunction(Types::GetVoidType(), {v->getType()}, "__LStrUnique");
+    builder.CreateCall(f, {v});
+    return CharAddress(builder.CreateLoad(v, "lstr"));
+}
+
+void LongStrIndexExprAST::accept(ASTVisitor &v) {
+    index->accept(v);
+    expr->accept(v);
+    v.visit(this);
+}
+
 void FieldExprAST::DoDump(std::ostream &out) const {
     out << "Field " << element << std::endl;
     expr->DoDump(out);
@@ -561,30 +742,126 @@ static llvm::Value *SetOperation(const std::string &name, llvm::Value *res, llvm
     return 0;
 }
 
+// Add the bits for a constant element or range to the precomputed set words.
+static void AddConstantSetElement(Types::SetDecl::ElemType elems[], ExprAST *v,
+                                  Types::TypeDecl *type) {
+    int start = type->GetRange()->Start();
+    if (RangeExprAST *r = llvm::dyn_cast<RangeExprAST>(v)) {
+        IntegerExprAST *le = llvm::dyn_cast<IntegerExprAST>(r->LowExpr());
+        IntegerExprAST *he = llvm::dyn_cast<IntegerExprAST>(r->HighExpr());
+        int             low = le->Int() - start;
+        int             high = he->Int() - start;
+        low = std::max(0, low);
+        high = std::min((int)type->GetRange()->Size() - 1, high);
+        if (low > high) {
+            return;
+        }
+        int lowWord = low >> Types::SetDecl::SetPow2Bits;
+        int highWord = high >> Types::SetDecl::SetPow2Bits;
+        for (int w = lowWord; w <= highWord; w++) {
+            Types::SetDecl::ElemType mask = ~Types::SetDecl::ElemType(0);
+            if (w == lowWord) {
+                mask &= mask << (low & Types::SetDecl::SetMask);
+            }
+            if (w == highWord) {
+                mask &= ~Types::SetDecl::ElemType(0) >>
+                        (Types::SetDecl::SetMask - (high & Types::SetDecl::SetMask));
+            }
+            elems[w] |= mask;
+        }
+    } else {
+        IntegerExprAST *e = llvm::dyn_cast<IntegerExprAST>(v);
+        unsigned        i = e->Int() - start;
+        if (i < (unsigned)type->GetRange()->Size()) {
+            elems[i >> Types::SetDecl::SetPow2Bits] |=
+                (Types::SetDecl::ElemType(1) << (i & Types::SetDecl::SetMask));
+        }
+    }
+}
+
+static bool IsConstantSetElement(ExprAST *v) {
+    if (RangeExprAST *r = llvm::dyn_cast<RangeExprAST>(v)) {
+        return IsConstant(r->HighExpr()) && IsConstant(r->LowExpr());
+    }
+    return IsConstant(v);
+}
+
+// Sets are stored as an array of words, but for operations we treat them as a
+// vector of the same words, so that the backend can use SIMD instructions.
+static llvm::VectorType *SetVectorType(Types::SetDecl *type) {
+    llvm::ArrayType *aty = llvm::dyn_cast<llvm::ArrayType>(type->LlvmType());
+    assert(aty && "Expect set to be an array of words");
+    return llvm::VectorType::get(aty->getElementType(), type->SetWords());
+}
+
+static llvm::Value *LoadSetVector(llvm::Value *addr, Types::SetDecl *type,
+                                  const std::string &name) {
+    llvm::Type *vty = llvm::PointerType::getUnqual(SetVectorType(type));
+    addr = builder.CreateBitCast(addr, vty);
+    llvm::LoadInst *v = builder.CreateLoad(addr, name);
+    v->setAlignment(MIN_ALIGN);
+    return v;
+}
+
+static void StoreSetVector(llvm::Value *v, llvm::Value *addr, Types::SetDecl *type) {
+    llvm::Type *vty = llvm::PointerType::getUnqual(SetVectorType(type));
+    addr = builder.CreateBitCast(addr, vty);
+    llvm::StoreInst *st = builder.CreateStore(v, addr);
+    st->setAlignment(MIN_ALIGN);
+}
+
+// Return true if all words in the vector "v" are zero.
+static llvm::Value *SetVectorIsEmpty(llvm::Value *v, Types::SetDecl *type) {
+    size_t       words = type->SetWords();
+    llvm::Value *zero = llvm::Constant::getNullValue(v->getType());
+    llvm::Value *cmp = builder.CreateICmpEQ(v, zero, "wordeq");
+    if (words == 1) {
+        return builder.CreateExtractElement(cmp, MakeIntegerConstant(0));
+    }
+    // Reduce the <N x i1> compare result by treating it as an N bit integer.
+    llvm::Type * maskTy = llvm::IntegerType::get(theContext, words);
+    llvm::Value *mask = builder.CreateBitCast(cmp, maskTy);
+    return builder.CreateICmpEQ(mask, llvm::Constant::getAllOnesValue(maskTy), "alleq");
+}
+
 llvm::Value *BinaryExprAST::InlineSetFunc(const std::string &name, bool resTyIsSet) {
-    if (optimization >= O1 && (name == "Union" || name == "Intersect" || name == "Diff")) {
-        Types::TypeDecl *type = rhs->Type();
+    if (optimization < O1) {
+        return 0;
+    }
+
+    Types::SetDecl *type = llvm::dyn_cast<Types::SetDecl>(rhs->Type());
+    assert(type && *type == *lhs->Type() && "Expect same types");
 
-        assert(*type == *lhs->Type() && "Expect same types");
+    if (resTyIsSet && (name == "Union" || name == "Intersect" || name == "Diff")) {
         llvm::Value *rV = MakeAddressable(rhs);
         llvm::Value *lV = MakeAddressable(lhs);
-
-        size_t words = llvm::dyn_cast<Types::SetDecl>(type)->SetWords();
         assert(rV && lV && "Should have generated values for left and right set");
 
+        llvm::Value *l = LoadSetVector(lV, type, "leftSet");
+        llvm::Value *r = LoadSetVector(rV, type, "rightSet");
+        llvm::Value *res = SetOperation(name, l, r);
+
         llvm::Value *v = CreateTempAlloca(type);
-        for (size_t i = 0; i < words; i++) {
-            std::vector<llvm::Value *> ind{MakeIntegerConstant(0), MakeIntegerConstant(i)};
-            llvm::Value *              lAddr = builder.CreateGEP(lV, ind, "leftSet");
-            llvm::Value *              rAddr = builder.CreateGEP(rV, ind, "rightSet");
-            llvm::Value *              vAddr = builder.CreateGEP(v, ind, "resSet");
-            llvm::Value *              res = builder.CreateLoad(lAddr, "laddr");
-            llvm::Value *              tmp = builder.CreateLoad(rAddr, "raddr");
-            res = SetOperation(name, res, tmp);
-            builder.CreateStore(res, vAddr);
-        }
+        StoreSetVector(res, v, type);
         return builder.CreateLoad(v, "set");
     }
+
+    if (!resTyIsSet && (name == "Equal" || name == "Contains")) {
+        llvm::Value *rV = MakeAddressable(rhs);
+        llvm::Value *lV = MakeAddressable(lhs);
+        assert(rV && lV && "Should have generated values for left and right set");
+
+        llvm::Value *l = LoadSetVector(lV, type, "leftSet");
+        llvm::Value *r = LoadSetVector(rV, type, "rightSet");
+        llvm::Value *diff;
+        if (name == "Equal") {
+            diff = builder.CreateXor(l, r);
+        } else {
+            // Left is contained in right if no bits of left are outside right.
+            diff = SetOperation("Diff", l, r);
+        }
+        return SetVectorIsEmpty(diff, type);
+    }
     return 0;
 }
 
@@ -646,25 +923,155 @@ static llvm::Value *CallStrFunc(const std::string &name, ExprAST *lhs, ExprAST *
     return builder.CreateCall(f, {lV, rV}, twine);
 }
 
-static llvm::Value *CallStrCat(ExprAST *lhs, ExprAST *rhs) {
-    TRACE();
-    llvm::Value *rV = MakeStringFromExpr(rhs, rhs->Type());
-    llvm::Value *lV = MakeStringFromExpr(lhs, lhs->Type());
+// Call "__LStrIncRef" or "__LStrDecRef" on the long string in v.
+static void LongStrRefCount(const std::string &name, llvm::Value *v) {
+    llvm::Type *    lsTy = Types::GetLongStringType()->LlvmType();
+    llvm::Constant *f = GetFunction(Types::GetVoidType(), {lsTy}, "__LStr" + name);
+    builder.CreateCall(f, {v});
+}
 
-    llvm::Type *strTy = Types::GetStringType()->LlvmType();
-    llvm::Type *pty = llvm::PointerType::getUnqual(strTy);
+// Get the (pointer, length) of the characters in a string, string constant, char array, char
+// or long string. Call ReleaseStringPiece when done with the characters.
+void StringPiece(ExprAST *e, llvm::Value *&ptr, llvm::Value *&len) {
+    if (llvm::isa<Types::LongStringDecl>(e->Type())) {
+        ptr = e->CodeGen();
+        llvm::Constant *f =
+            GetFunction(Types::GetIntegerType(), {ptr->getType()}, "__LStrPeekLength");
+        len = builder.CreateCall(f, {ptr}, "len");
+        return;
+    }
+    if (StringExprAST *se = llvm::dyn_cast<StringExprAST>(e)) {
+        ptr = se->CodeGen();
+        len = MakeIntegerConstant(se->Str().size());
+        return;
+    }
+    if (e->Type()->Type() == Types::TypeDecl::TK_Char) {
+        llvm::Value *v = CreateTempAlloca(Types::GetCharType());
+        builder.CreateStore(e->CodeGen(), v);
+        ptr = v;
+        len = MakeIntegerConstant(1);
+        return;
+    }
 
-    llvm::Constant *f =
-        GetFunction(Types::GetVoidType(), {pty, lV->getType(), rV->getType()}, "__StrConcat");
+    llvm::Value *              v = MakeAddressable(e);
+    std::vector<llvm::Value *> ind = {MakeIntegerConstant(0), MakeIntegerConstant(0)};
+    if (!llvm::isa<Types::StringDecl>(e->Type())) {
+        Types::ArrayDecl *ad = llvm::dyn_cast<Types::ArrayDecl>(e->Type());
+        assert(ad && ad->Ranges().size() == 1 && "Expected single dimension char array");
+        ptr = builder.CreateGEP(v, ind, "str_0");
+        len = MakeIntegerConstant(ad->Ranges()[0]->Size());
+        return;
+    }
+    len = builder.CreateLoad(builder.CreateGEP(v, ind, "str_0"), "len");
+    len = builder.CreateZExt(len, Types::GetIntegerType()->LlvmType());
+    ind[1] = MakeIntegerConstant(1);
+    ptr = builder.CreateGEP(v, ind, "str_1");
+}
 
-    llvm::Value *dest = CreateTempAlloca(Types::GetStringType());
-    builder.CreateCall(f, {dest, lV, rV});
+// Free a long string from StringPiece if it is a temporary.
+void ReleaseStringPiece(ExprAST *e, llvm::Value *ptr) {
+    if (llvm::isa<Types::LongStringDecl>(e->Type())) {
+        LongStrRefCount("ReleaseTemp", ptr);
+    }
+}
+
+// Concatenate all the pieces into dest with a single call to the runtime.
+static llvm::Value *ConcatStrings(llvm::Value *dest, const std::vector<ExprAST *> &pieces) {
+    TRACE();
+    llvm::Type *      intTy = Types::GetIntegerType()->LlvmType();
+    llvm::StructType *pieceTy = llvm::StructType::get(Types::GetVoidPtrType(), intTy);
+    llvm::Value *     arr = CreateTempAlloca(llvm::ArrayType::get(pieceTy, pieces.size()));
+
+    std::vector<llvm::Value *> ind = {MakeIntegerConstant(0), 0, 0};
+    for (size_t i = 0; i < pieces.size(); i++) {
+        llvm::Value *ptr;
+        llvm::Value *len;
+        StringPiece(pieces[i], ptr, len);
+        ind[1] = MakeIntegerConstant(i);
+        ind[2] = MakeIntegerConstant(0);
+        builder.CreateStore(builder.CreateBitCast(ptr, Types::GetVoidPtrType()),
+                            builder.CreateGEP(arr, ind, "piece_str"));
+        ind[2] = MakeIntegerConstant(1);
+        builder.CreateStore(len, builder.CreateGEP(arr, ind, "piece_len"));
+    }
+
+    llvm::Type *    pty = llvm::PointerType::getUnqual(pieceTy);
+    llvm::Constant *f =
+        GetFunction(Types::GetVoidType(), {Types::GetVoidPtrType(), pty, intTy}, "__StrConcatN");
+    ind.resize(2);
+    ind[1] = MakeIntegerConstant(0);
+    llvm::Value *first = builder.CreateGEP(arr, ind, "pieces");
+    builder.CreateCall(f, {builder.CreateBitCast(dest, Types::GetVoidPtrType()), first,
+                           MakeIntegerConstant(pieces.size())});
     return dest;
 }
 
-llvm::Value *BinaryExprAST::CallStrFunc(const std::string &name) {
+// Call a long string runtime function taking (and consuming) two long strings.
+static llvm::Value *CallLongStrFunc(const std::string &name, ExprAST *lhs, ExprAST *rhs,
+                                    Types::TypeDecl *resTy, const std::string &twine) {
     TRACE();
-    return ::CallStrFunc(name, lhs, rhs, Types::GetIntegerType(), "calltmp");
+    llvm::Value *lV = lhs->CodeGen();
+    llvm::Value *rV = rhs->CodeGen();
+
+    llvm::Type *    pty = Types::GetLongStringType()->LlvmType();
+    llvm::Constant *f = GetFunction(resTy, {pty, pty}, "__LStr" + name);
+    return builder.CreateCall(f, {lV, rV}, twine);
+}
+
+// Make a new (temporary) long string from a char, char array, string constant or short string.
+static llvm::Value *MakeLongStringFromExpr(ExprAST *e) {
+    TRACE();
+    llvm::Type *    lsTy = Types::GetLongStringType()->LlvmType();
+    llvm::Type *    intTy = Types::GetIntegerType()->LlvmType();
+    llvm::Constant *f;
+    switch (e->Type()->Type()) {
+    case Types::TypeDecl::TK_LongString:
+        return e->CodeGen();
+
+    case Types::TypeDecl::TK_Char:
+        f = GetFunction(lsTy, {Types::GetCharType()->LlvmType()}, "__LStrFromChar");
+        return builder.CreateCall(f, {e->CodeGen()}, "lstr");
+
+    case Types::TypeDecl::TK_String: {
+        llvm::Value *v = builder.CreateBitCast(MakeAddressable(e), Types::GetVoidPtrType());
+        f = GetFunction(lsTy, {Types::GetVoidPtrType()}, "__LStrFromStr");
+        return builder.CreateCall(f, {v}, "lstr");
+    }
+
+    default:
+        break;
+    }
+
+    llvm::Value *ptr;
+    llvm::Value *len;
+    if (StringExprAST *se = llvm::dyn_cast<StringExprAST>(e)) {
+        ptr = se->CodeGen();
+        len = MakeIntegerConstant(se->Str().size());
+    } else {
+        Types::ArrayDecl *ad = llvm::dyn_cast<Types::ArrayDecl>(e->Type());
+        assert(ad && ad->Ranges().size() == 1 && "Expected single dimension char array");
+        ptr = builder.CreateBitCast(MakeAddressable(e), Types::GetVoidPtrType());
+        len = MakeIntegerConstant(ad->Ranges()[0]->Size());
+    }
+    f = GetFunction(lsTy, {Types::GetVoidPtrType(), intTy}, "__LStrFromChars");
+    return builder.CreateCall(f, {ptr, len}, "lstr");
+}
+
+static bool IsLongString(const VarDef &var) {
+    return llvm::isa<Types::LongStringDecl>(var.Type());
+}
+
+bool BinaryExprAST::StringConcatPieces(std::vector<ExprAST *> &pieces) {
+    if (oper.GetToken() != Token::Plus || !BothStringish(lhs, rhs)) {
+        return false;
+    }
+    for (auto e : {lhs, rhs}) {
+        BinaryExprAST *b = llvm::dyn_cast<BinaryExprAST>(e);
+        if (!b || !b->StringConcatPieces(pieces)) {
+            pieces.push_back(e);
+        }
+    }
+    return true;
 }
 
 llvm::Value *BinaryExprAST::CallArrFunc(const std::string &name, size_t size) {
@@ -712,15 +1119,92 @@ Types::TypeDecl *BinaryExprAST::Type() const {
     return lhs->Type();
 }
 
+// Fold "x in [constant set]" into the cheapest test: an unsigned compare for a
+// contiguous range, a test against a 64-bit mask when the members fit in one
+// register, or a switch for a few widely spread members. The value "l" is relative
+// to the start of the set. Returns 0 if none of these apply.
+static llvm::Value *InlineConstantSetIn(llvm::Value *l, SetExprAST *set) {
+    const size_t MaxSwitchCases = 8;
+    const int    MaskBits = 64;
+
+    for (auto v : set->Values()) {
+        if (!IsConstantSetElement(v)) {
+            return 0;
+        }
+    }
+
+    Types::SetDecl *         type = llvm::dyn_cast<Types::SetDecl>(set->Type());
+    Types::SetDecl::ElemType elems[Types::SetDecl::MaxSetWords] = {};
+    for (auto v : set->Values()) {
+        AddConstantSetElement(elems, v, type);
+    }
+
+    std::vector<int> members;
+    for (int i = 0; i < int(type->SetWords() * Types::SetDecl::SetBits); i++) {
+        if ((elems[i >> Types::SetDecl::SetPow2Bits] >> (i & Types::SetDecl::SetMask)) & 1) {
+            members.push_back(i);
+        }
+    }
+
+    if (members.empty()) {
+        return MakeBooleanConstant(0);
+    }
+
+    int          first = members.front();
+    int          last = members.back();
+    llvm::Value *off = builder.CreateSub(l, MakeIntegerConstant(first), "offset");
+    if (int(members.size()) == last - first + 1) {
+        return builder.CreateICmpULE(off, MakeIntegerConstant(last - first), "inrange");
+    }
+
+    if (last - first < MaskBits) {
+        uint64_t mask = 0;
+        for (auto m : members) {
+            mask |= uint64_t(1) << (m - first);
+        }
+        llvm::Type * maskTy = Types::GetLongIntType()->LlvmType();
+        llvm::Value *inRange = builder.CreateICmpULT(off, MakeIntegerConstant(MaskBits), "inmask");
+        llvm::Value *shift = builder.CreateAnd(off, MakeIntegerConstant(MaskBits - 1));
+        shift = builder.CreateZExt(shift, maskTy);
+        llvm::Value *bit = builder.CreateLShr(llvm::ConstantInt::get(maskTy, mask), shift);
+        bit = builder.CreateTrunc(bit, Types::GetBooleanType()->LlvmType());
+        return builder.CreateAnd(inRange, bit, "inset");
+    }
+
+    if (members.size() <= MaxSwitchCases) {
+        llvm::Function *  fn = builder.GetInsertBlock()->getParent();
+        llvm::BasicBlock *curBB = builder.GetInsertBlock();
+        llvm::BasicBlock *inBB = llvm::BasicBlock::Create(theContext, "inset", fn);
+        llvm::BasicBlock *afterBB = llvm::BasicBlock::Create(theContext, "afterinset", fn);
+        llvm::SwitchInst *sw = builder.CreateSwitch(l, afterBB, members.size());
+        for (auto m : members) {
+            sw->addCase(llvm::cast<llvm::ConstantInt>(MakeIntegerConstant(m)), inBB);
+        }
+        builder.SetInsertPoint(inBB);
+        builder.CreateBr(afterBB);
+        builder.SetInsertPoint(afterBB);
+        llvm::PHINode *phi = builder.CreatePHI(Types::GetBooleanType()->LlvmType(), 2, "inset");
+        phi->addIncoming(MakeBooleanConstant(1), inBB);
+        phi->addIncoming(MakeBooleanConstant(0), curBB);
+        return phi;
+    }
+    return 0;
+}
+
 llvm::Value *BinaryExprAST::SetCodeGen() {
     TRACE();
     if (lhs->Type() && lhs->Type()->IsIntegral() && oper.GetToken() == Token::In) {
         llvm::Value *    l = lhs->CodeGen();
-        llvm::Value *    setV = MakeAddressable(rhs);
         Types::TypeDecl *type = rhs->Type();
         int              start = type->GetRange()->Start();
         l = builder.CreateZExt(l, Types::GetIntegerType()->LlvmType(), "zext.l");
         l = builder.CreateSub(l, MakeIntegerConstant(start));
+        if (SetExprAST *s = llvm::dyn_cast<SetExprAST>(rhs)) {
+            if (llvm::Value *v = InlineConstantSetIn(l, s)) {
+                return v;
+            }
+        }
+        llvm::Value *setV = MakeAddressable(rhs);
         llvm::Value *index;
         if (llvm::dyn_cast<Types::SetDecl>(type)->SetWords() > 1) {
             index = builder.CreateLShr(l, MakeIntegerConstant(Types::SetDecl::SetPow2Bits));
@@ -815,6 +1299,116 @@ llvm::Value *MakeStrCompare(const Token &oper, llvm::Value *v) {
     }
 }
 
+static llvm::Value *CallMemCmp(llvm::Value *a, llvm::Value *b, llvm::Value *size) {
+    const llvm::DataLayout dl(theModule);
+    llvm::Type *           sizeTy = dl.getIntPtrType(theContext);
+    llvm::Type *           pty = Types::GetVoidPtrType();
+    llvm::Constant *       f = GetFunction(Types::GetIntegerType(), {pty, pty, sizeTy}, "memcmp");
+    return builder.CreateCall(f, {builder.CreateBitCast(a, pty), builder.CreateBitCast(b, pty),
+                                  builder.CreateZExt(size, sizeTy)},
+                              "memcmp");
+}
+
+// Compare strings inline. Equality checks the lengths first and only compares the
+// characters when they match; against a string constant the memcmp has a constant size,
+// which LLVM expands into a few wide loads and compares. Ordering compares the common
+// prefix with memcmp and then the lengths.
+static llvm::Value *InlineStrCompare(const Token &oper, ExprAST *lhs, ExprAST *rhs) {
+    TRACE();
+    llvm::Value *lPtr;
+    llvm::Value *lLen;
+    llvm::Value *rPtr;
+    llvm::Value *rLen;
+    StringPiece(lhs, lPtr, lLen);
+    StringPiece(rhs, rPtr, rLen);
+
+    if (oper.GetToken() == Token::Equal || oper.GetToken() == Token::NotEqual) {
+        llvm::Value *size = (llvm::isa<llvm::Constant>(rLen)) ? rLen : lLen;
+        llvm::Value *res = builder.CreateICmpEQ(lLen, rLen, "leneq");
+        llvm::ConstantInt *csize = llvm::dyn_cast<llvm::ConstantInt>(size);
+        if (!csize || !csize->isZero()) {
+            llvm::Function *  fn = builder.GetInsertBlock()->getParent();
+            llvm::BasicBlock *lenBB = builder.GetInsertBlock();
+            llvm::BasicBlock *cmpBB = llvm::BasicBlock::Create(theContext, "streq.cmp", fn);
+            llvm::BasicBlock *doneBB = llvm::BasicBlock::Create(theContext, "streq.done", fn);
+            builder.CreateCondBr(res, cmpBB, doneBB);
+
+            builder.SetInsertPoint(cmpBB);
+            llvm::Value *same =
+                builder.CreateICmpEQ(CallMemCmp(lPtr, rPtr, size), MakeIntegerConstant(0));
+            cmpBB = builder.GetInsertBlock();
+            builder.CreateBr(doneBB);
+
+            builder.SetInsertPoint(doneBB);
+            llvm::PHINode *phi = builder.CreatePHI(Types::GetBooleanType()->LlvmType(), 2, "eq");
+            phi->addIncoming(MakeBooleanConstant(0), lenBB);
+            phi->addIncoming(same, cmpBB);
+            res = phi;
+        }
+        if (oper.GetToken() == Token::NotEqual) {
+            res = builder.CreateNot(res, "ne");
+        }
+        return res;
+    }
+
+    llvm::Value *minLen = builder.CreateSelect(builder.CreateICmpULT(lLen, rLen), lLen, rLen);
+    llvm::Value *cmp = CallMemCmp(lPtr, rPtr, minLen);
+    llvm::Value *diff = builder.CreateSub(lLen, rLen);
+    llvm::Value *same = builder.CreateICmpEQ(cmp, MakeIntegerConstant(0));
+    return MakeStrCompare(oper, builder.CreateSelect(same, diff, cmp, "cmp"));
+}
+
+// "and then" and "or else" only evaluate the right hand side when it decides the result,
+// and so do boolean "and" and "or", unless ISO 7185 mode asks for both sides to be evaluated.
+static bool IsShortCircuit(const Token &oper, ExprAST *lhs) {
+    switch (oper.GetToken()) {
+    case Token::AndThen:
+    case Token::OrElse:
+        return true;
+    case Token::And:
+    case Token::Or:
+        return standard != iso7185 && lhs->Type()->Type() == Types::TypeDecl::TK_Boolean;
+    default:
+        return false;
+    }
+}
+
+static llvm::Value *ShortCircuitCodeGen(const Token &oper, ExprAST *lhs, ExprAST *rhs) {
+    TRACE();
+    bool         isAnd = oper.GetToken() == Token::And || oper.GetToken() == Token::AndThen;
+    llvm::Value *l = lhs->CodeGen();
+    if (!l) {
+        return 0;
+    }
+
+    llvm::Function *  fn = builder.GetInsertBlock()->getParent();
+    llvm::BasicBlock *lhsBB = builder.GetInsertBlock();
+    llvm::BasicBlock *rhsBB =
+        llvm::BasicBlock::Create(theContext, isAnd ? "and.rhs" : "or.rhs", fn);
+    llvm::BasicBlock *doneBB =
+        llvm::BasicBlock::Create(theContext, isAnd ? "and.done" : "or.done", fn);
+    if (isAnd) {
+        builder.CreateCondBr(l, rhsBB, doneBB);
+    } else {
+        builder.CreateCondBr(l, doneBB, rhsBB);
+    }
+
+    builder.SetInsertPoint(rhsBB);
+    llvm::Value *r = rhs->CodeGen();
+    if (!r) {
+        return 0;
+    }
+    rhsBB = builder.GetInsertBlock();
+    builder.CreateBr(doneBB);
+
+    builder.SetInsertPoint(doneBB);
+    llvm::PHINode *phi =
+        builder.CreatePHI(Types::GetBooleanType()->LlvmType(), 2, isAnd ? "and" : "or");
+    phi->addIncoming(MakeBooleanConstant(!isAnd), lhsBB);
+    phi->addIncoming(r, rhsBB);
+    return phi;
+}
+
 llvm::Value *BinaryExprAST::CodeGen() {
     TRACE();
 
@@ -826,6 +1420,10 @@ llvm::Value *BinaryExprAST::CodeGen() {
         rhs->dump();
     }
 
+    if (IsShortCircuit(oper, lhs)) {
+        return ShortCircuitCodeGen(oper, lhs, rhs);
+    }
+
     if (llvm::isa<SetExprAST>(rhs) || llvm::isa<SetExprAST>(lhs) ||
         (rhs->Type() && llvm::isa<Types::SetDecl>(rhs->Type())) ||
         (lhs->Type() && llvm::isa<Types::SetDecl>(lhs->Type()))) {
@@ -834,15 +1432,26 @@ llvm::Value *BinaryExprAST::CodeGen() {
 
     assert(lhs->Type() && rhs->Type() && "Huh? Both sides of expression should have type");
 
+    // Semantics makes sure that both sides are long strings if one is.
+    if (llvm::isa<Types::LongStringDecl>(lhs->Type())) {
+        if (oper.GetToken() == Token::Plus) {
+            return CallLongStrFunc("Concat", lhs, rhs, Types::GetLongStringType(), "concat");
+        }
+        return MakeStrCompare(oper,
+                              CallLongStrFunc("Compare", lhs, rhs, Types::GetIntegerType(), "cmp"));
+    }
+
     if (BothStringish(lhs, rhs)) {
         if (oper.GetToken() == Token::Plus) {
-            return CallStrCat(lhs, rhs);
+            std::vector<ExprAST *> pieces;
+            StringConcatPieces(pieces);
+            return ConcatStrings(CreateTempAlloca(Types::GetStringType()), pieces);
         }
 
         /* We don't need to do this of both sides are char - then it's just a simple comparison */
         if (lhs->Type()->Type() != Types::TypeDecl::TK_Char ||
             rhs->Type()->Type() != Types::TypeDecl::TK_Char) {
-            return MakeStrCompare(oper, CallStrFunc("Compare"));
+            return InlineStrCompare(oper, lhs, rhs);
         }
     }
 
@@ -1009,8 +1618,53 @@ void CallExprAST::DoDump(std::ostream &out) const {
 }
 
 llvm::Value *CallExprAST::CodeGen() {
+    if (proto->IsSRet()) {
+        llvm::Value *dest = CreateTempAlloca(Type());
+        if (!CodeGenInto(dest)) {
+            return 0;
+        }
+        return builder.CreateLoad(dest, "calltmp");
+    }
+    return CodeGenInto(0);
+}
+
+// Can the function write its result straight into dest? Only if nothing the function can
+// see is dest: it must be a local variable, not passed to the function, and the function
+// must not be nested (so it can't see our locals through a closure).
+bool CallExprAST::CanReturnInto(VariableExprAST *dest) {
+    if (!proto->IsSRet() || dest->getKind() != EK_VariableExpr ||
+        *dest->Type() != *Type()) {
+        return false;
+    }
+    FunctionAST *fn = proto->Function();
+    if (!fn || fn->ClosureType()) {
+        return false;
+    }
+    size_t       level;
+    llvm::Value *v = variables.Find(dest->Name(), level);
+    if (!v || !llvm::isa<llvm::AllocaInst>(v) || level == 0 || level != variables.MaxLevel()) {
+        return false;
+    }
+    for (auto a : args) {
+        if (TypeCastAST *tc = llvm::dyn_cast<TypeCastAST>(a)) {
+            a = tc->Expr();
+        }
+        if (llvm::isa<FunctionExprAST>(a) || llvm::isa<TrampolineAST>(a)) {
+            return false;
+        }
+        VariableExprAST *va = llvm::dyn_cast<VariableExprAST>(a);
+        if (va && va->Name() == dest->Name()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Call the function. For functions with compound results, dest is where the result goes.
+llvm::Value *CallExprAST::CodeGenInto(llvm::Value *dest) {
     TRACE();
     assert(proto && "Function prototype should be set");
+    assert(!dest == !proto->IsSRet() && "Expected destination for compound result");
 
     BasicDebugInfo(this);
 
@@ -1025,12 +1679,19 @@ llvm::Value *CallExprAST::CodeGen() {
     std::vector<llvm::Value *>                             argsV;
     std::vector<std::pair<int, llvm::Attribute::AttrKind>> argAttr;
     unsigned                                               index = 0;
+    // Attribute index of the first argument.
+    unsigned first = 1;
+    if (dest) {
+        argsV.push_back(dest);
+        argAttr.push_back(std::make_pair(first, llvm::Attribute::StructRet));
+        first++;
+    }
     for (auto i : args) {
         llvm::Value *v = 0;
 
         if (ClosureAST *ca = llvm::dyn_cast<ClosureAST>(i)) {
             v = ca->CodeGen();
-            argAttr.push_back(std::make_pair(index + 1, llvm::Attribute::Nest));
+            argAttr.push_back(std::make_pair(index + first, llvm::Attribute::Nest));
         } else {
             VariableExprAST *vi = llvm::dyn_cast<VariableExprAST>(i);
             if (vdef[index].IsRef()) {
@@ -1054,13 +1715,25 @@ llvm::Value *CallExprAST::CodeGen() {
                 }
                 if (!v) {
                     if (i->Type()->IsCompound()) {
+                        bool constRef = vdef[index].IsConstRef();
                         if (vi) {
-                            v = LoadOrMemcpy(vi->Address(), vi->Type());
+                            v = vi->Address();
+                            if (!constRef) {
+                                v = LoadOrMemcpy(v, vi->Type());
+                            }
                         } else {
                             v = CreateTempAlloca(i->Type());
-                            builder.CreateStore(i->CodeGen(), v);
+                            CallExprAST *call = llvm::dyn_cast<CallExprAST>(i);
+                            if (call && call->proto->IsSRet()) {
+                                call->CodeGenInto(v);
+                            } else {
+                                builder.CreateStore(i->CodeGen(), v);
+                            }
+                        }
+                        if (!constRef) {
+                            argAttr.push_back(
+                                std::make_pair(index + first, llvm::Attribute::ByVal));
                         }
-                        argAttr.push_back(std::make_pair(index + 1, llvm::Attribute::ByVal));
                     } else {
                         if (!(v = i->CodeGen())) {
                             return 0;
@@ -1074,13 +1747,14 @@ llvm::Value *CallExprAST::CodeGen() {
         index++;
     }
     const char *res = "";
-    if (proto->Type()->Type() != Types::TypeDecl::TK_Void) {
+    if (proto->Type()->Type() != Types::TypeDecl::TK_Void && !dest) {
         res = "calltmp";
     }
     llvm::CallInst *inst = builder.CreateCall(calleF, argsV, res);
     for (auto v : argAttr) {
         inst->addAttribute(v.first, v.second);
     }
+    inst->setDoesNotThrow();
     return inst;
 }
 
@@ -1110,9 +1784,11 @@ llvm::Value *BlockAST::CodeGen() {
     TRACE();
 
     for (auto e : content) {
+        BeginTempScope();
         llvm::Value *v = e->CodeGen();
         (void)v;
         assert(v && "Expect codegen to work!");
+        EndTempScope();
     }
     return NoOpValue();
 }
@@ -1134,27 +1810,54 @@ llvm::Function *PrototypeAST::Create(const std::string &namePrefix) {
     }
 
     std::vector<std::pair<int, llvm::Attribute::AttrKind>> argAttr;
-    std::vector<llvm::Type *>                              argTypes;
-    unsigned                                               index = 0;
-    for (auto i : args) {
+    // Pointer arguments that always point at a whole object: var, const and closure
+    // arguments, and the result.
+    std::vector<std::pair<int, llvm::Type *>> objArgs;
+    std::vector<llvm::Type *>                 argTypes;
+    unsigned                                  index = 0;
+    llvm::Type *                              resTy = type->LlvmType();
+    // Compound results are written to memory provided by the caller.
+    if (IsSRet()) {
+        index++;
+        argTypes.push_back(llvm::PointerType::getUnqual(resTy));
+        argAttr.push_back(std::make_pair(index, llvm::Attribute::StructRet));
+        argAttr.push_back(std::make_pair(index, llvm::Attribute::NoAlias));
+        objArgs.push_back(std::make_pair(index, resTy));
+        resTy = Types::GetVoidType()->LlvmType();
+    }
+    for (auto &i : args) {
         llvm::AttrBuilder attrs;
         assert(i.Type() && "Invalid type for argument");
         llvm::Type *argTy = i.Type()->LlvmType();
 
         index++;
-        if (index == 1 && Function()->ClosureType()) {
+        bool isClosure = &i == &args[0] && Function()->ClosureType();
+        if (isClosure) {
             argAttr.push_back(std::make_pair(index, llvm::Attribute::Nest));
         }
         if (i.IsRef() || i.Type()->IsCompound()) {
-            argTy = llvm::PointerType::getUnqual(argTy);
-            if (!i.IsRef()) {
+            if (i.IsConstRef()) {
+                // The callee only reads it, and nothing else writes it during the call.
+                argAttr.push_back(std::make_pair(index, llvm::Attribute::ReadOnly));
+                argAttr.push_back(std::make_pair(index, llvm::Attribute::NoAlias));
+                argAttr.push_back(std::make_pair(index, llvm::Attribute::NoCapture));
+            } else if (!i.IsRef()) {
                 argAttr.push_back(std::make_pair(index, llvm::Attribute::ByVal));
             }
+            if (i.IsRef() || i.IsConstRef() || isClosure) {
+                // A string may be shorter than the argument's type, which only tells us that
+                // the length is there.
+                llvm::Type *objTy = argTy;
+                if (llvm::isa<Types::StringDecl>(i.Type())) {
+                    objTy = Types::GetCharType()->LlvmType();
+                }
+                objArgs.push_back(std::make_pair(index, objTy));
+            }
+            argTy = llvm::PointerType::getUnqual(argTy);
         }
 
         argTypes.push_back(argTy);
     }
-    llvm::Type *resTy = type->LlvmType();
     std::string actualName;
     /* Don't mangle our 'main' functions name, as we call that from C */
     if (name == "__PascalMain") {
@@ -1173,17 +1876,31 @@ llvm::Function *PrototypeAST::Create(const std::string &namePrefix) {
         return ErrorF(this, "redefinition of function: " + name);
     }
 
-    assert(llvmFunc->arg_size() == args.size() && "Expect number of arguments to match");
+    assert(llvmFunc->arg_size() == args.size() + IsSRet() &&
+           "Expect number of arguments to match");
 
-    auto a = args.begin();
-    for (auto &arg : llvmFunc->args()) {
-        arg.setName(a->Name());
-        a++;
+    llvm::Function::arg_iterator ai = llvmFunc->arg_begin();
+    if (IsSRet()) {
+        ai->setName("result");
+        ai++;
+    }
+    for (auto a : args) {
+        ai->setName(a.Name());
+        ai++;
     }
 
     for (auto v : argAttr) {
         llvmFunc->addAttribute(v.first, v.second);
     }
+    const llvm::DataLayout dl(theModule);
+    for (auto v : objArgs) {
+        llvmFunc->addAttribute(v.first, llvm::Attribute::NonNull);
+        if (v.second->isSized()) {
+            if (uint64_t size = dl.getTypeAllocSize(v.second)) {
+                llvmFunc->addDereferenceableAttr(v.first, size);
+            }
+        }
+    }
     // TODO: Allow this to be disabled.
     llvmFunc->addFnAttr("no-frame-pointer-elim", "true");
 
@@ -1195,6 +1912,11 @@ void PrototypeAST::CreateArgumentAlloca() {
 
     unsigned                     offset = 0;
     llvm::Function::arg_iterator ai = llvmFunc->arg_begin();
+    llvm::Value *                result = 0;
+    if (IsSRet()) {
+        result = &*ai;
+        ai++;
+    }
     if (Types::TypeDecl *closureType = Function()->ClosureType()) {
         assert(closureType == args[0].Type() && "Expect type to match here");
         // Skip over the closure argument in the loop below.
@@ -1222,6 +1944,10 @@ void PrototypeAST::CreateArgumentAlloca() {
         } else {
             a = CreateAlloca(llvmFunc, args[idx]);
             builder.CreateStore(&*ai, a);
+            // The callee holds a reference to long strings passed by value.
+            if (IsLongString(args[idx])) {
+                LongStrRefCount("IncRef", &*ai);
+            }
         }
         if (!variables.Add(args[idx].Name(), a)) {
             ErrorF(this, "Duplicate variable name " + args[idx].Name());
@@ -1252,8 +1978,14 @@ void PrototypeAST::CreateArgumentAlloca() {
         }
     }
     if (type->Type() != Types::TypeDecl::TK_Void) {
-        std::string       shortname = ShortName(name);
-        llvm::AllocaInst *a = CreateAlloca(llvmFunc, VarDef(shortname, type));
+        std::string  shortname = ShortName(name);
+        llvm::Value *a = result;
+        if (!a) {
+            a = CreateAlloca(llvmFunc, VarDef(shortname, type));
+        }
+        if (llvm::isa<Types::LongStringDecl>(type)) {
+            builder.CreateStore(llvm::Constant::getNullValue(type->LlvmType()), a);
+        }
         if (!variables.Add(shortname, a)) {
             ErrorF(this, "Duplicate function result name '" + shortname + "'.");
         }
@@ -1286,9 +2018,10 @@ bool PrototypeAST::operator==(const PrototypeAST &rhs) const {
     if (baseobj != rhs.baseobj || args.size() != rhs.args.size()) {
         return false;
     }
-    // Not equal if args are different types
+    // Not equal if args are different types, or passed differently
     for (size_t i = 0; i < args.size(); i++) {
-        if (*args[i].Type() != *rhs.args[i].Type()) {
+        if (*args[i].Type() != *rhs.args[i].Type() ||
+            args[i].IsConstRef() != rhs.args[i].IsConstRef()) {
             return false;
         }
     }
@@ -1316,7 +2049,8 @@ bool PrototypeAST::IsMatchWithoutClosure(const PrototypeAST *rhs) const {
         return false;
     }
     for (size_t i = 0; i < rhs->args.size(); i++) {
-        if (*args[i + 1].Type() != *rhs->args[i].Type()) {
+        if (*args[i + 1].Type() != *rhs->args[i].Type() ||
+            args[i + 1].IsConstRef() != rhs->args[i].IsConstRef()) {
             return false;
         }
     }
@@ -1379,6 +2113,10 @@ llvm::Function *FunctionAST::CodeGen(const std::string &namePrefix) {
     if (!body) {
         return theFunction;
     }
+    // Everything is compiled into one module, so only main is called from outside it.
+    if (proto->Name() != "__PascalMain") {
+        theFunction->setLinkage(llvm::Function::InternalLinkage);
+    }
 
     if (debugInfo) {
         DebugInfo &    di = GetDebugInfo();
@@ -1421,6 +2159,7 @@ llvm::Function *FunctionAST::CodeGen(const std::string &namePrefix) {
     }
     builder.SetInsertPoint(bb, ip);
     llvm::Value *block = body->CodeGen();
+    ClearFreeTemps();
     if (!block && !body->IsEmpty()) {
         return 0;
     }
@@ -1430,13 +2169,19 @@ llvm::Function *FunctionAST::CodeGen(const std::string &namePrefix) {
         DebugInfo &di = GetDebugInfo();
         di.EmitLocation(endLoc);
     }
-    if (proto->Type()->Type() == Types::TypeDecl::TK_Void) {
+    ReleaseLongStrings();
+    if (proto->Type()->Type() == Types::TypeDecl::TK_Void || proto->IsSRet()) {
         builder.CreateRetVoid();
     } else {
         std::string  shortname = ShortName(proto->Name());
         llvm::Value *v = variables.Find(shortname);
         assert(v && "Expect function result 'variable' to exist");
         llvm::Value *retVal = builder.CreateLoad(v, shortname);
+        if (llvm::isa<Types::LongStringDecl>(proto->Type())) {
+            llvm::Type *    lsTy = retVal->getType();
+            llvm::Constant *f = GetFunction(lsTy, {lsTy}, "__LStrResult");
+            retVal = builder.CreateCall(f, {retVal}, "result");
+        }
         builder.CreateRet(retVal);
     }
 
@@ -1457,6 +2202,28 @@ llvm::Function *FunctionAST::CodeGen() {
     return CodeGen("P");
 }
 
+// Drop the references held by local long string variables and long string value arguments.
+void FunctionAST::ReleaseLongStrings() {
+    std::vector<VarDef> vars;
+    for (auto d : varDecls) {
+        for (auto v : d->Vars()) {
+            vars.push_back(v);
+        }
+    }
+    for (auto a : proto->Args()) {
+        if (!a.IsRef()) {
+            vars.push_back(a);
+        }
+    }
+    for (auto v : vars) {
+        if (IsLongString(v)) {
+            llvm::Value *addr = variables.Find(v.Name());
+            assert(addr && "Expected to find long string variable");
+            LongStrRefCount("DecRef", builder.CreateLoad(addr, v.Name()));
+        }
+    }
+}
+
 Types::TypeDecl *FunctionAST::ClosureType() {
     if (usedVariables.empty()) {
         return 0;
@@ -1511,10 +2278,58 @@ llvm::Value *AssignExprAST::AssignStr() {
         return TempStringFromStringExpr(dest, srhs);
     }
 
+    // Concatenate straight into the destination; "s := s + ..." then just appends.
+    std::vector<ExprAST *> pieces;
+    BinaryExprAST *        brhs = llvm::dyn_cast<BinaryExprAST>(rhs);
+    if (brhs && brhs->StringConcatPieces(pieces)) {
+        return ConcatStrings(lhsv->Address(), pieces);
+    }
+
     assert(llvm::isa<Types::StringDecl>(rhs->Type()));
     return CallStrFunc("Assign", lhs, rhs, Types::GetVoidType(), "");
 }
 
+llvm::Value *AssignExprAST::AssignLongStr() {
+    TRACE();
+    VariableExprAST *lhsv = llvm::dyn_cast<VariableExprAST>(lhs);
+    assert(lhsv && "Expect variable in lhs");
+
+    llvm::Value *dest = lhsv->Address();
+    llvm::Type * lsTy = Types::GetLongStringType()->LlvmType();
+
+    // "s := s + a + b" appends to s, which extends it in place when nothing else refers to it,
+    // rather than copying all of s every time round a loop.
+    std::vector<ExprAST *> tail;
+    ExprAST *              first = rhs;
+    while (BinaryExprAST *b = llvm::dyn_cast<BinaryExprAST>(first)) {
+        if (b->oper.GetToken() != Token::Plus ||
+            !llvm::isa<Types::LongStringDecl>(b->lhs->Type())) {
+            break;
+        }
+        tail.insert(tail.begin(), b->rhs);
+        first = b->lhs;
+    }
+    if (!tail.empty() && lhsv->getKind() == EK_VariableExpr &&
+        first->getKind() == EK_VariableExpr &&
+        llvm::dyn_cast<VariableExprAST>(first)->Name() == lhsv->Name()) {
+        // s is read first, and held on to in case evaluating the rest assigns s.
+        llvm::Value *old = builder.CreateLoad(dest, "old");
+        LongStrRefCount("IncRef", old);
+        llvm::Value *v = tail[0]->CodeGen();
+        for (size_t i = 1; i < tail.size(); i++) {
+            llvm::Constant *cat = GetFunction(lsTy, {lsTy, lsTy}, "__LStrConcat");
+            v = builder.CreateCall(cat, {v, tail[i]->CodeGen()}, "concat");
+        }
+        llvm::Constant *f =
+            GetFunction(Types::GetVoidType(), {dest->getType(), lsTy, lsTy}, "__LStrAppend");
+        return builder.CreateCall(f, {dest, old, v});
+    }
+
+    llvm::Value *   v = MakeLongStringFromExpr(rhs);
+    llvm::Constant *f = GetFunction(Types::GetVoidType(), {dest->getType(), lsTy}, "__LStrAssign");
+    return builder.CreateCall(f, {dest, v});
+}
+
 llvm::Value *AssignExprAST::AssignSet() {
     if (llvm::Value *v = rhs->CodeGen()) {
         VariableExprAST *lhsv = llvm::dyn_cast<VariableExprAST>(lhs);
@@ -1538,10 +2353,20 @@ llvm::Value *AssignExprAST::CodeGen() {
         return ErrorV(this, "Left hand side of assignment must be a variable");
     }
 
+    // Let the function write its result straight into the variable.
+    CallExprAST *call = llvm::dyn_cast<CallExprAST>(rhs);
+    if (call && call->CanReturnInto(lhsv)) {
+        return call->CodeGenInto(lhsv->Address());
+    }
+
     if (llvm::isa<const Types::StringDecl>(lhsv->Type())) {
         return AssignStr();
     }
 
+    if (llvm::isa<Types::LongStringDecl>(lhsv->Type())) {
+        return AssignLongStr();
+    }
+
     if (llvm::isa<Types::SetDecl>(lhsv->Type())) {
         return AssignSet();
     }
@@ -1661,6 +2486,13 @@ llvm::Value *IfExprAST::CodeGen() {
 
 void ForExprAST::DoDump(std::ostream &out) const {
     out << "for: " << std::endl;
+    if (!end) {
+        out << " in ";
+        start->dump(out);
+        out << " do ";
+        body->dump(out);
+        return;
+    }
     start->dump(out);
     if (stepDown) {
         out << " downto ";
@@ -1674,15 +2506,94 @@ void ForExprAST::DoDump(std::ostream &out) const {
 
 void ForExprAST::accept(ASTVisitor &v) {
     start->accept(v);
-    end->accept(v);
+    if (end) {
+        end->accept(v);
+    }
     body->accept(v);
     v.visit(this);
 }
 
+// Iterate over the members of a set, a word at a time. Within a word, use cttz to find
+// the lowest member, and clear it before the next iteration, so that only members of
+// the set are visited.
+llvm::Value *ForExprAST::ForInGen() {
+    TRACE();
+
+    llvm::Function *theFunction = builder.GetInsertBlock()->getParent();
+    llvm::Value *   var = variable->Address();
+    assert(var && "Expected variable here");
+
+    Types::SetDecl *setType = llvm::dyn_cast<Types::SetDecl>(start->Type());
+    assert(setType && "Expected a set for 'for in' loop");
+    llvm::Value *setV = MakeAddressable(start);
+    assert(setV && "Expected set to generate code");
+
+    llvm::Value *wordVar = CreateTempAlloca(Types::GetIntegerType());
+    llvm::Value *bitsVar = CreateTempAlloca(Types::GetIntegerType());
+    llvm::Type * intTy = Types::GetIntegerType()->LlvmType();
+    llvm::Type * boolTy = Types::GetBooleanType()->LlvmType();
+    std::string     name = "llvm.cttz.i" + std::to_string(Types::SetDecl::SetBits);
+    llvm::Constant *cttz = GetFunction(intTy, {intTy, boolTy}, name);
+
+    builder.CreateStore(MakeIntegerConstant(0), wordVar);
+
+    llvm::BasicBlock *wordBB = llvm::BasicBlock::Create(theContext, "forword", theFunction);
+    llvm::BasicBlock *testBB = llvm::BasicBlock::Create(theContext, "forbits", theFunction);
+    llvm::BasicBlock *loopBB = llvm::BasicBlock::Create(theContext, "loop", theFunction);
+    llvm::BasicBlock *nextBB = llvm::BasicBlock::Create(theContext, "nextword", theFunction);
+    llvm::BasicBlock *afterBB = llvm::BasicBlock::Create(theContext, "afterloop", theFunction);
+
+    builder.CreateBr(wordBB);
+    builder.SetInsertPoint(wordBB);
+    llvm::Value *word = builder.CreateLoad(wordVar, "word");
+    std::vector<llvm::Value *> ind{MakeIntegerConstant(0), word};
+    llvm::Value *              bitsetAddr = builder.CreateGEP(setV, ind, "bitsetaddr");
+    builder.CreateStore(builder.CreateLoad(bitsetAddr, "bitset"), bitsVar);
+    builder.CreateBr(testBB);
+
+    builder.SetInsertPoint(testBB);
+    llvm::Value *bits = builder.CreateLoad(bitsVar, "bits");
+    llvm::Value *anyBits = builder.CreateICmpNE(bits, MakeIntegerConstant(0), "anybits");
+    builder.CreateCondBr(anyBits, loopBB, nextBB);
+
+    builder.SetInsertPoint(loopBB);
+    llvm::Value *bit = builder.CreateCall(cttz, {bits, MakeBooleanConstant(1)}, "bit");
+    llvm::Value *rest = builder.CreateAnd(bits, builder.CreateSub(bits, MakeIntegerConstant(1)));
+    builder.CreateStore(rest, bitsVar);
+    word = builder.CreateLoad(wordVar, "word");
+    llvm::Value *value =
+        builder.CreateShl(word, MakeIntegerConstant(Types::SetDecl::SetPow2Bits), "value");
+    value = builder.CreateOr(value, bit);
+    value = builder.CreateAdd(value, MakeIntegerConstant(setType->GetRange()->Start()));
+    value = builder.CreateSExtOrTrunc(value, variable->Type()->LlvmType());
+    builder.CreateStore(value, var);
+    if (!body->CodeGen()) {
+        return 0;
+    }
+    BasicDebugInfo(this);
+    builder.CreateBr(testBB);
+
+    builder.SetInsertPoint(nextBB);
+    word = builder.CreateLoad(wordVar, "word");
+    word = builder.CreateAdd(word, MakeIntegerConstant(1), "nextword");
+    builder.CreateStore(word, wordVar);
+    llvm::Value *endCond =
+        builder.CreateICmpULT(word, MakeIntegerConstant(setType->SetWords()), "loopcond");
+    builder.CreateCondBr(endCond, wordBB, afterBB);
+
+    builder.SetInsertPoint(afterBB);
+
+    return afterBB;
+}
+
 llvm::Value *ForExprAST::CodeGen() {
     TRACE();
     BasicDebugInfo(this);
 
+    if (!end) {
+        return ForInGen();
+    }
+
     llvm::Function *theFunction = builder.GetInsertBlock()->getParent();
     llvm::Value *   var = variable->Address();
     assert(var && "Expected variable here");
@@ -1827,7 +2738,11 @@ void RepeatExprAST::accept(ASTVisitor &v) {
 }
 
 void WriteAST::DoDump(std::ostream &out) const {
-    if (isWriteln) {
+    if (isWriteStr) {
+        out << "WriteStr(";
+        file->dump(out);
+        out << ", ";
+    } else if (isWriteln) {
         out << "Writeln(";
     } else {
         out << "Write(";
@@ -1862,69 +2777,10 @@ void WriteAST::accept(ASTVisitor &v) {
             a.precision->accept(v);
         }
     }
-}
-
-static llvm::Constant *CreateWriteFunc(Types::TypeDecl *ty, llvm::Type *fty) {
-    std::string               suffix;
-    llvm::Type *              intTy = Types::GetIntegerType()->LlvmType();
-    std::vector<llvm::Type *> argTypes{fty};
-    switch (ty->Type()) {
-    case Types::TypeDecl::TK_Char:
-        argTypes.push_back(ty->LlvmType());
-        argTypes.push_back(intTy);
-        suffix = "char";
-        break;
-
-    case Types::TypeDecl::TK_Boolean:
-        argTypes.push_back(ty->LlvmType());
-        argTypes.push_back(intTy);
-        suffix = "bool";
-        break;
-
-    case Types::TypeDecl::TK_Integer:
-        argTypes.push_back(intTy);
-        argTypes.push_back(intTy);
-        suffix = "int";
-        break;
-
-    case Types::TypeDecl::TK_LongInt:
-        argTypes.push_back(ty->LlvmType());
-        argTypes.push_back(intTy);
-        suffix = "int64";
-        break;
-
-    case Types::TypeDecl::TK_Real:
-        // Args: double, int, int
-        argTypes.push_back(ty->LlvmType());
-        argTypes.push_back(intTy);
-        argTypes.push_back(intTy);
-        suffix = "real";
-        break;
-
-    case Types::TypeDecl::TK_String: {
-        llvm::Type *pty = llvm::PointerType::getUnqual(Types::GetCharType()->LlvmType());
-        argTypes.push_back(pty);
-        argTypes.push_back(intTy);
-        suffix = "str";
-        break;
+    // Only WriteStr is checked, as it modifies its destination.
+    if (isWriteStr) {
+        v.visit(this);
     }
-    case Types::TypeDecl::TK_Array: {
-        Types::ArrayDecl *ad = llvm::dyn_cast<Types::ArrayDecl>(ty);
-        assert(ad && "Expect array declaration to expand!");
-        assert(ad->SubType()->Type() == Types::TypeDecl::TK_Char && "Expected char type");
-        llvm::Type *pty = llvm::PointerType::getUnqual(Types::GetCharType()->LlvmType());
-        argTypes.push_back(pty);
-        argTypes.push_back(intTy);
-        argTypes.push_back(intTy);
-        suffix = "chars";
-        break;
-    }
-    default:
-        ty->dump(std::cerr);
-        assert(0);
-        return ErrorF(0, "Invalid type argument for write");
-    }
-    return GetFunction(Types::GetVoidType(), argTypes, "__write_" + suffix);
 }
 
 static llvm::Constant *CreateWriteBinFunc(llvm::Type *ty, llvm::Type *fty) {
@@ -1936,88 +2792,197 @@ static llvm::Constant *CreateWriteBinFunc(llvm::Type *ty, llvm::Type *fty) {
     return f;
 }
 
-llvm::Value *WriteAST::CodeGen() {
-    TRACE();
+// Kinds of argument to __write_args. Must match the runtime.
+enum WriteKind {
+    WK_Int,
+    WK_Real,
+    WK_Char,
+    WK_Bool,
+    WK_Str,
+    WK_Chars,
+    WK_LStr,
+};
 
-    BasicDebugInfo(this);
+static llvm::StructType *WriteArgType() {
+    llvm::Type *intTy = Types::GetIntegerType()->LlvmType();
+    llvm::Type *int64Ty = Types::GetLongIntType()->LlvmType();
+    return llvm::StructType::get(intTy, intTy, intTy, intTy, int64Ty);
+}
 
-    llvm::Value *f = file->Address();
-    llvm::Value *v = 0;
-    bool         isText = llvm::isa<Types::TextDecl>(file->Type());
-    if (isText && args.empty() && !isWriteln) {
-        return NoOpValue();
-    }
-    for (auto arg : args) {
-        std::vector<llvm::Value *> argsV;
-        llvm::Constant *           fn;
-        argsV.push_back(f);
-        if (isText) {
+static llvm::Value *CallWriteArgs(llvm::Value *f, llvm::Value *args, size_t count, bool newline) {
+    llvm::Type *              intTy = Types::GetIntegerType()->LlvmType();
+    std::vector<llvm::Type *> argTypes = {f->getType(), args->getType(), intTy, intTy};
+    llvm::Constant *          fn = GetFunction(Types::GetVoidType(), argTypes, "__write_args");
+    return builder.CreateCall(
+        fn, {f, args, MakeIntegerConstant(count), MakeIntegerConstant(newline)});
+}
+
+// Text is written with one call to __write_args (or __writestr_args or __writelstr_args
+// for WriteStr), which takes an array of descriptors {kind, width, precision, length, value}
+// for the arguments.
+llvm::Value *WriteAST::TextArgs() {
+    TRACE();
+    llvm::Type *       intTy = Types::GetIntegerType()->LlvmType();
+    llvm::Type *       int64Ty = Types::GetLongIntType()->LlvmType();
+    llvm::StructType * argTy = WriteArgType();
+    llvm::Value *      argsV = llvm::Constant::getNullValue(llvm::PointerType::getUnqual(argTy));
+    if (!args.empty()) {
+        llvm::Value *arr = CreateTempAlloca(llvm::ArrayType::get(argTy, args.size()));
+        std::vector<llvm::Value *> ind{MakeIntegerConstant(0), 0, 0};
+        for (size_t index = 0; index < args.size(); index++) {
+            const WriteArg & arg = args[index];
             Types::TypeDecl *type = arg.expr->Type();
             assert(type && "Expected type here");
-            if (!(fn = CreateWriteFunc(type, f->getType()))) {
-                return 0;
-            }
-            if (type->Type() == Types::TypeDecl::TK_String) {
+            WriteKind    kind;
+            llvm::Value *v;
+            llvm::Value *len = MakeIntegerConstant(0);
+            switch (type->Type()) {
+            case Types::TypeDecl::TK_Integer:
+            case Types::TypeDecl::TK_LongInt:
+                kind = WK_Int;
+                v = arg.expr->CodeGen();
+                break;
+            case Types::TypeDecl::TK_Real:
+                kind = WK_Real;
+                v = arg.expr->CodeGen();
+                break;
+            case Types::TypeDecl::TK_Char:
+                kind = WK_Char;
+                v = arg.expr->CodeGen();
+                break;
+            case Types::TypeDecl::TK_Boolean:
+                kind = WK_Bool;
+                v = arg.expr->CodeGen();
+                break;
+            case Types::TypeDecl::TK_LongString:
+                kind = WK_LStr;
+                v = arg.expr->CodeGen();
+                break;
+            case Types::TypeDecl::TK_String:
+                kind = WK_Str;
                 if (AddressableAST *a = llvm::dyn_cast<AddressableAST>(arg.expr)) {
                     v = a->Address();
                 } else {
                     v = MakeAddressable(arg.expr);
                 }
-
-                std::vector<llvm::Value *> ind{MakeIntegerConstant(0), MakeIntegerConstant(0)};
-                v = builder.CreateGEP(v, ind, "str_addr");
-            } else if (type->Type() == Types::TypeDecl::TK_Array &&
-                       type->SubType()->Type() == Types::TypeDecl::TK_Char) {
+                break;
+            case Types::TypeDecl::TK_Array:
+                assert(type->SubType()->Type() == Types::TypeDecl::TK_Char &&
+                       "Expected char type");
+                kind = WK_Chars;
                 if (llvm::isa<StringExprAST>(arg.expr)) {
                     v = arg.expr->CodeGen();
                 } else {
                     AddressableAST *a = llvm::dyn_cast<AddressableAST>(arg.expr);
                     assert(a && "Expected addressable value");
                     v = a->Address();
-                    std::vector<llvm::Value *> ind{MakeIntegerConstant(0), MakeIntegerConstant(0)};
-                    v = builder.CreateGEP(v, ind, "str_addr");
                 }
-                argsV.push_back(v);
-                v = MakeIntegerConstant(type->Size());
-            } else {
-                v = arg.expr->CodeGen();
+                len = MakeIntegerConstant(type->Size());
+                break;
+            default:
+                return ErrorV(this, "Invalid type argument for write");
             }
             if (!v) {
                 return ErrorV(this, "Argument codegen failed");
             }
-            argsV.push_back(v);
+
             llvm::Value *w = MakeIntegerConstant(0);
             if (arg.width) {
                 w = arg.width->CodeGen();
                 assert(w && "Expect width expression to generate code ok");
+                if (!w->getType()->isIntegerTy()) {
+                    return ErrorV(this, "Expected width to be integer value");
+                }
+            }
+            llvm::Value *p = MakeIntegerConstant(kind == WK_Real ? -1 : 0);
+            if (arg.precision) {
+                p = arg.precision->CodeGen();
+                if (!p->getType()->isIntegerTy()) {
+                    return ErrorV(this, "Expected precision to be integer value");
+                }
             }
 
-            if (!w->getType()->isIntegerTy()) {
-                return ErrorV(this, "Expected width to be integer value");
+            ind[1] = MakeIntegerConstant(index);
+            llvm::Value *fields[4] = {MakeIntegerConstant(kind),
+                                      builder.CreateSExtOrTrunc(w, intTy),
+                                      builder.CreateSExtOrTrunc(p, intTy), len};
+            for (int i = 0; i < 4; i++) {
+                ind[2] = MakeIntegerConstant(i);
+                builder.CreateStore(fields[i], builder.CreateGEP(arr, ind, "arg"));
             }
-            argsV.push_back(w);
-            if (type->Type() == Types::TypeDecl::TK_Real) {
-                llvm::Value *p;
-                if (arg.precision) {
-                    p = arg.precision->CodeGen();
-                    if (!p->getType()->isIntegerTy()) {
-                        return ErrorV(this, "Expected precision to be integer value");
-                    }
-                } else {
-                    p = MakeIntegerConstant(-1);
-                }
-                argsV.push_back(p);
+            ind[2] = MakeIntegerConstant(4);
+            llvm::Value *val = builder.CreateGEP(arr, ind, "value");
+            if (kind == WK_Int) {
+                v = builder.CreateSExtOrTrunc(v, int64Ty);
+            } else if (kind == WK_Char || kind == WK_Bool) {
+                v = builder.CreateZExt(v, int64Ty);
+            } else {
+                val = builder.CreateBitCast(val, llvm::PointerType::getUnqual(v->getType()));
             }
-        } else {
-            v = MakeAddressable(arg.expr);
-            argsV.push_back(builder.CreateBitCast(v, Types::GetVoidPtrType()));
-            fn = CreateWriteBinFunc(v->getType(), f->getType());
+            builder.CreateStore(v, val);
         }
-        v = builder.CreateCall(fn, argsV, "");
+        ind[1] = MakeIntegerConstant(0);
+        argsV = builder.CreateGEP(arr, {ind[0], ind[1]}, "args");
     }
-    if (isWriteln) {
-        llvm::Constant *fn = GetFunction(Types::GetVoidType(), {f->getType()}, "__write_nl");
-        v = builder.CreateCall(fn, f, "");
+    return argsV;
+}
+
+llvm::Value *WriteAST::CodeGen() {
+    TRACE();
+
+    BasicDebugInfo(this);
+
+    llvm::Value *f = 0;
+    llvm::Value *v = 0;
+    bool         isText = isWriteStr || llvm::isa<Types::TextDecl>(file->Type());
+    bool         isLongStr = isWriteStr && llvm::isa<Types::LongStringDecl>(file->Type());
+    if (isWriteStr && !isLongStr) {
+        // Format into a temporary string, so that the destination can also be an argument.
+        f = CreateTempAlloca(Types::GetStringType());
+        std::vector<llvm::Value *> ind{MakeIntegerConstant(0), MakeIntegerConstant(0)};
+        builder.CreateStore(MakeCharConstant(0), builder.CreateGEP(f, ind, "str_0"));
+    } else {
+        f = file->Address();
+    }
+    if (isText && args.empty() && !isWriteln && !isWriteStr) {
+        return NoOpValue();
+    }
+    if (isText) {
+        llvm::Value *argsV = TextArgs();
+        if (!argsV) {
+            return 0;
+        }
+        if (!isWriteStr) {
+            return CallWriteArgs(f, argsV, args.size(), isWriteln);
+        }
+        if (isLongStr) {
+            // The runtime builds the result in a new string, which can be any length.
+            llvm::Value *             dest = file->Address();
+            std::vector<llvm::Type *> argTypes = {dest->getType(), argsV->getType(),
+                                                  Types::GetIntegerType()->LlvmType()};
+            llvm::Constant *fn = GetFunction(Types::GetVoidType(), argTypes, "__writelstr_args");
+            return builder.CreateCall(fn, {dest, argsV, MakeIntegerConstant(args.size())});
+        }
+        std::vector<llvm::Type *> argTypes = {f->getType(), argsV->getType(),
+                                              Types::GetIntegerType()->LlvmType()};
+        llvm::Constant *fn = GetFunction(Types::GetVoidType(), argTypes, "__writestr_args");
+        v = builder.CreateCall(fn, {f, argsV, MakeIntegerConstant(args.size())});
+    } else {
+        for (auto arg : args) {
+            llvm::Value *ptr = MakeAddressable(arg.expr);
+            llvm::Value *val = builder.CreateBitCast(ptr, Types::GetVoidPtrType());
+            v = builder.CreateCall(CreateWriteBinFunc(ptr->getType(), f->getType()), {f, val});
+        }
+        if (isWriteln) {
+            llvm::Type *argPtrTy = llvm::PointerType::getUnqual(WriteArgType());
+            v = CallWriteArgs(f, llvm::Constant::getNullValue(argPtrTy), 0, true);
+        }
+    }
+    if (isWriteStr) {
+        llvm::Value *   dest = file->Address();
+        llvm::Constant *fn =
+            GetFunction(Types::GetVoidType(), {dest->getType(), f->getType()}, "__StrAssign");
+        v = builder.CreateCall(fn, {dest, f});
     }
     return v;
 }
@@ -2047,6 +3012,15 @@ void ReadAST::accept(ASTVisitor &v) {
     v.visit(this);
 }
 
+// Integer subranges that can't be negative are read as unsigned, up to the end of the range.
+static Types::RangeDecl *UnsignedReadRange(Types::TypeDecl *ty) {
+    Types::RangeDecl *rd = llvm::dyn_cast<Types::RangeDecl>(ty);
+    if (rd && rd->Type() == Types::TypeDecl::TK_Integer && rd->IsUnsigned()) {
+        return rd;
+    }
+    return 0;
+}
+
 static llvm::Constant *CreateReadFunc(Types::TypeDecl *ty, llvm::Type *fty) {
     std::string               suffix;
     llvm::Type *              lty = llvm::PointerType::getUnqual(ty->LlvmType());
@@ -2057,7 +3031,17 @@ static llvm::Constant *CreateReadFunc(Types::TypeDecl *ty, llvm::Type *fty) {
         break;
 
     case Types::TypeDecl::TK_Integer:
-        suffix = "int";
+        if (UnsignedReadRange(ty)) {
+            // Also pass the largest value.
+            argTypes.push_back(Types::GetIntegerType()->LlvmType());
+            suffix = "uint";
+        } else {
+            suffix = "int";
+        }
+        break;
+
+    case Types::TypeDecl::TK_LongInt:
+        suffix = "int64";
         break;
 
     case Types::TypeDecl::TK_Real:
@@ -2068,7 +3052,13 @@ static llvm::Constant *CreateReadFunc(Types::TypeDecl *ty, llvm::Type *fty) {
         suffix = "str";
         break;
 
+    case Types::TypeDecl::TK_LongString:
+        suffix = "lstr";
+        break;
+
     case Types::TypeDecl::TK_Array:
+        // Also pass the size of the array.
+        argTypes.push_back(Types::GetIntegerType()->LlvmType());
         suffix = "chars";
         break;
 
@@ -2107,6 +3097,11 @@ llvm::Value *ReadAST::CodeGen() {
             v = builder.CreateBitCast(v, Types::GetVoidPtrType());
         }
         argsV.push_back(v);
+        if (isText && ty->Type() == Types::TypeDecl::TK_Array) {
+            argsV.push_back(MakeIntegerConstant(ty->Size()));
+        } else if (Types::RangeDecl *rd = (isText) ? UnsignedReadRange(ty) : 0) {
+            argsV.push_back(MakeIntegerConstant(rd->End()));
+        }
         llvm::Constant *fn;
         if (isText) {
             fn = CreateReadFunc(ty, fTy);
@@ -2201,6 +3196,9 @@ llvm::Value *VarDeclAST::CodeGen() {
             }
         } else {
             v = CreateAlloca(func->Proto()->LlvmFunction(), var);
+            if (IsLongString(var)) {
+                builder.CreateStore(llvm::Constant::getNullValue(ty), v);
+            }
             Types::ClassDecl *cd = llvm::dyn_cast<Types::ClassDecl>(var.Type());
             if (cd && cd->VTableType(true)) {
                 llvm::GlobalVariable *gv =
@@ -2249,6 +3247,13 @@ void LabelExprAST::DoDump(std::ostream &out) const {
         out << l;
         first = false;
     }
+    for (auto l : labelStrings) {
+        if (!first) {
+            out << ", ";
+        }
+        out << "'" << l << "'";
+        first = false;
+    }
     out << ": ";
     stmt->dump(out);
 }
@@ -2273,6 +3278,15 @@ llvm::Value *LabelExprAST::CodeGen(llvm::SwitchInst *sw, llvm::BasicBlock *after
 
     BasicDebugInfo(this);
 
+    llvm::BasicBlock *caseBB = StatementCodeGen(afterBB);
+    for (auto l : labelValues) {
+        llvm::IntegerType *intTy = llvm::dyn_cast<llvm::IntegerType>(ty);
+        sw->addCase(llvm::ConstantInt::get(intTy, l), caseBB);
+    }
+    return caseBB;
+}
+
+llvm::BasicBlock *LabelExprAST::StatementCodeGen(llvm::BasicBlock *afterBB) {
     assert(stmt && "Expected a statement for 'case' label expression");
     llvm::Function *  theFunction = builder.GetInsertBlock()->getParent();
     llvm::BasicBlock *caseBB = llvm::BasicBlock::Create(theContext, "case", theFunction);
@@ -2280,10 +3294,6 @@ llvm::Value *LabelExprAST::CodeGen(llvm::SwitchInst *sw, llvm::BasicBlock *after
     builder.SetInsertPoint(caseBB);
     stmt->CodeGen();
     builder.CreateBr(afterBB);
-    for (auto l : labelValues) {
-        llvm::IntegerType *intTy = llvm::dyn_cast<llvm::IntegerType>(ty);
-        sw->addCase(llvm::ConstantInt::get(intTy, l), caseBB);
-    }
     return caseBB;
 }
 
@@ -2315,6 +3325,114 @@ void CaseExprAST::accept(ASTVisitor &v) {
     if (otherwise) {
         otherwise->accept(v);
     }
+    v.visit(this);
+}
+
+struct StringCaseLabel {
+    std::string       str;
+    llvm::BasicBlock *caseBB;
+};
+
+// Dispatch among labels of the same length: switch on the character position that tells
+// most of the labels apart, until one label is left, and then check the whole string once.
+static void StringCaseTree(llvm::Value *ptr, const std::vector<StringCaseLabel> &group,
+                           llvm::BasicBlock *defaultBB) {
+    llvm::Function *fn = builder.GetInsertBlock()->getParent();
+    size_t          len = group[0].str.size();
+    if (group.size() == 1) {
+        if (len == 0) {
+            builder.CreateBr(group[0].caseBB);
+            return;
+        }
+        llvm::Value *label = builder.CreateGlobalStringPtr(group[0].str, "caselabel");
+        llvm::Value *cmp = CallMemCmp(ptr, label, MakeIntegerConstant(len));
+        llvm::Value *same = builder.CreateICmpEQ(cmp, MakeIntegerConstant(0));
+        builder.CreateCondBr(same, group[0].caseBB, defaultBB);
+        return;
+    }
+
+    size_t best = 0;
+    size_t bestCount = 0;
+    for (size_t pos = 0; pos < len; pos++) {
+        std::set<char> chars;
+        for (auto &l : group) {
+            chars.insert(l.str[pos]);
+        }
+        if (chars.size() > bestCount) {
+            best = pos;
+            bestCount = chars.size();
+        }
+    }
+    assert(bestCount > 1 && "Expected distinct labels");
+
+    std::map<unsigned char, std::vector<StringCaseLabel>> byChar;
+    for (auto &l : group) {
+        byChar[l.str[best]].push_back(l);
+    }
+    llvm::Value *      c = builder.CreateGEP(ptr, MakeIntegerConstant(best), "caseidx");
+    llvm::IntegerType *charTy = llvm::cast<llvm::IntegerType>(Types::GetCharType()->LlvmType());
+    llvm::SwitchInst * sw = builder.CreateSwitch(builder.CreateLoad(c, "casechar"), defaultBB,
+                                                 byChar.size());
+    for (auto &g : byChar) {
+        llvm::BasicBlock *bb = llvm::BasicBlock::Create(theContext, "strcase.char", fn);
+        sw->addCase(llvm::ConstantInt::get(charTy, g.first), bb);
+        builder.SetInsertPoint(bb);
+        StringCaseTree(ptr, g.second, defaultBB);
+    }
+}
+
+// Case on a string: switch on the length, then on characters, and finally compare the
+// whole string with the one label left, so only one string compare is done.
+llvm::Value *CaseExprAST::StringCodeGen() {
+    TRACE();
+
+    llvm::Value *ptr;
+    llvm::Value *len;
+    StringPiece(expr, ptr, len);
+    // Hold on to a long string selector, in case the statements assign to it.
+    bool isLongStr = llvm::isa<Types::LongStringDecl>(expr->Type());
+    if (isLongStr) {
+        LongStrRefCount("IncRef", ptr);
+    }
+
+    llvm::Function *  theFunction = builder.GetInsertBlock()->getParent();
+    llvm::BasicBlock *dispatchBB = builder.GetInsertBlock();
+    llvm::BasicBlock *afterBB = llvm::BasicBlock::Create(theContext, "after", theFunction);
+    llvm::BasicBlock *defaultBB = afterBB;
+    if (otherwise) {
+        defaultBB = llvm::BasicBlock::Create(theContext, "default", theFunction);
+    }
+
+    // Semantics has checked that the labels are all different.
+    std::map<size_t, std::vector<StringCaseLabel>> byLength;
+    for (auto ll : labels) {
+        llvm::BasicBlock *caseBB = ll->StatementCodeGen(afterBB);
+        for (auto &str : ll->LabelStrings()) {
+            byLength[str.size()].push_back({str, caseBB});
+        }
+    }
+
+    builder.SetInsertPoint(dispatchBB);
+    llvm::SwitchInst *sw = builder.CreateSwitch(len, defaultBB, byLength.size());
+    for (auto &g : byLength) {
+        llvm::BasicBlock *bb = llvm::BasicBlock::Create(theContext, "strcase.len", theFunction);
+        sw->addCase(llvm::cast<llvm::ConstantInt>(MakeIntegerConstant(g.first)), bb);
+        builder.SetInsertPoint(bb);
+        StringCaseTree(ptr, g.second, defaultBB);
+    }
+
+    if (otherwise) {
+        builder.SetInsertPoint(defaultBB);
+        otherwise->CodeGen();
+        builder.CreateBr(afterBB);
+    }
+
+    builder.SetInsertPoint(afterBB);
+    if (isLongStr) {
+        LongStrRefCount("DecRef", ptr);
+    }
+
+    return afterBB;
 }
 
 llvm::Value *CaseExprAST::CodeGen() {
@@ -2322,6 +3440,11 @@ llvm::Value *CaseExprAST::CodeGen() {
 
     BasicDebugInfo(this);
 
+    if (llvm::isa<Types::StringDecl>(expr->Type()) ||
+        llvm::isa<Types::LongStringDecl>(expr->Type())) {
+        return StringCodeGen();
+    }
+
     llvm::Value *v = expr->CodeGen();
     llvm::Type * ty = v->getType();
     if (!v->getType()->isIntegerTy()) {
@@ -2370,6 +3493,59 @@ void SetExprAST::DoDump(std::ostream &out) const {
     out << "]";
 }
 
+// Vector with the bit number of the first element in each word: <0, 32, 64, ...>
+static llvm::Value *SetWordStartVector(Types::SetDecl *type) {
+    std::vector<llvm::Constant *> starts;
+    for (size_t i = 0; i < type->SetWords(); i++) {
+        starts.push_back(MakeIntegerConstant(i * Types::SetDecl::SetBits));
+    }
+    return llvm::ConstantVector::get(starts);
+}
+
+// Build the set words for a single (non-constant) element x, relative to the start of the set.
+static llvm::Value *SetElementMask(llvm::Value *x, Types::SetDecl *type) {
+    size_t       words = type->SetWords();
+    llvm::Value *index = builder.CreateLShr(x, MakeIntegerConstant(Types::SetDecl::SetPow2Bits));
+    llvm::Value *offset = builder.CreateAnd(x, MakeIntegerConstant(Types::SetDecl::SetMask));
+    llvm::Value *bit = builder.CreateShl(MakeIntegerConstant(1), offset);
+
+    std::vector<llvm::Constant *> wordIndex;
+    for (size_t i = 0; i < words; i++) {
+        wordIndex.push_back(MakeIntegerConstant(i));
+    }
+    llvm::Value *inWord = builder.CreateICmpEQ(builder.CreateVectorSplat(words, index),
+                                               llvm::ConstantVector::get(wordIndex), "inword");
+    llvm::Value *zero = llvm::Constant::getNullValue(SetVectorType(type));
+    return builder.CreateSelect(inWord, builder.CreateVectorSplat(words, bit), zero, "elemmask");
+}
+
+// Build the set words for the range low..high, relative to the start of the set. Words
+// entirely inside the range are all ones, and the (up to) two edge words are masked.
+// An empty range (low > high) gives an empty set.
+static llvm::Value *SetRangeMask(llvm::Value *low, llvm::Value *high, Types::SetDecl *type) {
+    size_t       words = type->SetWords();
+    llvm::Value *starts = SetWordStartVector(type);
+    llvm::Value *zero = llvm::Constant::getNullValue(SetVectorType(type));
+    llvm::Value *ones = llvm::Constant::getAllOnesValue(SetVectorType(type));
+    llvm::Value *mask =
+        builder.CreateVectorSplat(words, MakeIntegerConstant(Types::SetDecl::SetMask));
+
+    // Bits at or above "low" in each word.
+    llvm::Value *dl = builder.CreateSub(builder.CreateVectorSplat(words, low), starts);
+    llvm::Value *lowBits = builder.CreateShl(ones, builder.CreateAnd(dl, mask));
+    lowBits = builder.CreateSelect(builder.CreateICmpSGT(dl, mask), zero, lowBits);
+    lowBits = builder.CreateSelect(builder.CreateICmpSLT(dl, zero), ones, lowBits, "lowbits");
+
+    // Bits at or below "high" in each word.
+    llvm::Value *dh = builder.CreateSub(builder.CreateVectorSplat(words, high), starts);
+    llvm::Value *highBits =
+        builder.CreateLShr(ones, builder.CreateAnd(builder.CreateSub(mask, dh), mask));
+    highBits = builder.CreateSelect(builder.CreateICmpSLT(dh, zero), zero, highBits);
+    highBits = builder.CreateSelect(builder.CreateICmpSGT(dh, mask), ones, highBits, "highbits");
+
+    return builder.CreateAnd(lowBits, highBits, "rangemask");
+}
+
 llvm::Value *SetExprAST::MakeConstantSet(Types::TypeDecl *type) {
     static int  index = 1;
     llvm::Type *ty = type->LlvmType();
@@ -2377,25 +3553,7 @@ llvm::Value *SetExprAST::MakeConstantSet(Types::TypeDecl *type) {
 
     Types::SetDecl::ElemType elems[Types::SetDecl::MaxSetWords] = {};
     for (auto v : values) {
-        if (RangeExprAST *r = llvm::dyn_cast<RangeExprAST>(v)) {
-            IntegerExprAST *le = llvm::dyn_cast<IntegerExprAST>(r->LowExpr());
-            IntegerExprAST *he = llvm::dyn_cast<IntegerExprAST>(r->HighExpr());
-            int             start = type->GetRange()->Start();
-            int             low = le->Int() - start;
-            int             high = he->Int() - start;
-            low = std::max(0, low);
-            high = std::min((int)type->GetRange()->Size(), high);
-            for (int i = low; i <= high; i++) {
-                elems[i >> Types::SetDecl::SetPow2Bits] |= (1 << (i & Types::SetDecl::SetMask));
-            }
-        } else {
-            IntegerExprAST *e = llvm::dyn_cast<IntegerExprAST>(v);
-            int             start = type->GetRange()->Start();
-            unsigned        i = e->Int() - start;
-            if (i < (unsigned)type->GetRange()->Size()) {
-                elems[i >> Types::SetDecl::SetPow2Bits] |= (1 << (i & Types::SetDecl::SetMask));
-            }
-        }
+        AddConstantSetElement(elems, v, type);
     }
 
     Types::SetDecl * setType = llvm::dyn_cast<Types::SetDecl>(type);
@@ -2430,16 +3588,9 @@ llvm::Value *SetExprAST::Address() {
     // Check if ALL the values involved are constants.
     bool allConstants = true;
     for (auto v : values) {
-        if (RangeExprAST *r = llvm::dyn_cast<RangeExprAST>(v)) {
-            if (!IsConstant(r->HighExpr()) || !IsConstant(r->LowExpr())) {
-                allConstants = false;
-                break;
-            }
-        } else {
-            if (!IsConstant(v)) {
-                allConstants = false;
-                break;
-            }
+        if (!IsConstantSetElement(v)) {
+            allConstants = false;
+            break;
         }
     }
 
@@ -2447,98 +3598,55 @@ llvm::Value *SetExprAST::Address() {
         return MakeConstantSet(type);
     }
 
-    llvm::Value *setV = CreateTempAlloca(type);
-    assert(setV && "Expect CreateTempAlloca() to work");
+    Types::SetDecl *setType = llvm::dyn_cast<Types::SetDecl>(type);
+    size_t          size = setType->SetWords();
 
-    llvm::Value *tmp = builder.CreateBitCast(setV, Types::GetVoidPtrType());
+    // Merge all the constant elements into precomputed words, then OR in the
+    // variable elements and ranges a whole word at a time.
+    Types::SetDecl::ElemType elems[Types::SetDecl::MaxSetWords] = {};
+    for (auto v : values) {
+        if (IsConstantSetElement(v)) {
+            AddConstantSetElement(elems, v, type);
+        }
+    }
 
-    size_t size = llvm::dyn_cast<Types::SetDecl>(type)->SetWords();
-    builder.CreateMemSet(tmp, MakeConstant(0, Types::GetCharType()),
-                         (size * Types::SetDecl::SetBits / 8), 0);
+    std::vector<llvm::Constant *> initWords;
+    for (size_t i = 0; i < size; i++) {
+        initWords.push_back(MakeIntegerConstant(elems[i]));
+    }
+    llvm::Value *set = llvm::ConstantVector::get(initWords);
 
-    // TODO: For optimisation, we may want to pass through the vector and see if the values
-    // are constants, and if so, be clever about it.
-    // Also, we should combine stores to the same word!
+    Types::Range *range = type->GetRange();
+    llvm::Value * rangeStart = MakeIntegerConstant(range->Start());
+    llvm::Type *  intTy = Types::GetIntegerType()->LlvmType();
     for (auto v : values) {
-        // If we have a "range", then make a loop.
+        if (IsConstantSetElement(v)) {
+            continue;
+        }
         if (RangeExprAST *r = llvm::dyn_cast<RangeExprAST>(v)) {
             llvm::Value *low = r->Low();
             llvm::Value *high = r->High();
             assert(high && low && "Expected expressions to evalueate");
 
-            llvm::Function *fn = builder.GetInsertBlock()->getParent();
-
-            llvm::Value *loopVar = CreateTempAlloca(Types::GetIntegerType());
-
-            // Adjust for range:
-            Types::Range *range = type->GetRange();
-
-            low = builder.CreateSExt(low, Types::GetIntegerType()->LlvmType(), "sext.low");
-            high = builder.CreateSExt(high, Types::GetIntegerType()->LlvmType(), "sext.high");
-
-            llvm::Value *rangeStart = MakeIntegerConstant(range->Start());
+            low = builder.CreateSExt(low, intTy, "sext.low");
+            high = builder.CreateSExt(high, intTy, "sext.high");
             low = builder.CreateSub(low, rangeStart);
             high = builder.CreateSub(high, rangeStart);
 
-            builder.CreateStore(low, loopVar);
-
-            llvm::BasicBlock *loopBB = llvm::BasicBlock::Create(theContext, "loop", fn);
-            builder.CreateBr(loopBB);
-            builder.SetInsertPoint(loopBB);
-
-            llvm::Value *loop = builder.CreateLoad(loopVar, "loopVar");
-
-            // Set bit "loop" in set.
-            llvm::Value *mask = MakeIntegerConstant(Types::SetDecl::SetMask);
-            llvm::Value *offset = builder.CreateAnd(loop, mask);
-            llvm::Value *bit = builder.CreateShl(MakeIntegerConstant(1), offset);
-            llvm::Value *index = 0;
-            if (size != 1) {
-                index = builder.CreateLShr(loop, MakeIntegerConstant(Types::SetDecl::SetPow2Bits));
-            } else {
-                index = MakeIntegerConstant(0);
-            }
-            std::vector<llvm::Value *> ind{MakeIntegerConstant(0), index};
-            llvm::Value *              bitsetAddr = builder.CreateGEP(setV, ind, "bitsetaddr");
-            llvm::Value *              bitset = builder.CreateLoad(bitsetAddr, "bitset");
-            bitset = builder.CreateOr(bitset, bit);
-            builder.CreateStore(bitset, bitsetAddr);
-
-            loop = builder.CreateAdd(
-                loop, MakeConstant(1, llvm::dyn_cast<Types::SetDecl>(type)->SubType()), "update");
-            builder.CreateStore(loop, loopVar);
-
-            llvm::Value *endCond = builder.CreateICmpSLE(loop, high, "loopcond");
-
-            llvm::BasicBlock *afterBB = llvm::BasicBlock::Create(theContext, "afterloop", fn);
-            builder.CreateCondBr(endCond, loopBB, afterBB);
-
-            builder.SetInsertPoint(afterBB);
+            set = builder.CreateOr(set, SetRangeMask(low, high, setType));
         } else {
-            Types::Range *range = type->GetRange();
-            llvm::Value * rangeStart = MakeIntegerConstant(range->Start());
-            llvm::Value * x = v->CodeGen();
+            llvm::Value *x = v->CodeGen();
             assert(x && "Expect codegen to work!");
-            x = builder.CreateZExt(x, Types::GetIntegerType()->LlvmType(), "zext");
+            x = builder.CreateZExt(x, intTy, "zext");
             x = builder.CreateSub(x, rangeStart);
 
-            llvm::Value *mask = MakeIntegerConstant(Types::SetDecl::SetMask);
-            llvm::Value *offset = builder.CreateAnd(x, mask);
-            llvm::Value *bit = builder.CreateShl(MakeIntegerConstant(1), offset);
-            llvm::Value *index = 0;
-            if (size != 1) {
-                index = builder.CreateLShr(x, MakeIntegerConstant(Types::SetDecl::SetPow2Bits));
-            } else {
-                index = MakeIntegerConstant(0);
-            }
-            std::vector<llvm::Value *> ind{MakeIntegerConstant(0), index};
-            llvm::Value *              bitsetAddr = builder.CreateGEP(setV, ind, "bitsetaddr");
-            llvm::Value *              bitset = builder.CreateLoad(bitsetAddr, "bitset");
-            bitset = builder.CreateOr(bitset, bit);
-            builder.CreateStore(bitset, bitsetAddr);
+            set = builder.CreateOr(set, SetElementMask(x, setType));
         }
     }
 
+    llvm::Value *setV = CreateTempAlloca(type);
+    assert(setV && "Expect CreateTempAlloca() to work");
+    StoreSetVector(set, setV, setType);
     return setV;
 }
 
@@ -2634,7 +3742,8 @@ llvm::Value *RangeCheckAST::CodeGen() {
         llvm::PointerType::getUnqual(Types::GetCharType()->LlvmType()), intTy, intTy, intTy,
         intTy};
 
-    llvm::Constant *fn = GetFunction(Types::GetVoidPtrType(), argTypes, "range_error");
+    llvm::Constant *fn =
+        GetNoReturnFunction(Types::GetVoidPtrType(), argTypes, "range_error");
 
     builder.CreateCall(fn, args, "");
     builder.CreateUnreachable();
@@ -2718,6 +3827,13 @@ llvm::Value *TypeCastAST::CodeGen() {
     if (llvm::isa<Types::PointerDecl>(type)) {
         return builder.CreateBitCast(expr->CodeGen(), type->LlvmType());
     }
+    if (type->Type() == Types::TypeDecl::TK_LongString) {
+        return MakeLongStringFromExpr(expr);
+    }
+    if (current->Type() == Types::TypeDecl::TK_LongString &&
+        type->Type() == Types::TypeDecl::TK_String) {
+        return builder.CreateLoad(Address(), "str");
+    }
     if (((current->Type() == Types::TypeDecl::TK_Array &&
           current->SubType()->Type() == Types::TypeDecl::TK_Char) ||
          current->Type() == Types::TypeDecl::TK_Char) &&
@@ -2752,6 +3868,16 @@ llvm::Value *TypeCastAST::Address() {
     case Types::TypeDecl::TK_Set:
         v = ConvertSet(expr, type);
         break;
+    case Types::TypeDecl::TK_LongString: {
+        assert(type->Type() == Types::TypeDecl::TK_String && "Expected conversion to string");
+        v = CreateTempAlloca(type);
+        llvm::Value *   dest = builder.CreateBitCast(v, Types::GetVoidPtrType());
+        llvm::Type *    lsTy = current->LlvmType();
+        llvm::Constant *f = GetFunction(Types::GetVoidType(), {Types::GetVoidPtrType(), lsTy},
+                                        "__StrFromLStr");
+        builder.CreateCall(f, {dest, expr->CodeGen()});
+        break;
+    }
     default:
         if (type->Type() == Types::TypeDecl::TK_String) {
             v = MakeStringFromExpr(expr, type);
@@ -34,6 +34,7 @@ class ExprAST : public Visitable<ExprAST> {
         EK_SetExpr,
         EK_VariableExpr,
         EK_ArrayExpr,
+        EK_LongStrIndexExpr,
         EK_PointerExpr,
         EK_FilePointerExpr,
         EK_FieldExpr,
@@ -180,7 +181,8 @@ class SetExprAST : public AddressableAST {
     void         DoDump(std::ostream &out) const override;
     llvm::Value *Address() override;
     llvm::Value *MakeConstantSet(Types::TypeDecl *type);
-    static bool  classof(const ExprAST *e) { return e->getKind() == EK_SetExpr; }
+    const std::vector<ExprAST *> &Values() const { return values; }
+    static bool                   classof(const ExprAST *e) { return e->getKind() == EK_SetExpr; }
 
   private:
     std::vector<ExprAST *> values;
@@ -224,6 +226,27 @@ class ArrayExprAST : public VariableExprAST {
     std::vector<size_t>             indexmul;
 };
 
+// Character in a long string. Taking the address makes the string unique (copy on write),
+// reading the value does not.
+class LongStrIndexExprAST : public VariableExprAST {
+  public:
+    LongStrIndexExprAST(const Location &w, VariableExprAST *v, ExprAST *idx)
+        : VariableExprAST(w, EK_LongStrIndexExpr, v, Types::GetCharType()), expr(v),
+          index(idx) {}
+    void         DoDump(std::ostream &out) const override;
+    llvm::Value *CodeGen() override;
+    llvm::Value *Address() override;
+    static bool  classof(const ExprAST *e) { return e->getKind() == EK_LongStrIndexExpr; }
+    void         accept(ASTVisitor &v) override;
+
+  private:
+    llvm::Value *CharAddress(llvm::Value *str);
+
+  private:
+    VariableExprAST *expr;
+    ExprAST *        index;
+};
+
 class PointerExprAST : public VariableExprAST {
   public:
     PointerExprAST(const Location &w, VariableExprAST *p, Types::TypeDecl *ty)
@@ -279,6 +302,7 @@ class VariantFieldExprAST : public VariableExprAST {
 
 class BinaryExprAST : public ExprAST {
     friend class TypeCheckVisitor;
+    friend class AssignExprAST;
 
   public:
     BinaryExprAST(Token op, ExprAST *l, ExprAST *r)
@@ -288,6 +312,8 @@ class BinaryExprAST : public ExprAST {
     static bool      classof(const ExprAST *e) { return e->getKind() == EK_BinaryExpr; }
     Types::TypeDecl *Type() const override;
     void             UpdateType(Types::TypeDecl *ty);
+    // Collect the operands of a chain of string concatenations, false if not a concatenation.
+    bool StringConcatPieces(std::vector<ExprAST *> &pieces);
     void             accept(ASTVisitor &v) override {
         rhs->accept(v);
         lhs->accept(v);
@@ -298,7 +324,6 @@ class BinaryExprAST : public ExprAST {
     llvm::Value *SetCodeGen();
     llvm::Value *InlineSetFunc(const std::string &name, bool resTyIsSet);
     llvm::Value *CallSetFunc(const std::string &name, bool resTyIsSet);
-    llvm::Value *CallStrFunc(const std::string &name);
     llvm::Value *CallArrFunc(const std::string &name, size_t size);
 
   private:
@@ -368,6 +393,7 @@ class BlockAST : public ExprAST {
 
 class AssignExprAST : public ExprAST {
     friend class TypeCheckVisitor;
+    friend class ArgUsageVisitor;
 
   public:
     AssignExprAST(const Location &w, ExprAST *l, ExprAST *r)
@@ -383,6 +409,7 @@ class AssignExprAST : public ExprAST {
 
   private:
     llvm::Value *AssignStr();
+    llvm::Value *AssignLongStr();
     llvm::Value *AssignSet();
     ExprAST *    lhs;
     ExprAST *    rhs;
@@ -408,6 +435,7 @@ class VarDeclAST : public ExprAST {
 
 class PrototypeAST : public ExprAST {
     friend class TypeCheckVisitor;
+    friend class ArgUsageVisitor;
 
   public:
     PrototypeAST(const Location &w, const std::string &nm, const std::vector<VarDef> &ar,
@@ -424,6 +452,10 @@ class PrototypeAST : public ExprAST {
     const std::vector<VarDef> &Args() const { return args; }
     bool                       IsForward() const { return isForward; }
     bool                       HasSelf() const { return hasSelf; }
+    // Result is returned in memory provided by the caller.
+    bool IsSRet() const {
+        return Type()->IsCompound() && !llvm::isa<Types::FuncPtrDecl>(Type());
+    }
     void                       SetIsForward(bool v);
     void                       SetHasSelf(bool v) { hasSelf = v; }
     void                       SetFunction(FunctionAST *fun) { function = fun; }
@@ -446,6 +478,8 @@ class PrototypeAST : public ExprAST {
 };
 
 class FunctionAST : public ExprAST {
+    friend class ArgUsageVisitor;
+
   public:
     FunctionAST(const Location &w, PrototypeAST *prot, const std::vector<VarDeclAST *> &v,
                 BlockAST *b);
@@ -466,6 +500,9 @@ class FunctionAST : public ExprAST {
     void                    accept(ASTVisitor &v) override;
     void                    EndLoc(Location loc) { endLoc = loc; }
 
+  private:
+    void ReleaseLongStrings();
+
   private:
     PrototypeAST *             proto;
     std::vector<VarDeclAST *>  varDecls;
@@ -501,6 +538,8 @@ class CallExprAST : public ExprAST {
     }
     void                    DoDump(std::ostream &out) const override;
     llvm::Value *           CodeGen() override;
+    llvm::Value *           CodeGenInto(llvm::Value *dest);
+    bool                    CanReturnInto(VariableExprAST *dest);
     static bool             classof(const ExprAST *e) { return e->getKind() == EK_CallExpr; }
     const PrototypeAST *    Proto() { return proto; }
     ExprAST *               Callee() const { return callee; }
@@ -516,6 +555,7 @@ class CallExprAST : public ExprAST {
 // Builtin function call
 class BuiltinExprAST : public ExprAST {
     friend class TypeCheckVisitor;
+    friend class ArgUsageVisitor;
 
   public:
     BuiltinExprAST(const Location &w, Builtin::BuiltinFunctionBase *b)
@@ -547,19 +587,26 @@ class IfExprAST : public ExprAST {
 class ForExprAST : public ExprAST {
   public:
     friend class TypeCheckVisitor;
+    friend class ArgUsageVisitor;
     ForExprAST(const Location &w, VariableExprAST *v, ExprAST *s, ExprAST *e, bool down,
                ExprAST *b)
         : ExprAST(w, EK_ForExpr), variable(v), start(s), stepDown(down), end(e), body(b) {}
+    // "for v in set do ..."
+    ForExprAST(const Location &w, VariableExprAST *v, ExprAST *s, ExprAST *b)
+        : ExprAST(w, EK_ForExpr), variable(v), start(s), stepDown(false), end(0), body(b) {}
     void         DoDump(std::ostream &out) const override;
     llvm::Value *CodeGen() override;
     static bool  classof(const ExprAST *e) { return e->getKind() == EK_ForExpr; }
     void         accept(ASTVisitor &v) override;
 
+  private:
+    llvm::Value *ForInGen();
+
   private:
     VariableExprAST *variable;
     ExprAST *        start;
     bool             stepDown; // true for "downto"
-    ExprAST *        end;
+    ExprAST *        end;      // Null for "for v in set"
     ExprAST *        body;
 };
 
@@ -596,6 +643,7 @@ class RepeatExprAST : public ExprAST {
 
 class WriteAST : public ExprAST {
     friend class TypeCheckVisitor;
+    friend class ArgUsageVisitor;
 
   public:
     struct WriteArg {
@@ -606,20 +654,28 @@ class WriteAST : public ExprAST {
     };
 
     WriteAST(const Location &w, VariableExprAST *f, const std::vector<WriteArg> &a, bool isLn)
-        : ExprAST(w, EK_Write), file(f), args(a), isWriteln(isLn) {}
+        : ExprAST(w, EK_Write), file(f), args(a), isWriteln(isLn), isWriteStr(false) {}
+    // WriteStr/Str: format the arguments into the string variable dest.
+    WriteAST(const Location &w, const std::vector<WriteArg> &a, VariableExprAST *dest)
+        : ExprAST(w, EK_Write), file(dest), args(a), isWriteln(false), isWriteStr(true) {}
     void         DoDump(std::ostream &out) const override;
     llvm::Value *CodeGen() override;
     static bool  classof(const ExprAST *e) { return e->getKind() == EK_Write; }
     void         accept(ASTVisitor &v) override;
 
+  private:
+    llvm::Value *TextArgs();
+
   private:
     VariableExprAST *     file;
     std::vector<WriteArg> args;
     bool                  isWriteln;
+    bool                  isWriteStr;
 };
 
 class ReadAST : public ExprAST {
     friend class TypeCheckVisitor;
+    friend class ArgUsageVisitor;
 
   public:
     ReadAST(const Location &w, VariableExprAST *fi, const std::vector<ExprAST *> &a, bool isLn)
@@ -639,18 +695,26 @@ class LabelExprAST : public ExprAST {
   public:
     LabelExprAST(const Location &w, const std::vector<int> &lab, ExprAST *st)
         : ExprAST(w, EK_LabelExpr), labelValues(lab), stmt(st) {}
-    void         DoDump(std::ostream &out) const override;
-    llvm::Value *CodeGen() override;
-    llvm::Value *CodeGen(llvm::SwitchInst *inst, llvm::BasicBlock *afterBB, llvm::Type *ty);
-    static bool  classof(const ExprAST *e) { return e->getKind() == EK_LabelExpr; }
-    void         accept(ASTVisitor &v) override;
+    LabelExprAST(const Location &w, const std::vector<int> &lab,
+                 const std::vector<std::string> &strLab, ExprAST *st)
+        : ExprAST(w, EK_LabelExpr), labelValues(lab), labelStrings(strLab), stmt(st) {}
+    void              DoDump(std::ostream &out) const override;
+    llvm::Value *     CodeGen() override;
+    llvm::Value *     CodeGen(llvm::SwitchInst *inst, llvm::BasicBlock *afterBB, llvm::Type *ty);
+    llvm::BasicBlock *StatementCodeGen(llvm::BasicBlock *afterBB);
+    static bool       classof(const ExprAST *e) { return e->getKind() == EK_LabelExpr; }
+    void              accept(ASTVisitor &v) override;
+    const std::vector<std::string> &LabelStrings() const { return labelStrings; }
 
   private:
-    std::vector<int> labelValues;
-    ExprAST *        stmt;
+    std::vector<int>         labelValues;
+    std::vector<std::string> labelStrings;
+    ExprAST *                stmt;
 };
 
 class CaseExprAST : public ExprAST {
+    friend class TypeCheckVisitor;
+
   public:
     CaseExprAST(const Location &w, ExprAST *e, const std::vector<LabelExprAST *> &lab,
                 ExprAST *other)
@@ -660,6 +724,9 @@ class CaseExprAST : public ExprAST {
     static bool  classof(const ExprAST *e) { return e->getKind() == EK_CaseExpr; }
     void         accept(ASTVisitor &v) override;
 
+  private:
+    llvm::Value *StringCodeGen();
+
   private:
     ExprAST *                   expr;
     std::vector<LabelExprAST *> labels;
@@ -824,10 +891,16 @@ llvm::Constant *MakeBooleanConstant(int val);
 llvm::Constant *MakeConstant(uint64_t val, Types::TypeDecl *ty);
 llvm::Value *   MakeAddressable(ExprAST *e);
 llvm::Value *   MakeStringFromExpr(ExprAST *e, Types::TypeDecl *ty);
+void            StringPiece(ExprAST *e, llvm::Value *&ptr, llvm::Value *&len);
+void            ReleaseStringPiece(ExprAST *e, llvm::Value *ptr);
 void            BackPatch();
 llvm::Constant *GetFunction(llvm::Type *resTy, const std::vector<llvm::Type *> &args,
                             const std::string &name);
 llvm::Constant *GetFunction(Types::TypeDecl *res, const std::vector<llvm::Type *> &args,
                             const std::string &name);
+llvm::Constant *GetNoReturnFunction(llvm::Type *resTy, const std::vector<llvm::Type *> &args,
+                                    const std::string &name);
 std::string     ShortName(const std::string &name);
 ExprAST *       Recast(ExprAST *a, const Types::TypeDecl *ty);
+
+llvm::AllocaInst *CreateTempAlloca(Types::TypeDecl *ty);
@@ -23,6 +23,7 @@
 #include <llvm/Support/CommandLine.h>
 #include <llvm/Support/TargetSelect.h>
 #include <llvm/Transforms/IPO.h>
+#include <llvm/Transforms/IPO/FunctionAttrs.h>
 #include <llvm/Transforms/Scalar.h>
 #include <llvm/Transforms/Scalar/GVN.h>
 #pragma clang diagnostic pop
@@ -97,6 +98,8 @@ void OptimizerInit() {
     if (OptimizationLevel > O0) {
         // Promote allocas to registers.
         mpm->add(llvm::createPromoteMemoryToRegisterPass());
+        // Infer readnone/readonly functions and nocapture arguments.
+        mpm->add(llvm::createPostOrderFunctionAttrsLegacyPass());
         // Provide basic AliasAnalysis support for GVN.
         //	mpm->add(llvm::createBasicAliasAnalysisPass());
         // Do simple "peephole" optimizations and bit-twiddling optzns.
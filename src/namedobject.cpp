@@ -7,6 +7,12 @@ void NamedObject::dump(std::ostream &out) const {
     std::cerr << std::endl;
 }
 
+// Compound "const" arguments are passed by reference, simple types by value.
+void VarDef::SetConst() {
+    isConst = true;
+    isConstRef = Type()->IsCompound();
+}
+
 void ConstDef::dump(std::ostream &out) const {
     out << "Const: " << Name() << " Value: " << constVal->Translate().ToString() << std::endl;
 }
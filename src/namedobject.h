@@ -38,14 +38,21 @@ class NamedObject {
 class VarDef : public NamedObject {
   public:
     VarDef(const std::string &nm, Types::TypeDecl *ty, bool ref = false, bool external = false)
-        : NamedObject(NK_Var, nm, ty), isRef(ref), isExt(external) {}
+        : NamedObject(NK_Var, nm, ty), isRef(ref), isExt(external), isConst(false),
+          isConstRef(false) {}
     bool        IsRef() const { return isRef; }
     bool        IsExternal() const { return isExt; }
+    bool        IsConst() const { return isConst; }
+    bool        IsConstRef() const { return isConstRef; }
+    void        SetConst();
+    void        SetConstRef() { isConstRef = true; }
     static bool classof(const NamedObject *e) { return e->getKind() == NK_Var; }
 
   private:
-    bool isRef; /* "var" arguments are "references" */
-    bool isExt; /* global variable defined outside this module */
+    bool isRef;      /* "var" arguments are "references" */
+    bool isExt;      /* global variable defined outside this module */
+    bool isConst;    /* "const" arguments can't be modified */
+    bool isConstRef; /* value argument passed as a read-only reference */
 };
 
 inline bool operator<(const VarDef &lhs, const VarDef &rhs) {
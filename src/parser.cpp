@@ -1221,6 +1221,15 @@ ExprAST *Parser::ParseBinOpRHS(int exprPrec, ExprAST *lhs) {
 
         NextToken();
 
+        // Also accept "and then" and "or else" for ISO 10206 "and_then" and "or_else".
+        if (binOp.GetToken() == Token::And && CurrentToken().GetToken() == Token::Then) {
+            binOp = Token(Token::AndThen, binOp.Loc());
+            NextToken();
+        } else if (binOp.GetToken() == Token::Or && CurrentToken().GetToken() == Token::Else) {
+            binOp = Token(Token::OrElse, binOp.Loc());
+            NextToken();
+        }
+
         ExprAST *rhs = ParseExprElement();
         if (!rhs) {
             return 0;
@@ -1283,6 +1292,19 @@ class CCExpressions : public Parser::CommaConsumer {
 VariableExprAST *Parser::ParseArrayExpr(VariableExprAST *expr, Types::TypeDecl *&type) {
     TRACE();
 
+    if (llvm::isa<Types::LongStringDecl>(type)) {
+        AssertToken(Token::LeftSquare);
+        ExprAST *index = ParseExpression();
+        if (!index || !Expect(Token::RightSquare, true)) {
+            return 0;
+        }
+        if (index->Type()->Type() != Types::TypeDecl::TK_Integer) {
+            return ErrorV(CurrentToken(), "Expected integer index for string");
+        }
+        type = Types::GetCharType();
+        return new LongStrIndexExprAST(CurrentToken().Loc(), expr, index);
+    }
+
     Types::ArrayDecl *adecl = llvm::dyn_cast<Types::ArrayDecl>(type);
     if (!adecl) {
         return ErrorV(CurrentToken(), "Expected variable of array type when using index");
@@ -1683,6 +1705,13 @@ ExprAST *Parser::ParseIdentifierExpr(Token token) {
     if (const EnumDef *enumDef = llvm::dyn_cast_or_null<EnumDef>(def)) {
         return new IntegerExprAST(token.Loc(), enumDef->Value(), enumDef->Type());
     }
+    if (!def) {
+        std::string name = idName;
+        strlower(name);
+        if (name == "writestr" || name == "str") {
+            return ParseWriteStr(token);
+        }
+    }
     bool isBuiltin = Builtin::IsBuiltin(idName);
     if (!def && !isBuiltin) {
         return Error(CurrentToken(), "Undefined name '" + idName + "'");
@@ -1865,6 +1894,7 @@ PrototypeAST *Parser::ParsePrototype(bool unnamed) {
     if (AcceptToken(Token::LeftParen)) {
         std::vector<std::string> names;
         bool                     isRef = false;
+        bool                     isConst = false;
 
         while (!AcceptToken(Token::RightParen)) {
             if (CurrentToken().GetToken() == Token::Function ||
@@ -1883,6 +1913,8 @@ PrototypeAST *Parser::ParsePrototype(bool unnamed) {
             } else {
                 if (AcceptToken(Token::Var)) {
                     isRef = true;
+                } else if (AcceptToken(Token::Const)) {
+                    isConst = true;
                 }
                 if (!Expect(Token::Identifier, false)) {
                     return 0;
@@ -1895,9 +1927,13 @@ PrototypeAST *Parser::ParsePrototype(bool unnamed) {
                     if (Types::TypeDecl *type = ParseType("", false)) {
                         for (auto n : names) {
                             VarDef v(n, type, isRef);
+                            if (isConst) {
+                                v.SetConst();
+                            }
                             args.push_back(v);
                         }
                         isRef = false;
+                        isConst = false;
                         names.clear();
                         if (CurrentToken().GetToken() != Token::RightParen &&
                             !Expect(Token::Semicolon, true)) {
@@ -2158,6 +2194,35 @@ ExprAST *Parser::ParseIfExpr() {
     return new IfExprAST(loc, cond, then, elseExpr);
 }
 
+// for v in set do ... or for v in type do ...
+ExprAST *Parser::ParseForInExpr(const Location &loc, VariableExprAST *varExpr) {
+    ExprAST *start = 0;
+    if (CurrentToken().GetToken() == Token::Identifier) {
+        Types::TypeDecl *ty = GetTypeDecl(CurrentToken().GetIdentName());
+        if (ty && (llvm::isa<Types::RangeDecl>(ty) || llvm::isa<Types::EnumDecl>(ty) ||
+                   ty->Type() == Types::TypeDecl::TK_Char)) {
+            Location      tyLoc = CurrentToken().Loc();
+            Types::Range *r = ty->GetRange();
+            AssertToken(Token::Identifier);
+            ExprAST *end = new IntegerExprAST(tyLoc, r->End(), ty);
+            start = new IntegerExprAST(tyLoc, r->Start(), ty);
+            if (Expect(Token::Do, true)) {
+                if (ExprAST *body = ParseStatement()) {
+                    return new ForExprAST(loc, varExpr, start, end, false, body);
+                }
+            }
+            return 0;
+        }
+    }
+    start = ParseExpression();
+    if (start && Expect(Token::Do, true)) {
+        if (ExprAST *body = ParseStatement()) {
+            return new ForExprAST(loc, varExpr, start, body);
+        }
+    }
+    return 0;
+}
+
 ExprAST *Parser::ParseForExpr() {
     Location loc = CurrentToken().Loc();
     AssertToken(Token::For);
@@ -2171,6 +2236,9 @@ ExprAST *Parser::ParseForExpr() {
         return Error(CurrentToken(), "Loop variable not found");
     }
     VariableExprAST *varExpr = new VariableExprAST(CurrentToken().Loc(), varName, def->Type());
+    if (AcceptToken(Token::In)) {
+        return ParseForInExpr(loc, varExpr);
+    }
     if (Expect(Token::Assign, true)) {
         if (ExprAST *start = ParseExpression()) {
             bool             down = false;
@@ -2238,15 +2306,19 @@ ExprAST *Parser::ParseCaseExpr() {
     }
     std::vector<LabelExprAST *> labels;
     std::vector<int>            lab;
+    std::vector<std::string>    strLab;
     bool                        isFirst = true;
     Token::TokenType            prevTT;
     ExprAST *                   otherwise = 0;
+    // Case on a string: labels are string constants (single chars are one char strings).
+    bool strSelector = llvm::isa<Types::StringDecl>(expr->Type()) ||
+                       llvm::isa<Types::LongStringDecl>(expr->Type());
     do {
         bool isOtherwise = false;
         if (isFirst) {
             prevTT = CurrentToken().GetToken();
             isFirst = false;
-        } else if (CurrentToken().GetToken() != Token::Otherwise &&
+        } else if (!strSelector && CurrentToken().GetToken() != Token::Otherwise &&
                    CurrentToken().GetToken() != Token::Else &&
                    prevTT != CurrentToken().GetToken()) {
             return Error(CurrentToken(), "Type of case labels must not change type");
@@ -2254,11 +2326,31 @@ ExprAST *Parser::ParseCaseExpr() {
         Token token = TranslateToken(CurrentToken());
         switch (token.GetToken()) {
         case Token::Char:
+            if (strSelector) {
+                strLab.push_back(std::string(1, static_cast<char>(token.GetIntVal())));
+            } else {
+                lab.push_back(token.GetIntVal());
+            }
+            break;
+
         case Token::Integer:
+            if (strSelector) {
+                return Error(CurrentToken(), "Expected string constant as case label");
+            }
             lab.push_back(token.GetIntVal());
             break;
 
+        case Token::StringLiteral:
+            if (!strSelector) {
+                return Error(CurrentToken(), "String case label requires a string selector");
+            }
+            strLab.push_back(token.GetStrVal());
+            break;
+
         case Token::Identifier:
+            if (strSelector) {
+                return Error(CurrentToken(), "Expected string constant as case label");
+            }
             if (const EnumDef *ed = GetEnumValue(token.GetIdentName())) {
                 lab.push_back(ed->Value());
                 break;
@@ -2292,14 +2384,15 @@ ExprAST *Parser::ParseCaseExpr() {
             ExprAST *s = ParseStatement();
             if (isOtherwise) {
                 otherwise = s;
-                if (lab.size()) {
+                if (lab.size() || strLab.size()) {
                     return Error(CurrentToken(),
                                  "Can't have multiple case labels with 'otherwise' "
                                  "or 'else' case label");
                 }
             } else {
-                labels.push_back(new LabelExprAST(locColon, lab, s));
+                labels.push_back(new LabelExprAST(locColon, lab, strLab, s));
                 lab.clear();
+                strLab.clear();
             }
             if (!ExpectSemicolonOrEnd()) {
                 return 0;
@@ -2414,11 +2507,11 @@ ExprAST *Parser::ParseWithBlock() {
 
 class CCWrite : public Parser::CommaConsumer {
   public:
-    CCWrite() : file(0){};
+    CCWrite(bool allowFile = true) : file(0), allowFile(allowFile){};
     bool Consume(Parser &parser) override {
         WriteAST::WriteArg wa;
         if ((wa.expr = parser.ParseExpression())) {
-            if (args.size() == 0) {
+            if (allowFile && args.size() == 0) {
                 if (VariableExprAST *vexpr = llvm::dyn_cast<VariableExprAST>(wa.expr)) {
                     if (llvm::isa<Types::FileDecl>(vexpr->Type())) {
                         file = vexpr;
@@ -2455,6 +2548,7 @@ class CCWrite : public Parser::CommaConsumer {
   private:
     std::vector<WriteAST::WriteArg> args;
     VariableExprAST *               file;
+    bool                            allowFile;
 };
 
 ExprAST *Parser::ParseWrite() {
@@ -2487,6 +2581,37 @@ ExprAST *Parser::ParseWrite() {
     return new WriteAST(loc, file, args, isWriteln);
 }
 
+// WriteStr(dest, args...) and Str(x:w:d, dest): like write, but into the string dest.
+ExprAST *Parser::ParseWriteStr(const Token &token) {
+    std::string name = token.GetIdentName();
+    strlower(name);
+    bool isStr = name == "str";
+
+    Location loc = CurrentToken().Loc();
+    CCWrite  ccw(false);
+    if (!Expect(Token::LeftParen, true) || !ParseCommaList(ccw, Token::RightParen, false)) {
+        return 0;
+    }
+    std::vector<WriteAST::WriteArg> args = ccw.Args();
+    if (args.empty() || (isStr && args.size() != 2)) {
+        return Error(CurrentToken(), "Wrong number of arguments for " + token.GetIdentName());
+    }
+
+    WriteAST::WriteArg dest;
+    if (isStr) {
+        dest = args.back();
+        args.pop_back();
+    } else {
+        dest = args.front();
+        args.erase(args.begin());
+    }
+    VariableExprAST *destVar = llvm::dyn_cast<VariableExprAST>(dest.expr);
+    if (!destVar || dest.width || dest.precision) {
+        return Error(CurrentToken(), "Destination must be a string variable");
+    }
+    return new WriteAST(loc, args, destVar);
+}
+
 class CCRead : public Parser::CommaConsumer {
   public:
     CCRead() : file(0) {}
@@ -2829,6 +2954,7 @@ Parser::Parser(Source &source) : lexer(source), nextTokenValid(false), errCnt(0)
           AddType("longint", Types::GetLongIntType()) &&
           AddType("int64", Types::GetLongIntType()) && AddType("real", Types::GetRealType()) &&
           AddType("char", Types::GetCharType()) && AddType("text", Types::GetTextType()) &&
+          AddType("ansistring", Types::GetLongStringType()) &&
           AddType("boolean", Types::GetBooleanType()) &&
           nameStack.Add("false", new EnumDef("false", 0, Types::GetBooleanType())) &&
           nameStack.Add("true", new EnumDef("true", 1, Types::GetBooleanType())) &&
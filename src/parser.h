@@ -55,6 +55,7 @@ class Parser {
     ExprAST *ParseRepeat();
     ExprAST *ParseIfExpr();
     ExprAST *ParseForExpr();
+    ExprAST *ParseForInExpr(const Location &loc, VariableExprAST *varExpr);
     ExprAST *ParseWhile();
     ExprAST *ParseCaseExpr();
     ExprAST *ParseWithBlock();
@@ -62,6 +63,7 @@ class Parser {
 
     // I/O functions
     ExprAST *ParseWrite();
+    ExprAST *ParseWriteStr(const Token &token);
     ExprAST *ParseRead();
 
     // Statements, blocks and calls
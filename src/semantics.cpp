@@ -4,6 +4,8 @@
 #include "token.h"
 #include "trace.h"
 #include "visitor.h"
+#include <map>
+#include <set>
 
 class TypeCheckVisitor : public ASTVisitor {
   public:
@@ -22,6 +24,10 @@ class TypeCheckVisitor : public ASTVisitor {
     void             CheckForExpr(ForExprAST *f);
     void             CheckReadExpr(ReadAST *f);
     void             CheckWriteExpr(WriteAST *f);
+    void             CheckCaseExpr(CaseExprAST *c);
+    void             CheckVarDecl(VarDeclAST *v);
+    void             CheckFunction(FunctionAST *f);
+    void             CheckLongStringVar(const ExprAST *e, const VarDef &v);
     void             Error(const ExprAST *e, const std::string &msg) const;
 
   private:
@@ -118,6 +124,12 @@ void TypeCheckVisitor::visit(ExprAST *expr) {
         CheckReadExpr(r);
     } else if (WriteAST *w = llvm::dyn_cast<WriteAST>(expr)) {
         CheckWriteExpr(w);
+    } else if (CaseExprAST *c = llvm::dyn_cast<CaseExprAST>(expr)) {
+        CheckCaseExpr(c);
+    } else if (VarDeclAST *v = llvm::dyn_cast<VarDeclAST>(expr)) {
+        CheckVarDecl(v);
+    } else if (FunctionAST *f = llvm::dyn_cast<FunctionAST>(expr)) {
+        CheckFunction(f);
     }
 }
 
@@ -220,6 +232,27 @@ void TypeCheckVisitor::CheckBinExpr(BinaryExprAST *b) {
         ty = Types::GetBooleanType();
     }
 
+    if (op == Token::AndThen || op == Token::OrElse) {
+        if (lty->Type() != Types::TypeDecl::TK_Boolean ||
+            rty->Type() != Types::TypeDecl::TK_Boolean) {
+            Error(b, "Operands of '" + b->oper.TypeStr() + "' should be boolean.");
+        }
+        ty = Types::GetBooleanType();
+    }
+
+    // If either side is a long string, the operation is done on long strings.
+    if (!ty && (llvm::isa<Types::LongStringDecl>(lty) || llvm::isa<Types::LongStringDecl>(rty))) {
+        Types::TypeDecl *lstr = Types::GetLongStringType();
+        if (!lstr->CompatibleType(lty) || !lstr->CompatibleType(rty)) {
+            Error(b, "Incompatible type in string expression");
+        } else if (!b->oper.IsCompare() && op != Token::Plus) {
+            Error(b, "Invalid operator for strings");
+        }
+        b->lhs = Recast(b->lhs, lstr);
+        b->rhs = Recast(b->rhs, lstr);
+        ty = (b->oper.IsCompare()) ? Types::GetBooleanType() : lstr;
+    }
+
     if (!ty && b->oper.IsCompare() &&
         (lty->Type() == Types::TypeDecl::TK_String || rty->Type() == Types::TypeDecl::TK_String)) {
         ty = Types::GetStringType();
@@ -406,6 +439,10 @@ void TypeCheckVisitor::CheckCallExpr(CallExprAST *c) {
         bool bad = true;
 
         if (const Types::TypeDecl *ty = parg[idx].Type()->CompatibleType(a->Type())) {
+            // Strings are converted to the type of the argument.
+            if (llvm::isa<Types::LongStringDecl>(ty)) {
+                ty = parg[idx].Type();
+            }
             a = Recast(a, ty);
             bad = false;
         } else if (llvm::isa<Types::PointerDecl>(parg[idx].Type()) && llvm::isa<NilExprAST>(a)) {
@@ -447,6 +484,29 @@ void TypeCheckVisitor::CheckForExpr(ForExprAST *f) {
         return;
     }
 
+    // for v in set do ...
+    if (!f->end) {
+        Types::SetDecl *sd = llvm::dyn_cast<Types::SetDecl>(f->start->Type());
+        if (!sd) {
+            Error(f->start, "Expected set in 'for in' loop");
+            return;
+        }
+        // Empty set always has the "right" type
+        if (SetExprAST *s = llvm::dyn_cast<SetExprAST>(f->start)) {
+            if (s->values.empty()) {
+                sd->UpdateSubtype(vty);
+            }
+        }
+        assert(sd->SubType() && "Should have a subtype");
+        if (!sd->SubType()->CompatibleType(vty)) {
+            Error(f, "Loop variable type does not match constituent parts of set");
+        }
+        if (!sd->GetRange()) {
+            sd->UpdateRange(GetRangeDecl(vty));
+        }
+        return;
+    }
+
     if (const Types::TypeDecl *ty = f->start->Type()->CompatibleType(vty)) {
         f->start = Recast(f->start, ty);
     } else {
@@ -502,6 +562,14 @@ void TypeCheckVisitor::CheckReadExpr(ReadAST *r) {
 void TypeCheckVisitor::CheckWriteExpr(WriteAST *w) {
     bool isText = llvm::isa<Types::TextDecl>(w->file->Type());
 
+    if (w->isWriteStr) {
+        if (!llvm::isa<Types::StringDecl>(w->file->Type()) &&
+            !llvm::isa<Types::LongStringDecl>(w->file->Type())) {
+            Error(w->file, "Destination of WriteStr or Str must be a string variable");
+        }
+        isText = true;
+    }
+
     if (isText) {
         for (auto arg : w->args) {
             ExprAST *e = arg.expr;
@@ -533,6 +601,346 @@ void TypeCheckVisitor::CheckWriteExpr(WriteAST *w) {
     }
 }
 
+void TypeCheckVisitor::CheckCaseExpr(CaseExprAST *c) {
+    std::set<std::string> seen;
+    for (auto ll : c->labels) {
+        for (auto &str : ll->LabelStrings()) {
+            if (!seen.insert(str).second) {
+                Error(ll, "Duplicate case label '" + str + "'");
+            }
+        }
+    }
+}
+
+/* AnsiStrings are only set to nil, released and reference counted as whole variables and
+ * arguments, so they can't be stored inside anything else.
+ */
+static bool HasLongString(Types::TypeDecl *ty, std::set<Types::TypeDecl *> &seen) {
+    if (!ty || !seen.insert(ty).second) {
+        return false;
+    }
+    if (llvm::isa<Types::LongStringDecl>(ty)) {
+        return true;
+    }
+    if (Types::FieldCollection *fc = llvm::dyn_cast<Types::FieldCollection>(ty)) {
+        for (int i = 0; i < fc->FieldCount(); i++) {
+            if (HasLongString(fc->GetElement(i)->SubType(), seen)) {
+                return true;
+            }
+        }
+        if (Types::RecordDecl *r = llvm::dyn_cast<Types::RecordDecl>(ty)) {
+            return HasLongString(r->Variant(), seen);
+        }
+        if (Types::ClassDecl *c = llvm::dyn_cast<Types::ClassDecl>(ty)) {
+            return HasLongString(c->Variant(), seen);
+        }
+        return false;
+    }
+    if (llvm::isa<Types::ArrayDecl>(ty) || llvm::isa<Types::PointerDecl>(ty) ||
+        llvm::isa<Types::FileDecl>(ty)) {
+        return HasLongString(ty->SubType(), seen);
+    }
+    return false;
+}
+
+void TypeCheckVisitor::CheckLongStringVar(const ExprAST *e, const VarDef &v) {
+    Types::TypeDecl *ty = v.Type();
+    if (llvm::isa<Types::LongStringDecl>(ty)) {
+        return;
+    }
+    std::set<Types::TypeDecl *> seen;
+    if (HasLongString(ty, seen)) {
+        Error(e, "AnsiString can't be inside a record, class, array, file or pointer, in '" +
+                     v.Name() + "'");
+    }
+}
+
+void TypeCheckVisitor::CheckVarDecl(VarDeclAST *v) {
+    for (auto var : v->Vars()) {
+        CheckLongStringVar(v, var);
+    }
+}
+
+void TypeCheckVisitor::CheckFunction(FunctionAST *f) {
+    PrototypeAST *proto = f->Proto();
+    for (auto arg : proto->Args()) {
+        CheckLongStringVar(f, arg);
+    }
+    CheckLongStringVar(f, VarDef(proto->Name(), proto->Type()));
+}
+
+/* Collect what variables each function writes and what functions it calls. This is used to
+ * report modification of "const" arguments, and to pass compound value arguments by
+ * reference when the function can't modify the argument, nor anything the argument may share
+ * memory with (for the whole call, including the functions it calls).
+ */
+class ArgUsageVisitor : public ASTVisitor {
+  public:
+    ArgUsageVisitor(Semantics *s) : sema(s), current(0) {}
+    void visit(ExprAST *expr) override;
+    void CheckConstArgs();
+    void FindConstRefArgs();
+
+  private:
+    struct Write {
+        const ExprAST *where;
+        std::string    name; // Empty if not known to be a plain variable.
+    };
+
+    struct FunctionInfo {
+        FunctionInfo() : unknownCalls(false) {}
+        std::vector<Write>      writes;
+        std::set<FunctionAST *> calls;
+        bool                    unknownCalls;
+    };
+
+    void AddWrite(const ExprAST *where, ExprAST *target);
+    bool IsLocal(const FunctionAST *f, const std::string &name) const;
+    bool IsDeclared(const FunctionAST *f, const std::string &name) const;
+    bool OnlyWrites(FunctionAST *f, bool allowVarArgs);
+    void Error(const ExprAST *e, const std::string &msg) const;
+
+  private:
+    Semantics *                           sema;
+    FunctionAST *                         current;
+    std::map<FunctionAST *, FunctionInfo> info;
+    std::set<const ExprAST *>             callees;
+    std::vector<FunctionExprAST *>        functionRefs;
+};
+
+void ArgUsageVisitor::Error(const ExprAST *e, const std::string &msg) const {
+    std::cerr << e->Loc() << " Error: " << msg << std::endl;
+    sema->AddError();
+}
+
+class IndirectionFinder : public ASTVisitor {
+  public:
+    IndirectionFinder() : indirect(false) {}
+    void visit(ExprAST *e) override {
+        indirect |= llvm::isa<PointerExprAST>(e) || llvm::isa<FilePointerExprAST>(e) ||
+                    llvm::isa<VariantFieldExprAST>(e) || llvm::isa<TypeCastAST>(e) ||
+                    llvm::isa<FunctionExprAST>(e);
+    }
+    bool indirect;
+};
+
+void ArgUsageVisitor::AddWrite(const ExprAST *where, ExprAST *target) {
+    Write w{where, ""};
+    if (TypeCastAST *tc = llvm::dyn_cast<TypeCastAST>(target)) {
+        target = tc->Expr();
+    }
+    if (llvm::isa<VariableExprAST>(target)) {
+        IndirectionFinder finder;
+        target->accept(finder);
+        if (!finder.indirect) {
+            w.name = llvm::dyn_cast<VariableExprAST>(target)->Name();
+        }
+    }
+    info[current].writes.push_back(w);
+}
+
+void ArgUsageVisitor::visit(ExprAST *expr) {
+    TRACE();
+
+    if (FunctionAST *f = llvm::dyn_cast<FunctionAST>(expr)) {
+        // A forward declaration has no body, and shares its prototype with the definition,
+        // which is visited on its own.
+        if (!f->body) {
+            current = 0;
+            return;
+        }
+        // Subfunctions are visited after the body of the function.
+        current = f;
+        info[f];
+        return;
+    }
+
+    // These don't visit their contents, so do that here.
+    if (TypeCastAST *tc = llvm::dyn_cast<TypeCastAST>(expr)) {
+        tc->Expr()->accept(*this);
+        return;
+    }
+    if (SetExprAST *s = llvm::dyn_cast<SetExprAST>(expr)) {
+        for (auto v : s->Values()) {
+            v->accept(*this);
+        }
+        return;
+    }
+    if (FunctionExprAST *fe = llvm::dyn_cast<FunctionExprAST>(expr)) {
+        functionRefs.push_back(fe);
+        return;
+    }
+
+    if (!current) {
+        return;
+    }
+
+    FunctionInfo &fi = info[current];
+    if (llvm::isa<VariantFieldExprAST>(expr)) {
+        fi.unknownCalls = true;
+    } else if (AssignExprAST *a = llvm::dyn_cast<AssignExprAST>(expr)) {
+        AddWrite(a, a->lhs);
+    } else if (ForExprAST *f = llvm::dyn_cast<ForExprAST>(expr)) {
+        AddWrite(f, f->variable);
+    } else if (ReadAST *r = llvm::dyn_cast<ReadAST>(expr)) {
+        for (auto arg : r->args) {
+            AddWrite(r, arg);
+        }
+    } else if (WriteAST *w = llvm::dyn_cast<WriteAST>(expr)) {
+        if (w->isWriteStr) {
+            AddWrite(w, w->file);
+        }
+    } else if (BuiltinExprAST *b = llvm::dyn_cast<BuiltinExprAST>(expr)) {
+        if (b->bif->ModifiesArgs()) {
+            for (auto arg : b->bif->Args()) {
+                // New and dispose change what the pointer points at.
+                if (llvm::isa<Types::PointerDecl>(arg->Type())) {
+                    fi.writes.push_back(Write{b, ""});
+                } else if (llvm::isa<VariableExprAST>(arg)) {
+                    AddWrite(b, arg);
+                }
+            }
+        }
+    } else if (CallExprAST *c = llvm::dyn_cast<CallExprAST>(expr)) {
+        FunctionAST *fn = 0;
+        if (FunctionExprAST *fe = llvm::dyn_cast<FunctionExprAST>(c->Callee())) {
+            callees.insert(fe);
+            fn = fe->Proto()->Function();
+        }
+        if (fn) {
+            fi.calls.insert(fn);
+        } else {
+            fi.unknownCalls = true;
+        }
+        const std::vector<VarDef> &parg = c->Proto()->Args();
+        std::vector<ExprAST *> &   args = c->Args();
+        for (size_t i = 0; i < args.size() && i < parg.size(); i++) {
+            if (parg[i].IsRef()) {
+                AddWrite(c, args[i]);
+            }
+        }
+    }
+}
+
+// Local variables, value arguments and the function result.
+bool ArgUsageVisitor::IsLocal(const FunctionAST *f, const std::string &name) const {
+    for (auto d : f->varDecls) {
+        for (auto v : d->Vars()) {
+            if (v.Name() == name) {
+                return true;
+            }
+        }
+    }
+    for (auto a : f->proto->args) {
+        if (a.Name() == name) {
+            return !a.IsRef();
+        }
+    }
+    return f->proto->Type()->Type() != Types::TypeDecl::TK_Void && f->proto->Name() == name;
+}
+
+bool ArgUsageVisitor::IsDeclared(const FunctionAST *f, const std::string &name) const {
+    for (auto a : f->proto->args) {
+        if (a.Name() == name) {
+            return true;
+        }
+    }
+    return IsLocal(f, name);
+}
+
+void ArgUsageVisitor::CheckConstArgs() {
+    for (auto &fi : info) {
+        for (auto w : fi.second.writes) {
+            if (w.name.empty()) {
+                continue;
+            }
+            for (const FunctionAST *f = fi.first; f; f = f->Parent()) {
+                if (IsDeclared(f, w.name)) {
+                    for (auto a : f->proto->args) {
+                        if (a.Name() == w.name && a.IsConst()) {
+                            Error(w.where, "Can't modify const argument '" + w.name + "'");
+                        }
+                    }
+                    break;
+                }
+            }
+        }
+    }
+}
+
+// Does the function only write its own local variables (and, if allowVarArgs, the variables
+// passed to it as var arguments)?
+bool ArgUsageVisitor::OnlyWrites(FunctionAST *f, bool allowVarArgs) {
+    const FunctionInfo &fi = info[f];
+    if (fi.unknownCalls) {
+        return false;
+    }
+    for (auto w : fi.writes) {
+        if (w.name.empty()) {
+            return false;
+        }
+        if (!IsLocal(f, w.name) && !(allowVarArgs && IsDeclared(f, w.name))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void ArgUsageVisitor::FindConstRefArgs() {
+    // Start by assuming that all functions that only write to local variables and var
+    // arguments are "clean", then remove those that call a function that isn't, until there
+    // are no more changes.
+    std::map<FunctionAST *, bool> clean;
+    for (auto &fi : info) {
+        clean[fi.first] = OnlyWrites(fi.first, true);
+    }
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (auto &fi : info) {
+            if (!clean[fi.first]) {
+                continue;
+            }
+            for (auto call : fi.second.calls) {
+                auto c = clean.find(call);
+                if (c == clean.end() || !c->second) {
+                    clean[fi.first] = false;
+                    changed = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    std::set<const PrototypeAST *> addressTaken;
+    for (auto fe : functionRefs) {
+        if (!callees.count(fe)) {
+            addressTaken.insert(fe->Proto());
+        }
+    }
+
+    for (auto &fi : info) {
+        FunctionAST * f = fi.first;
+        PrototypeAST *proto = f->proto;
+        // The caller's variable must not change while the function runs, so the function
+        // can't write var arguments either.
+        if (!clean[f] || !OnlyWrites(f, false) || !f->subFunctions.empty() ||
+            !f->usedVariables.empty() || proto->baseobj || addressTaken.count(proto)) {
+            continue;
+        }
+        std::set<std::string> written;
+        for (auto w : fi.second.writes) {
+            written.insert(w.name);
+        }
+        for (auto &a : proto->args) {
+            if (!a.IsRef() && !a.IsConstRef() && a.Type()->IsCompound() &&
+                !llvm::isa<Types::FuncPtrDecl>(a.Type()) && !written.count(a.Name())) {
+                a.SetConstRef();
+            }
+        }
+    }
+}
+
 void Semantics::AddFixup(SemaFixup *f) {
     TRACE();
     fixups.push_back(f);
@@ -553,4 +961,11 @@ void Semantics::Analyse(ExprAST *ast) {
     TypeCheckVisitor tc(this);
     ast->accept(tc);
     RunFixups();
+
+    ArgUsageVisitor au(this);
+    ast->accept(au);
+    au.CheckConstArgs();
+    if (!errors) {
+        au.FindConstRefArgs();
+    }
 }
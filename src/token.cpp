@@ -138,6 +138,8 @@ const TokenEntry tokenTable[] = {
     {Token::Nil, true, -1, "nil"},
     {Token::And, true, 40, "and"},
     {Token::Or, true, 10, "or"},
+    {Token::AndThen, true, 40, "and_then"},
+    {Token::OrElse, true, 10, "or_else"},
     {Token::Not, true, 60, "not"},
     {Token::Div, true, 40, "div"},
     {Token::Mod, true, 40, "mod"},
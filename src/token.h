@@ -93,6 +93,8 @@ class Token {
         Implementation,
         And,
         Or,
+        AndThen,
+        OrElse,
         Not,
         Case,
         Otherwise,
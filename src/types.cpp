@@ -858,6 +858,10 @@ void FuncPtrDecl::DoDump(std::ostream &out) const {
 llvm::Type *FuncPtrDecl::GetLlvmType() const {
     llvm::Type *              resty = proto->Type()->LlvmType();
     std::vector<llvm::Type *> argTys;
+    if (proto->IsSRet()) {
+        argTys.push_back(llvm::PointerType::getUnqual(resty));
+        resty = GetVoidType()->LlvmType();
+    }
     for (auto v : proto->Args()) {
         llvm::Type *ty = v.Type()->LlvmType();
         if (v.IsRef() || v.Type()->IsCompound()) {
@@ -1003,6 +1007,9 @@ const TypeDecl *StringDecl::CompatibleType(const TypeDecl *ty) const {
     if (SameAs(ty) || ty->Type() == TK_Char) {
         return this;
     }
+    if (ty->Type() == TK_LongString) {
+        return ty;
+    }
     if (ty->Type() == TK_String) {
         if (llvm::dyn_cast<StringDecl>(ty)->Ranges()[0]->End() > Ranges()[0]->End()) {
             return ty;
@@ -1019,6 +1026,51 @@ const TypeDecl *StringDecl::CompatibleType(const TypeDecl *ty) const {
     return 0;
 }
 
+const TypeDecl *StringDecl::AssignableType(const TypeDecl *ty) const {
+    // Long strings are truncated when assigned to a short string.
+    if (ty->Type() == TK_LongString) {
+        return this;
+    }
+    return CompatibleType(ty);
+}
+
+void LongStringDecl::DoDump(std::ostream &out) const {
+    out << "AnsiString";
+}
+
+llvm::Type *LongStringDecl::GetLlvmType() const {
+    return GetVoidPtrType();
+}
+
+llvm::DIType *LongStringDecl::GetDIType(llvm::DIBuilder *builder) const {
+    llvm::DIType *charType = GetCharType()->DebugType(builder);
+    uint64_t      size = Size() * CHAR_BIT;
+    return builder->createPointerType(charType, size, AlignSize() * CHAR_BIT);
+}
+
+const TypeDecl *LongStringDecl::CompatibleType(const TypeDecl *ty) const {
+    switch (ty->Type()) {
+    case TK_LongString:
+    case TK_String:
+    case TK_Char:
+        return this;
+    case TK_Array:
+        if (const ArrayDecl *aty = llvm::dyn_cast<ArrayDecl>(ty)) {
+            if (aty->Ranges().size() == 1 && aty->SubType()->Type() == TK_Char) {
+                return this;
+            }
+        }
+        break;
+    default:
+        break;
+    }
+    return 0;
+}
+
+const TypeDecl *LongStringDecl::AssignableType(const TypeDecl *ty) const {
+    return CompatibleType(ty);
+}
+
 // Void pointer is not a "pointer to void", but a "pointer to Int8".
 llvm::Type *GetVoidPtrType() {
     llvm::Type *base = llvm::IntegerType::getInt8Ty(theContext);
@@ -1029,6 +1081,7 @@ llvm::Type *GetVoidPtrType() {
 static TypeDecl *voidType = 0;
 static TypeDecl *textType = 0;
 static TypeDecl *strType = 0;
+static TypeDecl *longStrType = 0;
 static TypeDecl *integerType = 0;
 static TypeDecl *longIntType = 0;
 static TypeDecl *realType = 0;
@@ -1049,6 +1102,13 @@ TypeDecl *GetStringType() {
     return strType;
 }
 
+TypeDecl *GetLongStringType() {
+    if (!longStrType) {
+        longStrType = new LongStringDecl;
+    }
+    return longStrType;
+}
+
 TypeDecl *GetTextType() {
     if (!textType) {
         textType = new TextDecl;
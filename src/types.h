@@ -30,6 +30,7 @@ TypeDecl *GetRealType();
 TypeDecl *GetVoidType();
 TypeDecl *GetTextType();
 TypeDecl *GetStringType();
+TypeDecl *GetLongStringType();
 
 /* Range is either created by the user, or calculated on basetype */
 class Range {
@@ -78,6 +79,7 @@ class TypeDecl {
         TK_Variant,
         TK_Class,
         TK_MemberFunc,
+        TK_LongString,
         TK_Forward,
     };
 
@@ -632,6 +634,24 @@ class StringDecl : public ArrayDecl {
     void            DoDump(std::ostream &out) const override;
     bool            HasLlvmType() const override { return true; }
     const TypeDecl *CompatibleType(const TypeDecl *ty) const override;
+    const TypeDecl *AssignableType(const TypeDecl *ty) const override;
+};
+
+// Heap allocated, reference counted string (AnsiString). Represented as a pointer to the
+// characters, with the reference count and length stored just before them in memory.
+// Must match with "runtime".
+class LongStringDecl : public BasicTypeDecl {
+  public:
+    LongStringDecl() : BasicTypeDecl(TK_LongString) {}
+    const TypeDecl *CompatibleType(const TypeDecl *ty) const override;
+    const TypeDecl *AssignableType(const TypeDecl *ty) const override;
+    bool            HasLlvmType() const override { return true; }
+    void            DoDump(std::ostream &out) const override;
+    static bool     classof(const TypeDecl *e) { return e->getKind() == TK_LongString; }
+
+  protected:
+    llvm::Type *  GetLlvmType() const override;
+    llvm::DIType *GetDIType(llvm::DIBuilder *builder) const override;
 };
 
 llvm::Type *GetVoidPtrType();
@@ -0,0 +1,116 @@
+program alloc;
+
+{ new and dispose of objects in different size classes, and of ones too big for any. }
+
+type
+   small   = record
+                a : integer;
+             end;
+   medium  = record
+                a : integer;
+                b : array [1..5] of integer;
+             end;
+   large   = record
+                a : integer;
+                b : array [1..60] of integer;
+             end;
+   huge    = record
+                a : integer;
+                b : array [1..300] of integer;
+             end;
+   counter = object
+                n, m : integer;
+             end;
+
+   psmall   = ^small;
+   pmedium  = ^medium;
+   plarge   = ^large;
+   phuge    = ^huge;
+   pcounter = ^counter;
+
+var
+   s       : array [1..100] of psmall;
+   m       : array [1..100] of pmedium;
+   l       : array [1..100] of plarge;
+   h       : array [1..100] of phuge;
+   save    : psmall;
+   c, c2   : pcounter;
+   i       : integer;
+
+procedure make(i, v : integer);
+begin
+   new(s[i]);
+   s[i]^.a := v;
+   new(m[i]);
+   m[i]^.a := v;
+   m[i]^.b[5] := v * 2;
+   new(l[i]);
+   l[i]^.a := v;
+   l[i]^.b[60] := v * 3;
+   new(h[i]);
+   h[i]^.a := v;
+   h[i]^.b[300] := v * 4;
+end;
+
+function sum(step : integer) : longint;
+var
+   i : integer;
+   t : longint;
+begin
+   t := 0;
+   i := 2;
+   while i <= 100 do
+   begin
+      t := t + s[i]^.a + m[i]^.a + m[i]^.b[5] + l[i]^.a + l[i]^.b[60] + h[i]^.a + h[i]^.b[300];
+      if step = 1 then
+         t := t + s[i - 1]^.a + m[i - 1]^.a + m[i - 1]^.b[5] + l[i - 1]^.a + l[i - 1]^.b[60] +
+              h[i - 1]^.a + h[i - 1]^.b[300];
+      i := i + 2;
+   end;
+   sum := t;
+end;
+
+begin
+   for i := 1 to 100 do
+      make(i, i);
+   writeln('All ', sum(1));
+   i := 1;
+   while i <= 100 do
+   begin
+      dispose(s[i]);
+      dispose(m[i]);
+      dispose(l[i]);
+      dispose(h[i]);
+      i := i + 2;
+   end;
+   writeln('Even ', sum(2));
+   i := 1;
+   while i <= 100 do
+   begin
+      make(i, i + 100);
+      i := i + 2;
+   end;
+   writeln('Again ', sum(1));
+
+   { What was just disposed is used again. }
+   new(save);
+   dispose(save);
+   new(s[1]);
+   writeln('Reused ', s[1] = save);
+
+   { Objects are disposed without the compiler knowing the size class. }
+   new(c);
+   c^.n := 7;
+   c^.m := 8;
+   new(c2);
+   c2^.n := 9;
+   c2^.m := 10;
+   writeln('Object ', c^.n + c^.m, ' ', c2^.n + c2^.m);
+   dispose(c);
+   new(c);
+   c^.n := 1;
+   c^.m := 2;
+   writeln('Object ', c^.n + c^.m, ' ', c2^.n + c2^.m);
+   dispose(c);
+   dispose(c2);
+end.
@@ -0,0 +1,54 @@
+program asyncio;
+
+type
+   intfile = file of integer;
+
+var
+   t    : text;
+   f    : intfile;
+   i, n : integer;
+   sum  : longint;
+
+begin
+   assign(t, 'asyncio.txt');
+   AsyncFile(t);
+   rewrite(t);
+   for i := 1 to 100000 do
+      writeln(t, i);
+   close(t);
+
+   AsyncFile(t);
+   reset(t);
+   sum := 0;
+   n := 0;
+   while not eof(t) do
+   begin
+      readln(t, i);
+      sum := sum + i;
+      n := n + 1;
+   end;
+   close(t);
+   writeln('Lines ', n, ' sum ', sum);
+
+   assign(f, 'asyncio.dat');
+   AsyncFile(f);
+   rewrite(f);
+   for i := 1 to 20000 do
+      write(f, i);
+   close(f);
+
+   AsyncFile(f);
+   reset(f);
+   sum := 0;
+   n := 0;
+   while not eof(f) do
+   begin
+      read(f, i);
+      sum := sum + i;
+      n := n + 1;
+      if n = 15000 then
+         writeln('Position ', Position(f));
+   end;
+   close(f);
+   writeln('Records ', n, ' sum ', sum);
+end.
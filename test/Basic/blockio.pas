@@ -0,0 +1,51 @@
+program blockio;
+
+type
+   rec = record
+            n : integer;
+            x : real;
+         end;
+
+   recfile = file of rec;
+
+var
+   f     : recfile;
+   block : array [1..1000] of rec;
+   r     : rec;
+   i, n  : integer;
+   got   : integer;
+   sum   : longint;
+
+begin
+   assign(f, 'blockio.dat');
+   rewrite(f);
+   for i := 1 to 1000 do
+   begin
+      block[i].n := i;
+      block[i].x := i / 2;
+   end;
+   BlockWrite(f, block, 1000);
+   for i := 1001 to 1500 do
+   begin
+      r.n := i;
+      r.x := i / 2;
+      write(f, r);
+   end;
+   BlockWrite(f, block, 10, got);
+   writeln('Wrote ', got);
+   close(f);
+
+   reset(f);
+   read(f, r);
+   writeln(r.n, ' ', r.x:1:1);
+   n := 1;
+   sum := r.n;
+   repeat
+      BlockRead(f, block, 1000, got);
+      for i := 1 to got do
+         sum := sum + block[i].n;
+      n := n + got;
+   until got < 1000;
+   writeln('Read ', n, ' sum ', sum, ' eof ', eof(f));
+   close(f);
+end.
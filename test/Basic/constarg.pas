@@ -0,0 +1,83 @@
+program constarg;
+
+type
+   big = record
+            a : array [1..100] of integer;
+            n : integer;
+         end;
+
+var
+   b, c : big;
+   s    : string;
+   i    : integer;
+
+function sum(const x : big) : integer;
+var
+   i, t : integer;
+begin
+   t := 0;
+   for i := 1 to x.n do
+      t := t + x.a[i];
+   sum := t;
+end;
+
+function count(const s : string; const c : char) : integer;
+var
+   i, n : integer;
+begin
+   n := 0;
+   for i := 1 to length(s) do
+      if s[i] = c then
+         n := n + 1;
+   count := n;
+end;
+
+procedure later(s : string; x : big); forward;
+
+{ x is never modified, so it can be passed by reference }
+function first(x : big) : integer;
+begin
+   first := x.a[1];
+end;
+
+{ Modifies its copy, the caller's record must not change }
+procedure clear(x : big);
+begin
+   x.a[1] := 0;
+   writeln(x.a[1], ' ', first(x));
+end;
+
+{ Writes y while reading x, x must be a copy when both are the same variable }
+procedure shift(x : big; var y : big);
+var
+   i : integer;
+begin
+   for i := 2 to x.n do
+      y.a[i] := x.a[i - 1];
+   writeln(x.a[2], ' ', y.a[3]);
+end;
+
+{ The forward declaration doesn't modify anything, but this does }
+procedure later(s : string; x : big);
+begin
+   s[1] := 'X';
+   x.a[1] := 42;
+   writeln(s, ' ', x.a[1]);
+end;
+
+begin
+   b.n := 10;
+   for i := 1 to 100 do
+      b.a[i] := i;
+   writeln(sum(b));
+   s := 'const arguments are read only';
+   writeln(count(s, 'r'), ' ', count('abracadabra', 'a'));
+   writeln(first(b));
+   clear(b);
+   writeln(b.a[1]);
+   c := b;
+   shift(c, c);
+   writeln(c.a[2], ' ', c.a[10]);
+   later(s, b);
+   writeln(s, ' ', b.a[1]);
+end.
@@ -0,0 +1,50 @@
+program forin;
+
+type
+   colour = (red, green, blue, yellow, black);
+   small  = 3..7;
+
+var
+   s      : set of 0..200;
+   cs     : set of char;
+   cols   : set of colour;
+   i      : integer;
+   c      : char;
+   col    : colour;
+   sm     : small;
+   n      : integer;
+
+begin
+   s := [1, 31, 32, 33, 63, 64, 150, 200];
+   for i in s do
+      write(i:4);
+   writeln;
+
+   n := 0;
+   s := [];
+   for i in s do
+      n := n + 1;
+   writeln(n);
+
+   cs := ['z', 'a', 'm'..'o'];
+   for c in cs do
+      write(c);
+   writeln;
+
+   cols := [green, black];
+   for col in cols do
+      write(ord(col):2);
+   writeln;
+
+   for col in colour do
+      write(ord(col):2);
+   writeln;
+
+   for sm in small do
+      write(sm:2);
+   writeln;
+
+   for c in ['x'..'z'] do
+      write(c);
+   writeln;
+end.
@@ -0,0 +1,41 @@
+program heapprof;
+
+type
+   node = record
+             next  : ^node;
+             value : integer;
+          end;
+   big  = array [1..100] of integer;
+
+var
+   list, p : ^node;
+   b       : ^big;
+   i       : integer;
+
+begin
+   list := nil;
+   for i := 1 to 10 do
+   begin
+      new(p);
+      p^.value := i;
+      p^.next := list;
+      list := p;
+   end;
+   new(b);
+   b^[1] := 42;
+   dispose(b);
+   for i := 1 to 4 do
+   begin
+      p := list;
+      list := list^.next;
+      dispose(p);
+   end;
+   i := 0;
+   p := list;
+   while p <> nil do
+   begin
+      i := i + p^.value;
+      p := p^.next;
+   end;
+   writeln(i);
+end.
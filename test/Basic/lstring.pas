@@ -0,0 +1,54 @@
+program lstring;
+
+var
+   s, t  : ansistring;
+   short : string;
+   i     : integer;
+
+function greet(name : ansistring) : ansistring;
+begin
+   greet := 'Hello, ' + name + '!';
+end;
+
+{ Changes t, which the caller is appending to. }
+function change(n : integer) : ansistring;
+begin
+   t := 'new';
+   change := copy('!!!', 1, n);
+end;
+
+begin
+   s := 'abc';
+   t := s;
+   s := s + 'def';
+   writeln(s, ' ', t, ' ', length(s), ' ', length(t));
+   writeln(greet('World'));
+   t := '';
+   for i := 1 to 100 do
+      t := t + 'x';
+   writeln(length(t));
+   writeln(copy(s, 2, 3));
+   if s > t then
+      writeln('wrong')
+   else
+      writeln('less');
+   if copy(s, 1, 3) = 'abc' then
+      writeln('equal');
+   short := s;
+   t := short + '!';
+   writeln(short, ' ', t);
+   writeln('[', s:8, ']');
+   t := s;
+   t[1] := 'A';
+   writeln(s, ' ', t, ' ', t[1], s[6]);
+   t := 'ab';
+   t := t + s + t;
+   writeln(t, ' ', length(t));
+   t := t + t;
+   writeln(t, ' ', s);
+   writeln(pos('cd', s), ' ', pos('f', s + 'f'), ' ', posfrom('ab', t, 2), ' ', pos(s, t), ' ',
+           posfrom(s, t, 4));
+   t := 'old';
+   t := t + change(1);
+   writeln(t);
+end.
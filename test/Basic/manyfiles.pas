@@ -0,0 +1,34 @@
+program manyfiles;
+
+type
+   intfile = file of integer;
+
+var
+   t    : text;
+   f    : intfile;
+   i, n : integer;
+   sum  : integer;
+
+begin
+   sum := 0;
+   for i := 1 to 3000 do
+   begin
+      assign(t, 'manyfiles.txt');
+      rewrite(t);
+      writeln(t, i);
+      close(t);
+
+      assign(t, 'manyfiles.txt');
+      reset(t);
+      readln(t, n);
+      close(t);
+
+      rewrite(f);
+      write(f, n);
+      reset(f);
+      read(f, n);
+      close(f);
+      sum := sum + n;
+   end;
+   writeln('Sum ', sum);
+end.
@@ -0,0 +1,61 @@
+program markrelease;
+
+type
+   link = ^node;
+   node = record
+             key  : integer;
+             next : link;
+          end;
+
+var
+   keep, head, p : link;
+   m, m2, saved  : link;
+   i, r          : integer;
+   sum           : longint;
+
+procedure add(k : integer);
+begin
+   new(p);
+   p^.key := k;
+   p^.next := head;
+   head := p;
+end;
+
+begin
+   new(keep);
+   keep^.key := 42;
+
+   sum := 0;
+   for r := 1 to 100 do
+   begin
+      mark(m);
+      head := nil;
+      for i := 1 to 1000 do
+         add(i);
+      saved := head;
+      mark(m2);
+      for i := 1 to 10 do
+         add(0);
+      release(m2);
+      head := saved;
+      p := head;
+      while p <> nil do
+      begin
+         sum := sum + p^.key;
+         p := p^.next;
+      end;
+      dispose(head);
+      release(m);
+   end;
+   writeln('Sum ', sum);
+
+   mark(m);
+   new(p);
+   release(m);
+   mark(m2);
+   new(head);
+   release(m2);
+   writeln('Reused ', p = head);
+   writeln('Keep ', keep^.key);
+   dispose(keep);
+end.
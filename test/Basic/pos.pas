@@ -0,0 +1,40 @@
+program posfunc;
+
+var
+   s, n : string;
+   a    : array [1..12] of char;
+   c    : char;
+   i    : integer;
+
+begin
+   s := 'hello world, hello pascal';
+   writeln(pos('hello', s));
+   writeln(posfrom('hello', s, 2));
+   writeln(pos('w', s));
+   writeln(pos('xyz', s));
+   writeln(pos('', s));
+   c := ',';
+   writeln(pos(c, s));
+   writeln(posfrom('l', s, 5));
+   n := 'pascal';
+   writeln(pos(n, s));
+   n := 'world, hello';
+   writeln(posfrom(n, s, 8));
+   writeln(posfrom(n, s, 7));
+   a := 'abcabcabcxyz';
+   writeln(pos('cxy', a));
+   s := 'aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaab';
+   writeln(pos('aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaab', s));
+   writeln(pos('aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaac', s));
+   s := 'the quick brown fox jumps over the lazy dog, the quick brown fox jumps again';
+   writeln(posfrom('the quick brown fox jumps over the lazy dog', s, 1));
+   writeln(posfrom('the quick brown fox jumps again', s, 2));
+   i := 0;
+   i := posfrom('quick', s, 6);
+   while i <> 0 do
+   begin
+      write(i, ' ');
+      i := posfrom('quick', s, i + 1);
+   end;
+   writeln;
+end.
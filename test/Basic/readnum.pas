@@ -0,0 +1,35 @@
+program readnum;
+
+type
+   digit = 0..9;
+
+var
+   i    : integer;
+   l    : longint;
+   r    : real;
+   d    : digit;
+   code : integer;
+
+begin
+   read(i, l);
+   writeln('i=', i, ' l=', l);
+   readln(r);
+   writeln('r=', r:1:6);
+   readln(r);
+   writeln('r=', r:1:1);
+   readln(d);
+   writeln('d=', d);
+   readln(i);
+   writeln('i=', i);
+
+   Val('  123', i, code);
+   writeln(i, ' ', code);
+   Val('12x', i, code);
+   writeln(i, ' ', code);
+   Val('99999999999', i, code);
+   writeln(i, ' ', code);
+   Val('-9223372036854775808', l, code);
+   writeln(l, ' ', code);
+   Val('2.5e-3', r, code);
+   writeln(r:1:4, ' ', code);
+end.
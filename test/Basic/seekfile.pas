@@ -0,0 +1,79 @@
+program seekfile;
+
+type
+   entry = record
+              key   : integer;
+              value : real;
+           end;
+
+var
+   f    : file of entry;
+   e    : entry;
+   i    : integer;
+   sum  : integer;
+
+procedure lookup(n : integer);
+begin
+   SeekRead(f, n);
+   writeln(n, ': ', f^.key, ' ', f^.value:1:2, ' at ', Position(f));
+end;
+
+begin
+   assign(f, 'seekfile.dat');
+   rewrite(f);
+   writeln('Empty ', LastPosition(f));
+   for i := 0 to 999 do
+   begin
+      e.key := i * 3;
+      e.value := i / 4;
+      write(f, e);
+   end;
+   writeln('Last ', LastPosition(f), ' at ', Position(f));
+
+   SeekWrite(f, 10);
+   e.key := -1;
+   e.value := -1;
+   write(f, e);
+   writeln('Wrote at ', Position(f));
+
+   lookup(999);
+   lookup(10);
+   lookup(123);
+
+   MapFile(f);
+   SeekRead(f, 20);
+   f^.key := 77;
+   put(f);
+   writeln('Put at ', Position(f));
+   lookup(21);
+   close(f);
+
+   reset(f);
+   MapFile(f);
+   lookup(500);
+   lookup(10);
+   get(f);
+   writeln('Next ', f^.key, ' at ', Position(f));
+   SeekRead(f, 998);
+   sum := 0;
+   while not eof(f) do
+   begin
+      sum := sum + f^.key;
+      get(f);
+   end;
+   writeln('Sum ', sum, ' at ', Position(f), ' of ', LastPosition(f) + 1);
+   close(f);
+
+   append(f);
+   e.key := 5000;
+   e.value := 0;
+   write(f, e);
+   writeln('Appended at ', Position(f), ' of ', LastPosition(f) + 1);
+   SeekWrite(f, 3);
+   e.key := -3;
+   write(f, e);
+   writeln('Wrote at ', Position(f), ' of ', LastPosition(f) + 1);
+   lookup(3);
+   lookup(1000);
+   close(f);
+end.
@@ -0,0 +1,40 @@
+program setin;
+
+const
+   space = ' ';
+   comma = ',';
+
+var
+   c          : char;
+   i          : integer;
+   digits     : integer;
+   punct      : integer;
+   spread     : integer;
+   none       : integer;
+
+begin
+   digits := 0;
+   punct := 0;
+   none := 0;
+   for c := chr(0) to chr(255) do
+   begin
+      if c in ['0'..'9'] then
+         digits := digits + 1;
+      if c in [space, comma, '.', ';'] then
+         punct := punct + 1;
+      if c in [] then
+         none := none + 1;
+   end;
+   writeln(digits, ' ', punct, ' ', none);
+
+   spread := 0;
+   for i := 0 to 255 do
+      if i in [0, 100, 200, 255] then
+         spread := spread + i;
+   writeln(spread);
+
+   for c := 'a' to 'z' do
+      if c in ['a', 'e', 'i', 'o', 'u'] then
+         write(c);
+   writeln;
+end.
@@ -0,0 +1,59 @@
+program setrange;
+
+type
+   bigset = set of 0..255;
+
+var
+   s     : bigset;
+   c     : char;
+   cs    : set of char;
+   lo, hi : integer;
+   i, n  : integer;
+
+function count(s : bigset) : integer;
+var
+   i, n : integer;
+begin
+   n := 0;
+   for i := 0 to 255 do
+      if i in s then
+         n := n + 1;
+   count := n;
+end; { count }
+
+begin
+   lo := 3;
+   hi := 200;
+   s := [lo..hi];
+   writeln(count(s):4, s = [3..200]:6);
+   s := [lo..lo];
+   writeln(count(s):4, s = [3]:6);
+   s := [hi..lo];
+   writeln(count(s):4, s = []:6);
+   lo := 32;
+   hi := 63;
+   s := [lo..hi, 7, 100..101];
+   writeln(count(s):4, s = [7, 32..63, 100, 101]:6);
+   s := [0..255];
+   writeln(count(s):4);
+   for i := 0 to 255 do
+   begin
+      lo := i;
+      hi := i + 40;
+      if hi > 255 then
+         hi := 255;
+      s := [lo..hi, 250];
+      if s <> [i..hi] + [250] then
+         writeln('bad range ', i);
+   end;
+   n := 0;
+   for c := ' ' to '~' do
+   begin
+      cs := ['a'..'z', 'A'..'Z', '0'..'9', c];
+      if c in cs then
+         n := n + 1;
+      if not ('q' in cs) then
+         writeln('bad char set');
+   end;
+   writeln(n:4);
+end.
@@ -0,0 +1,87 @@
+program shortcircuit;
+
+type
+   link = ^node;
+   node = record
+             key  : integer;
+             next : link;
+          end;
+
+var
+   calls : integer;
+   head  : link;
+   a     : array [1..5] of integer;
+   i     : integer;
+   b     : boolean;
+
+function t : boolean;
+begin
+   calls := calls + 1;
+   t := true;
+end;
+
+function f : boolean;
+begin
+   calls := calls + 1;
+   f := false;
+end;
+
+procedure add(k : integer);
+var
+   p : link;
+begin
+   new(p);
+   p^.key := k;
+   p^.next := head;
+   head := p;
+end;
+
+function find(k : integer) : link;
+var
+   p : link;
+begin
+   p := head;
+   while (p <> nil) and (p^.key <> k) do
+      p := p^.next;
+   find := p;
+end;
+
+begin
+   calls := 0;
+   b := f and t;
+   writeln(b, ' ', calls);
+   calls := 0;
+   b := t or f;
+   writeln(b, ' ', calls);
+   calls := 0;
+   b := t and f;
+   writeln(b, ' ', calls);
+   calls := 0;
+   b := f or t;
+   writeln(b, ' ', calls);
+   calls := 0;
+   b := f and then t;
+   writeln(b, ' ', calls);
+   calls := 0;
+   b := t or_else f;
+   writeln(b, ' ', calls);
+   calls := 0;
+   b := (t and f) or else (f or t and t);
+   writeln(b, ' ', calls);
+
+   head := nil;
+   for i := 1 to 5 do
+      add(i * 10);
+   writeln(find(30) <> nil, ' ', find(99) = nil);
+
+   for i := 1 to 5 do
+      a[i] := i * i;
+   i := 1;
+   while (i <= 5) and then (a[i] <> 16) do
+      i := i + 1;
+   writeln(i);
+   i := 1;
+   while (i <= 5) and_then (a[i] <> 7) do
+      i := i + 1;
+   writeln(i);
+end.
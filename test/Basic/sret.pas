@@ -0,0 +1,74 @@
+program sret;
+
+type
+   point = record
+              x, y : integer;
+           end;
+   digits = set of 0..9;
+
+var
+   p, q : point;
+   s    : string;
+   d    : digits;
+
+function mkpoint(x, y : integer) : point;
+var
+   r : point;
+begin
+   r.x := x;
+   r.y := y;
+   mkpoint := r;
+end;
+
+function swap(p : point) : point;
+begin
+   swap := mkpoint(p.y, p.x);
+end;
+
+function rev(s : string) : string;
+begin
+   if length(s) <= 1 then
+      rev := s
+   else
+      rev := rev(copy(s, 2, length(s) - 1)) + s[1];
+end;
+
+function odds(n : integer) : digits;
+var
+   i : integer;
+begin
+   odds := [];
+   for i := 0 to n do
+      if odd(i) then
+         odds := odds + [i];
+end;
+
+procedure local;
+var
+   r : point;
+   t : string;
+begin
+   r := mkpoint(7, 8);
+   r := swap(r);
+   writeln(r.x, ' ', r.y);
+   t := rev('local');
+   writeln(t);
+end;
+
+begin
+   p := mkpoint(1, 2);
+   q := swap(p);
+   writeln(p.x, ' ', p.y, ' ', q.x, ' ', q.y);
+   p := swap(swap(mkpoint(3, 4)));
+   writeln(p.x, ' ', p.y);
+   s := rev('abcdef');
+   writeln(s);
+   writeln(rev('xyz'), ' ', length(rev('hello')));
+   d := odds(9);
+   writeln(5 in d, ' ', 4 in d, ' ', 7 in odds(7));
+   local;
+   writeln(copy('hello', 1, 5));
+   writeln(copy('hello', 2, 10));
+   writeln(copy('hello', 5, 1));
+   writeln(length(copy('hello', 6, 2)));
+end.
@@ -0,0 +1,66 @@
+program strcase;
+
+const
+   keyword = 'while';
+   letter  = 'y';
+   ten     = 'abcdefghij';
+   fifty   = ten + ten + ten + ten + ten;
+   longest = fifty + fifty + fifty + fifty + fifty + 'abcde';
+
+var
+   words : array [1..9] of string;
+   i     : integer;
+   w     : string;
+   l     : ansistring;
+
+procedure kind(s : ansistring);
+begin
+   case s of
+     longest : writeln('longest');
+     keyword : writeln('keyword');
+     letter  : writeln('letter');
+   otherwise
+      writeln('other ', length(s));
+   end;
+end;
+
+function classify(s : string) : integer;
+begin
+   case s of
+     'begin', 'end'    : classify := 1;
+     'if', 'then'      : classify := 2;
+     'else'            : classify := 3;
+     'while', 'repeat' : classify := 4;
+     'x'               : classify := 5;
+     ''                : classify := 6;
+   otherwise
+      classify := 0;
+   end;
+end;
+
+begin
+   words[1] := 'begin';
+   words[2] := 'end';
+   words[3] := 'then';
+   words[4] := 'else';
+   words[5] := 'elsa';
+   words[6] := 'repeat';
+   words[7] := 'x';
+   words[8] := '';
+   words[9] := 'whilst';
+   for i := 1 to 9 do
+      write(classify(words[i]):2);
+   writeln;
+   w := 'if';
+   case w of
+     'if' : writeln('if statement');
+     'of' : writeln('of');
+   end;
+   l := longest;
+   kind(l);
+   l := l + 'z';
+   kind(l);
+   kind(keyword);
+   kind(letter);
+   kind('');
+end.
@@ -0,0 +1,23 @@
+program strcat;
+
+var
+   a, b, s : string;
+   c       : char;
+   i       : integer;
+
+begin
+   a := 'abc';
+   b := 'XY';
+   c := '!';
+   s := a + b + c + 'def' + a;
+   writeln(s, ' ', length(s));
+   s := s + b + c;
+   writeln(s);
+   s := b + s + b;
+   writeln(s);
+   s := 'x';
+   for i := 1 to 10 do
+      s := s + s;
+   writeln(length(s));
+   writeln(a + '-' + b + '-' + c);
+end.
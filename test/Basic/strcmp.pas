@@ -0,0 +1,25 @@
+program strcmp;
+
+var
+   a, b : string;
+   c    : char;
+
+procedure check(x, y : string);
+begin
+   writeln(x = y, ' ', x <> y, ' ', x < y, ' ', x <= y, ' ', x > y, ' ', x >= y);
+end;
+
+begin
+   check('abc', 'abc');
+   check('abc', 'abd');
+   check('abc', 'ab');
+   check('', 'a');
+   check('', '');
+   a := 'begin';
+   b := 'beginning';
+   writeln(a = 'begin', ' ', a = 'begi', ' ', a <> 'end', ' ', b = a);
+   writeln(a < 'end', ' ', 'while' > a, ' ', a >= 'begin');
+   c := 'b';
+   a := 'b';
+   writeln(a = c, ' ', c = a, ' ', c < 'bb', ' ', a = '');
+end.
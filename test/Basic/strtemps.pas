@@ -0,0 +1,42 @@
+program strtemps;
+
+var
+   s : string;
+   i : integer;
+
+function reverse(s : string) : string;
+begin
+   if length(s) <= 1 then
+      reverse := s
+   else
+      reverse := reverse(copy(s, 2, length(s) - 1)) + s[1];
+end;
+
+function vowels(s : string) : integer;
+var
+   i, n : integer;
+begin
+   n := 0;
+   for i := 1 to length(s) do
+      if s[i] in ['a', 'e', 'i', 'o', 'u'] then
+         n := n + 1;
+   vowels := n;
+end;
+
+begin
+   s := 'temporaries';
+   writeln(reverse(s));
+   writeln(vowels(s + ' and ' + reverse(s)));
+   s := '';
+   for i := 1 to 5 do
+   begin
+      s := s + copy('abcde', i, 1) + '-';
+      if s + '!' = 'a-b-!' then
+         writeln('two');
+   end;
+   writeln(s);
+   if (['a'..'c'] + ['x']) * ['b', 'x'] = ['b', 'x'] then
+      writeln('set ok');
+   if reverse(reverse(s)) = s then
+      writeln(reverse(s + s) = reverse(s) + reverse(s));
+end.
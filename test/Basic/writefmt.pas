@@ -0,0 +1,35 @@
+program writefmt;
+
+var
+   i : integer;
+   l : longint;
+   r : real;
+   c : char;
+   b : boolean;
+   s : string;
+   a : array [1..5] of char;
+
+begin
+   i := -42;
+   l := 1234567890123;
+   r := 3.14159;
+   c := 'x';
+   b := true;
+   s := 'hello';
+   a := 'abcde';
+   writeln('[', i, '][', i:6, '][', i:1, ']');
+   writeln('[', l, '][', l:16, ']');
+   writeln('[', r, '][', r:10, '][', r:0:2, '][', r:9:3, '][', -r:20, ']');
+   writeln('[', 1.0e10, '][', 0.0, '][', -1.5e-7, '][', 1.0e300, '][', 99999.995, ']');
+   writeln('[', c, '][', c:3, '][', b, '][', b:6, '][', b:2, ']');
+   writeln('[', s, '][', s:3, ']');
+   writeln('[', a, '][', a:7, '][', a:3, ']');
+   write('no newline');
+   writeln;
+   writeln;
+   writeln(i, ' ', r:1:1, ' ', b, ' ', c, ' ', s);
+   a[3] := chr(0);
+   s[3] := chr(0);
+   writeln('[', a, '][', a:4, '][', s, ']');
+   writeln(0.5:1:520);
+end.
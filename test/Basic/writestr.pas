@@ -0,0 +1,38 @@
+program writestr;
+
+var
+   s   : string;
+   l   : ansistring;
+   i   : integer;
+   r   : real;
+   big : longint;
+
+begin
+   i := 42;
+   r := 3.14159;
+   WriteStr(s, 'i=', i, ' r=', r:0:3, ' ok=', true);
+   writeln(s);
+   WriteStr(s, '[', i:5, '][', 'ab':4, '][', 'x':3, ']');
+   writeln(s);
+   Str(r:8:2, s);
+   writeln('[', s, ']');
+   Str(-123, s);
+   writeln(s);
+   big := 1234567890123;
+   Str(big, s);
+   writeln(s);
+   WriteStr(s, s, '!', s);
+   writeln(s);
+   WriteStr(l, 'long ', i * 2);
+   writeln(l, ' ', length(l));
+   WriteStr(s);
+   writeln(length(s));
+   s := 'abc';
+   WriteStr(l, '[', s:6, '][', 'de':4, '][', true:6, '][', r:8:2, '][', i:1, ']');
+   writeln(l);
+   writeln('[', s:6, '][', 'de':4, '][', true:6, '][', r:8:2, '][', i:1, ']');
+   WriteStr(l, '<', i:300, '>');
+   writeln(length(l), ' ', l[1], l[300], l[301], l[302]);
+   WriteStr(l, l, l);
+   writeln(length(l), ' ', l[604]);
+end.
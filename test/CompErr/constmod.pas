@@ -0,0 +1,10 @@
+program p;
+
+procedure change(const s : string);
+begin
+   s := 'changed';
+end;
+
+begin
+   change('x');
+end.
@@ -0,0 +1,14 @@
+program p;
+
+type
+   person = record
+	       name : ansistring;
+	       age  : integer;
+	    end;
+
+var
+   who : person;
+
+begin
+   who.age := 42;
+end.
@@ -0,0 +1,11 @@
+program p;
+
+var
+   s : string;
+
+begin
+   case s of
+     'a', 'b' : s := 'x';
+     'b'      : s := 'y';
+   end;
+end.
@@ -0,0 +1,80 @@
+program allocbench;
+
+{ Run with LACSAP_SYSTEM_MALLOC=1 to compare with the C library malloc. }
+
+type
+   link = ^node;
+   node = record
+             key  : integer;
+             next : link;
+          end;
+
+   tree = ^treenode;
+   treenode = record
+                 key         : integer;
+                 value       : real;
+                 left, right : tree;
+              end;
+
+var
+   head, p : link;
+   i, r    : integer;
+   sum     : longint;
+
+function build(depth : integer) : tree;
+var
+   t : tree;
+begin
+   if depth = 0 then
+      build := nil
+   else
+   begin
+      new(t);
+      t^.key := depth;
+      t^.value := depth / 2;
+      t^.left := build(depth - 1);
+      t^.right := build(depth - 1);
+      build := t;
+   end;
+end;
+
+function walk(t : tree) : longint;
+begin
+   if t = nil then
+      walk := 0
+   else
+   begin
+      walk := t^.key + walk(t^.left) + walk(t^.right);
+      dispose(t);
+   end;
+end;
+
+begin
+   sum := 0;
+   for r := 1 to 50 do
+   begin
+      head := nil;
+      for i := 1 to 200000 do
+      begin
+         new(p);
+         p^.key := i;
+         p^.next := head;
+         head := p;
+      end;
+      p := head;
+      while p <> nil do
+      begin
+         sum := sum + p^.key;
+         p := p^.next;
+      end;
+      while head <> nil do
+      begin
+         p := head^.next;
+         dispose(head);
+         head := p;
+      end;
+   end;
+   for r := 1 to 20 do
+      sum := sum + walk(build(17));
+   writeln(sum);
+end.
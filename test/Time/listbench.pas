@@ -0,0 +1,63 @@
+program listbench;
+
+type
+   link = ^node;
+   node = record
+             key  : integer;
+             next : link;
+          end;
+
+var
+   head  : link;
+   a     : array [1..1000] of integer;
+   i, j  : integer;
+   count : integer;
+
+procedure add(k : integer);
+var
+   p : link;
+begin
+   new(p);
+   p^.key := k;
+   p^.next := head;
+   head := p;
+end;
+
+function find(k : integer) : boolean;
+var
+   p : link;
+begin
+   p := head;
+   while (p <> nil) and (p^.key <> k) do
+      p := p^.next;
+   find := p <> nil;
+end;
+
+function search(k : integer) : integer;
+var
+   i : integer;
+begin
+   i := 1;
+   while (i <= 1000) and (a[i] <> k) do
+      i := i + 1;
+   search := i;
+end;
+
+begin
+   head := nil;
+   for i := 1 to 1000 do
+   begin
+      add(i * 3);
+      a[i] := i * 7;
+   end;
+
+   count := 0;
+   for j := 1 to 20000 do
+   begin
+      if find((j mod 1500) * 2) then
+         count := count + 1;
+      if search((j mod 1500) * 5) <= 1000 then
+         count := count + 1;
+   end;
+   writeln(count);
+end.
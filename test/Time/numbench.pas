@@ -0,0 +1,34 @@
+program numbench;
+
+var
+   f    : text;
+   i, n : integer;
+   big  : longint;
+   r    : real;
+   sep  : char;
+   sum  : longint;
+   rsum : real;
+
+begin
+   assign(f, 'numbench.txt');
+   rewrite(f);
+   for i := 1 to 500000 do
+   begin
+      big := i;
+      writeln(f, i, ',', big * 1000003, ',', i / 8:1:3);
+   end;
+   close(f);
+
+   reset(f);
+   sum := 0;
+   rsum := 0;
+   while not eof(f) do
+   begin
+      read(f, n, sep, big, sep);
+      readln(f, r);
+      sum := sum + n + big;
+      rsum := rsum + r;
+   end;
+   close(f);
+   writeln(sum, ' ', rsum:1:3);
+end.
@@ -0,0 +1,90 @@
+program posbench;
+
+{ Does the same searches with a naive loop and with pos/posfrom, printing
+  the sum of the positions found by each. Give any argument to also print
+  how long each took. }
+
+const
+   rounds = 200000;
+
+var
+   s           : string;
+   i           : integer;
+   naive, fast : longint;
+   t0, t1, t2  : longint;
+
+function naivepos(const n, h : string; start : integer) : integer;
+var
+   i, j : integer;
+   ok   : boolean;
+begin
+   naivepos := 0;
+   i := start;
+   while i <= length(h) - length(n) + 1 do
+   begin
+      ok := true;
+      j := 1;
+      while ok and (j <= length(n)) do
+      begin
+         ok := h[i + j - 1] = n[j];
+         j := j + 1;
+      end;
+      if ok then
+      begin
+         naivepos := i;
+         i := length(h);
+      end;
+      i := i + 1;
+   end;
+end;
+
+function naiveround(const h : string) : integer;
+var
+   sum, k : integer;
+begin
+   sum := naivepos('needle', h, 1) + naivepos('-', h, 1) +
+          naivepos('abcdefghijabcdefghijabcdefghijabcdefghijneedle', h, 1);
+   k := naivepos('j', h, 1);
+   while k <> 0 do
+   begin
+      sum := sum + k;
+      k := naivepos('j', h, k + 100);
+   end;
+   naiveround := sum;
+end;
+
+function posround(const h : string) : integer;
+var
+   sum, k : integer;
+begin
+   sum := pos('needle', h) + pos('-', h) +
+          pos('abcdefghijabcdefghijabcdefghijabcdefghijneedle', h);
+   k := pos('j', h);
+   while k <> 0 do
+   begin
+      sum := sum + k;
+      k := posfrom('j', h, k + 100);
+   end;
+   posround := sum;
+end;
+
+begin
+   s := '';
+   for i := 1 to 24 do
+      s := s + 'abcdefghij';
+   s := s + 'needle-in-the-haystack';
+
+   naive := 0;
+   fast := 0;
+   t0 := clock;
+   for i := 1 to rounds do
+      naive := naive + naiveround(s);
+   t1 := clock;
+   for i := 1 to rounds do
+      fast := fast + posround(s);
+   t2 := clock;
+   writeln('naive: ', naive);
+   writeln('pos:   ', fast);
+   if paramcount > 0 then
+      writeln('naive ', t1 - t0, ' pos ', t2 - t1);
+end.
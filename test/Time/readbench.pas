@@ -0,0 +1,45 @@
+program readbench;
+
+var
+   f     : text;
+   s     : string;
+   ch    : char;
+   i, n  : integer;
+   lines : integer;
+   chars : integer;
+   sum   : integer;
+
+begin
+   assign(f, 'readbench.txt');
+   rewrite(f);
+   for i := 1 to 200000 do
+      writeln(f, i mod 1000, ' a line of text for the read benchmark ', i);
+   close(f);
+
+   reset(f);
+   lines := 0;
+   chars := 0;
+   sum := 0;
+   while not eof(f) do
+   begin
+      read(f, n);
+      readln(f, s);
+      sum := sum + n;
+      chars := chars + length(s);
+      lines := lines + 1;
+   end;
+   close(f);
+
+   reset(f);
+   while not eof(f) do
+   begin
+      while not eoln(f) do
+      begin
+         read(f, ch);
+         chars := chars + 1;
+      end;
+      readln(f);
+   end;
+   close(f);
+   writeln(lines, ' ', chars, ' ', sum);
+end.
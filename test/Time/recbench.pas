@@ -0,0 +1,57 @@
+program recbench;
+
+type
+   rec = record
+            key   : integer;
+            value : real;
+         end;
+
+var
+   f     : file of rec;
+   r     : rec;
+   block : array [1..4096] of rec;
+   i, j  : integer;
+   got   : integer;
+   sum   : longint;
+
+begin
+   assign(f, 'recbench.dat');
+   rewrite(f);
+   for i := 1 to 2000000 do
+   begin
+      r.key := i;
+      r.value := i / 4;
+      write(f, r);
+   end;
+   close(f);
+
+   sum := 0;
+   reset(f);
+   while not eof(f) do
+   begin
+      read(f, r);
+      sum := sum + r.key;
+   end;
+   close(f);
+
+   rewrite(f);
+   for i := 1 to 500 do
+   begin
+      for j := 1 to 4096 do
+      begin
+         block[j].key := j;
+         block[j].value := j / 4;
+      end;
+      BlockWrite(f, block, 4096);
+   end;
+   close(f);
+
+   reset(f);
+   repeat
+      BlockRead(f, block, 4096, got);
+      for j := 1 to got do
+         sum := sum + block[j].key;
+   until got < 4096;
+   close(f);
+   writeln(sum);
+end.
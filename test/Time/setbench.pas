@@ -0,0 +1,46 @@
+program setbench;
+
+type
+   bigset   = set of 0..511;
+   smallset = set of 0..255;
+
+var
+   a, b, c   : bigset;
+   x, y, z   : smallset;
+   i, j      : integer;
+   count     : integer;
+
+begin
+   a := [];
+   b := [];
+   for i := 0 to 511 do
+   begin
+      if i mod 3 = 0 then
+         a := a + [i];
+      if i mod 5 = 0 then
+         b := b + [i];
+   end;
+   x := [0..127];
+   y := [64..255];
+
+   count := 0;
+   for j := 1 to 2000000 do
+   begin
+      c := a + b;
+      c := c * a;
+      c := c - b;
+      if c = a - b then
+         count := count + 1;
+      if c <= a then
+         count := count + 1;
+      if c <> b then
+         count := count + 1;
+      z := x * y;
+      z := z + (x - y);
+      if z >= x then
+         count := count + 1;
+      if z = x then
+         count := count + 1;
+   end;
+   writeln(count);
+end.
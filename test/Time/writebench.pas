@@ -0,0 +1,40 @@
+program writebench;
+
+{ Writes the lines to a file, then reads them back to print how many there were and the last
+  one, so that the output can be checked. }
+
+var
+   f     : text;
+   i     : integer;
+   r     : real;
+   s     : string;
+   line  : string;
+   lines : integer;
+   chars : longint;
+
+begin
+   assign(f, 'writebench.txt');
+   rewrite(f);
+   s := 'record';
+   r := 0.5;
+   for i := 1 to 300000 do
+   begin
+      writeln(f, s, ' ', i, ': value=', r:1:3, ' scaled=', r * i, ' even=', not odd(i), ' ',
+              i mod 7:3);
+      r := r + 0.25;
+   end;
+   close(f);
+
+   reset(f);
+   lines := 0;
+   chars := 0;
+   while not eof(f) do
+   begin
+      readln(f, line);
+      lines := lines + 1;
+      chars := chars + length(line);
+   end;
+   close(f);
+   writeln(lines, ' ', chars);
+   writeln(line);
+end.
@@ -0,0 +1,6 @@
+All 65650
+Even 33150
+Again 130650
+Reused TRUE
+Object 15 19
+Object 3 19
@@ -0,0 +1,3 @@
+Lines 100000 sum 5000050000
+Position 15000
+Records 20000 sum 200010000
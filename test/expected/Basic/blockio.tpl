@@ -0,0 +1,3 @@
+Wrote 10
+1 0.5
+Read 1510 sum 1125805 eof TRUE
@@ -0,0 +1,9 @@
+55
+3 5
+1
+0 0
+1
+2 2
+1 9
+Xonst arguments are read only 42
+const arguments are read only 1
@@ -0,0 +1,7 @@
+   1  31  32  33  63  64 150 200
+0
+amnoz
+ 1 4
+ 0 1 2 3 4
+ 3 4 5 6 7
+xyz
@@ -0,0 +1,12 @@
+{
+  "allocations": 11,
+  "bytes": 560,
+  "peakLiveBytes": 560,
+  "liveBlocks": 6,
+  "liveBytes": 96,
+  "sites": [
+    {"site": "Basic/heapprof.pas:24", "allocations": 1, "bytes": 400, "frees": 1},
+    {"site": "Basic/heapprof.pas:19", "allocations": 10, "bytes": 160, "frees": 4}],
+  "live": [
+    {"site": "Basic/heapprof.pas:19", "blocks": 6, "bytes": 96}]
+}
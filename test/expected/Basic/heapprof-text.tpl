@@ -0,0 +1,6 @@
+Heap profile: 11 allocations, 560 bytes, peak live 560 bytes
+ Allocations          Bytes        Frees  Site
+           1            400            1  Basic/heapprof.pas:24
+          10            160            4  Basic/heapprof.pas:19
+Live at exit: 6 blocks, 96 bytes
+           6             96               Basic/heapprof.pas:19
@@ -0,0 +1 @@
+21
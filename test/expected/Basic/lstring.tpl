@@ -0,0 +1,13 @@
+abcdef abc 6 3
+Hello, World!
+100
+bcd
+less
+equal
+abcdef abcdef!
+[  abcdef]
+abcdef Abcdef Af
+ababcdefab 10
+ababcdefabababcdefab abcdef
+3 6 3 3 13
+old!
@@ -0,0 +1 @@
+Sum 4501500
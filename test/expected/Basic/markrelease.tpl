@@ -0,0 +1,3 @@
+Sum 50050000
+Reused TRUE
+Keep 42
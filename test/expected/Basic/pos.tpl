@@ -0,0 +1,16 @@
+1
+14
+7
+0
+0
+12
+10
+20
+0
+7
+9
+27
+0
+1
+46
+50 
@@ -0,0 +1,10 @@
+i=-2147483648 l=9223372036854775807
+r=3.141593
+r=15000000000.0
+d=7
+i=42
+123 0
+123 3
+123 1
+-9223372036854775808 0
+0.0025 0
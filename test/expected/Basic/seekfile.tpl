@@ -0,0 +1,16 @@
+Empty -1
+Last 999 at 1000
+Wrote at 11
+999: 2997 249.75 at 999
+10: -1 -1.00 at 10
+123: 369 30.75 at 123
+Put at 21
+21: 77 5.00 at 21
+500: 1500 125.00 at 500
+10: -1 -1.00 at 10
+Next 33 at 11
+Sum 5991 at 1000 of 1000
+Appended at 1001 of 1001
+Wrote at 4 of 1001
+3: -3 0.00 at 3
+1000: 5000 0.00 at 1000
@@ -0,0 +1,3 @@
+10 4 0
+555
+aeiou
@@ -0,0 +1,6 @@
+ 198  TRUE
+   1  TRUE
+   0  TRUE
+  35  TRUE
+ 256
+  95
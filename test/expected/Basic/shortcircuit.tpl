@@ -0,0 +1,10 @@
+FALSE 1
+TRUE 1
+FALSE 2
+TRUE 2
+FALSE 1
+TRUE 1
+TRUE 5
+TRUE TRUE
+4
+6
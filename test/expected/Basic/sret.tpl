@@ -0,0 +1,11 @@
+1 2 2 1
+3 4
+fedcba
+zyx 5
+TRUE FALSE TRUE
+8 7
+lacol
+hello
+ello
+o
+0
@@ -0,0 +1,7 @@
+ 1 1 2 3 0 4 5 6 0
+if statement
+longest
+other 256
+keyword
+letter
+other 0
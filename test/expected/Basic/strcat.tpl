@@ -0,0 +1,5 @@
+abcXY!defabc 12
+abcXY!defabcXY!
+XYabcXY!defabcXY!XY
+255
+abc-XY-!
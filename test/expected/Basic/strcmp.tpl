@@ -0,0 +1,8 @@
+TRUE FALSE FALSE TRUE FALSE TRUE
+FALSE TRUE TRUE TRUE FALSE FALSE
+FALSE TRUE FALSE FALSE TRUE TRUE
+FALSE TRUE TRUE TRUE FALSE FALSE
+TRUE FALSE FALSE TRUE FALSE TRUE
+TRUE FALSE TRUE FALSE
+TRUE TRUE TRUE
+TRUE TRUE TRUE FALSE
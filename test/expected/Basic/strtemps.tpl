@@ -0,0 +1,6 @@
+seiraropmet
+11
+two
+a-b-c-d-e-
+set ok
+TRUE
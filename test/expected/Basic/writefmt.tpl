@@ -0,0 +1,12 @@
+[-42][   -42][-42]
+[1234567890123][   1234567890123]
+[ 3.141590E+00][ 3.142E+00][3.14][    3.142][-3.1415900000000E+00]
+[ 1.000000E+10][ 0.000000E+00][-1.500000E-07][ 1.000000E+300][ 9.999999E+04]
+[x][  x][TRUE][  TRUE][TRUE]
+[hello][hello]
+[abcde][  abcde][abc]
+no newline
+
+-42 3.1 TRUE x hello
+[ab][  ab][he]
+0.5000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000
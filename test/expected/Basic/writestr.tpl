@@ -0,0 +1,12 @@
+i=42 r=3.142 ok=TRUE
+[   42][  ab][  x]
+[    3.14]
+-123
+1234567890123
+1234567890123!1234567890123
+long 84 7
+0
+[abc][  de][  TRUE][    3.14][42]
+[abc][  de][  TRUE][    3.14][42]
+302 <42>
+604 >
@@ -0,0 +1 @@
+CompErr/constmod.pas:5:9: Error: Can't modify const argument 's'
@@ -0,0 +1 @@
+CompErr/lstrrec.pas:12:1: Error: AnsiString can't be inside a record, class, array, file or pointer, in 'who'
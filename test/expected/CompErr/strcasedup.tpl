@@ -0,0 +1 @@
+CompErr/strcasedup.pas:9:17: Error: Duplicate case label 'b'
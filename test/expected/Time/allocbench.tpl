@@ -0,0 +1 @@
+1000010242500
@@ -0,0 +1 @@
+9324
@@ -0,0 +1 @@
+125000750001000000 15625031250.000
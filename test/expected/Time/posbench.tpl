@@ -0,0 +1,2 @@
+naive: 203800000
+pos:   203800000
@@ -0,0 +1 @@
+200000 18355790 99900000
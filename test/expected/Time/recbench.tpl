@@ -0,0 +1 @@
+2004196328000
@@ -0,0 +1 @@
+10000000
@@ -0,0 +1,2 @@
+300000 19494463
+record 300000: value=75000.250 scaled= 2.250008E+10 even=TRUE   1
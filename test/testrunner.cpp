@@ -166,6 +166,94 @@ bool TimeTestCase::Result() {
     return true;
 }
 
+/* Class that confirms the generated code runs "fast enough" */
+class BenchTestCase : public TestCase {
+  public:
+    BenchTestCase(const std::string &nm, const std::string &src, const std::string &arg);
+    virtual bool        Result();
+    virtual bool        Run();
+    virtual std::string Dir() { return "Time"; }
+
+  private:
+    long                                               maxTime; // In milliseconds.
+    std::chrono::time_point<std::chrono::steady_clock> start, end;
+};
+
+BenchTestCase::BenchTestCase(const std::string &nm, const std::string &src, const std::string &arg)
+    : TestCase(nm, src, ""), maxTime(std::stol(arg)) {}
+
+bool BenchTestCase::Run() {
+    start = std::chrono::steady_clock::now();
+
+    bool res = TestCase::Run();
+
+    end = std::chrono::steady_clock::now();
+    return res;
+}
+
+bool BenchTestCase::Result() {
+    long elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+    std::cout << "Benchmark " << source << " " << elapsed << " ms" << std::endl;
+    if (elapsed > maxTime) {
+        std::cerr << "Took too long to run  " << source << " " << std::fixed
+                  << std::setprecision(3) << elapsed << " ms" << std::endl;
+        return false;
+    }
+    // A benchmark with an expected output also has its output checked.
+    std::string tplname = "expected/" + Dir() + "/" + replace_ext(source, ".pas", ".tpl");
+    if (std::ifstream(tplname)) {
+        return TestCase::Result();
+    }
+    return true;
+}
+
+/* Class that runs the program with the heap profiler on, and checks the profile as well as
+ * the output. */
+class HeapProfileTestCase : public TestCase {
+  public:
+    HeapProfileTestCase(const std::string &nm, const std::string &src, const std::string &arg);
+    virtual void Clean();
+    virtual bool Run();
+    virtual bool Result();
+
+  private:
+    std::string ProfileName() const;
+
+  private:
+    std::string format; // "text" or "json".
+};
+
+HeapProfileTestCase::HeapProfileTestCase(const std::string &nm, const std::string &src,
+                                         const std::string &arg)
+    : TestCase(nm, src, ""), format(arg) {}
+
+std::string HeapProfileTestCase::ProfileName() const {
+    return replace_ext(source, ".pas", "-" + format + ".prof");
+}
+
+void HeapProfileTestCase::Clean() {
+    TestCase::Clean();
+    std::string profname = Dir() + "/" + ProfileName();
+    remove(profname.c_str());
+}
+
+bool HeapProfileTestCase::Run() {
+    std::string exename = replace_ext(source, ".pas", "");
+    std::string resname = replace_ext(source, ".pas", ".res");
+    if (RunCmd("cd " + Dir() + "; LACSAP_HEAP_PROFILE=" + format +
+               " LACSAP_HEAP_PROFILE_FILE=" + ProfileName() + " ./" + exename + " > " +
+               resname)) {
+        return false;
+    }
+    return true;
+}
+
+bool HeapProfileTestCase::Result() {
+    std::string profname = Dir() + "/" + ProfileName();
+    std::string tplname = "expected/" + Dir() + "/" + replace_ext(ProfileName(), ".prof", ".tpl");
+    return TestCase::Result() && Diff(profname + " " + tplname);
+}
+
 // Class to test compile detection of errors.
 class CompileTimeError : public TestCase {
   public:
@@ -207,6 +295,14 @@ TestCase *TestCaseFactory(const std::string &type, const std::string &name,
         return new TimeTestCase(name, source, args);
     }
 
+    if (type == "Bench") {
+        return new BenchTestCase(name, source, args);
+    }
+
+    if (type == "HeapProfile") {
+        return new HeapProfileTestCase(name, source, args);
+    }
+
     if (type == "CompErr") {
         return new CompileTimeError(name, source, args);
     }
@@ -287,10 +383,14 @@ TestEntry testCaseList[] = {
     {LACSAP_ONLY, "Basic", "Case", "case.pas", ""},
     {0, "Basic", "Case 2", "case2.pas", " < case2.in"},
     {0, "Basic", "CaseCompat", "casecompat.pas", ""},
+    {0, "Basic", "String Case", "strcase.pas", ""},
     {0, "Basic", "TestSet", "testset.pas", ""},
     {0, "Basic", "TestSet 2", "testset2.pas", ""},
     {LACSAP_ONLY, "Basic", "TestSet 3", "testset3.pas", ""},
     {0, "Basic", "SetTest", "set_test.pas", ""},
+    {0, "Basic", "Set Range", "setrange.pas", ""},
+    {0, "Basic", "For in", "forin.pas", ""},
+    {0, "Basic", "Set In", "setin.pas", ""},
     {0, "Basic", "Record Pass", "recpass.pas", ""},
     // Random numbers are diferent
     {LACSAP_ONLY, "Basic", "Random Number", "randtest.pas", ""},
@@ -312,6 +412,12 @@ TestEntry testCaseList[] = {
     {0, "Basic", "C func name", "cfuncname.pas", ""},
     {0, "Basic", "MT 19937", "mt.pas", ""},
     {0, "Basic", "String", "str.pas", ""},
+    {0, "Basic", "Long String", "lstring.pas", ""},
+    {0, "Basic", "String Concat", "strcat.pas", ""},
+    {0, "Basic", "String Compare", "strcmp.pas", ""},
+    {0, "Basic", "WriteStr", "writestr.pas", ""},
+    {0, "Basic", "Pos", "pos.pas", ""},
+    {0, "Basic", "String Temporaries", "strtemps.pas", ""},
     {0, "Basic", "Linked List", "list.pas", ""},
     {0, "Basic", "Whetstone", "whet.pas", ""},
     {0, "Basic", "Variant Record", "variant.pas", ""},
@@ -325,6 +431,16 @@ TestEntry testCaseList[] = {
     {0, "Basic", "Set Values 2", "set2.pas", ""},
     {0, "Basic", "Set Values 3", "set3.pas", ""},
     {0, "Basic", "Set Values 4", "set4.pas", ""},
+    {LACSAP_ONLY, "Basic", "Block read/write", "blockio.pas", ""},
+    {LACSAP_ONLY, "Basic", "Seek and map files", "seekfile.pas", ""},
+    {LACSAP_ONLY, "Basic", "Background file I/O", "asyncio.pas", ""},
+    {LACSAP_ONLY, "Basic", "Many files", "manyfiles.pas", ""},
+    // Checks that disposed memory is used again.
+    {LACSAP_ONLY, "Basic", "New and dispose", "alloc.pas", ""},
+    {LACSAP_ONLY, "Basic", "Mark and release", "markrelease.pas", ""},
+    // Free Pascal has no heap profiler like this.
+    {LACSAP_ONLY, "HeapProfile", "Heap profile text", "heapprof.pas", "text"},
+    {LACSAP_ONLY, "HeapProfile", "Heap profile json", "heapprof.pas", "json"},
     // Free Pascal doesn't support popcount!
     {LACSAP_ONLY, "Basic", "Pop Count", "popcnt.pas", ""},
     {0, "Basic", "Sudoku", "sudoku.pas", ""},
@@ -354,8 +470,11 @@ TestEntry testCaseList[] = {
     {LACSAP_ONLY, "Basic", "Function arg5", "func5.pas", ""},
     {LACSAP_ONLY, "Basic", "Function arg6", "func6.pas", ""},
     {LACSAP_ONLY, "Basic", "Function arg7", "func7.pas", ""},
+    {0, "Basic", "Const Arguments", "constarg.pas", ""},
+    {0, "Basic", "Function Results", "sret.pas", ""},
     {0, "Basic", "Multiple decl", "multidecl.pas", ""},
     {0, "Basic", "Numeric", "numeric.pas", ""},
+    {0, "Basic", "Short Circuit", "shortcircuit.pas", ""},
     {0, "Basic", "Goto", "goto.pas", ""},
     {0, "Basic", "GPC t03", "t03.pas", ""},
     {0, "Basic", "GPC t04", "t04.pas", ""},
@@ -373,6 +492,8 @@ TestEntry testCaseList[] = {
     {LACSAP_ONLY, "Basic", "ISO 7185 PAT", "iso7185pat.pas", ""},
     {0, "Basic", "Const Expr", "consts.pas", ""},
     {0, "Basic", "Read char array", "readchars.pas", "< readchars.txt"},
+    {0, "Basic", "Read numbers", "readnum.pas", "< readnum.txt"},
+    {0, "Basic", "Write Format", "writefmt.pas", ""},
     {0, "Basic", "Game of life", "gol.pas", "< gol.txt"},
     {0, "Basic", "Inline", "inline.pas", ""},
     {0, "Basic", "Val", "val.pas", "12345 42"},
@@ -384,6 +505,16 @@ TestEntry testCaseList[] = {
 
     // Check that compiler doesn't get too slow.
     {0, "Time", "LongCompile", "longcompile.pas", "1000"},
+
+    // Check that generated code doesn't get too slow.
+    {LACSAP_ONLY, "Bench", "Set Bench", "setbench.pas", "5000"},
+    {LACSAP_ONLY, "Bench", "Pos Bench", "posbench.pas", "5000"},
+    {LACSAP_ONLY, "Bench", "List Bench", "listbench.pas", "5000"},
+    {LACSAP_ONLY, "Bench", "Write Bench", "writebench.pas", "5000"},
+    {LACSAP_ONLY, "Bench", "Read Bench", "readbench.pas", "5000"},
+    {LACSAP_ONLY, "Bench", "Number Bench", "numbench.pas", "5000"},
+    {LACSAP_ONLY, "Bench", "Record Bench", "recbench.pas", "5000"},
+    {LACSAP_ONLY, "Bench", "Alloc Bench", "allocbench.pas", "5000"},
 };
 
 // Keep "negative" tests in a separate category
@@ -406,6 +537,9 @@ TestEntry negativeCaseList[] = {
     {0, "CompErr", "Wrong args 2", "wrongargs2.pas", ""},
     {0, "CompErr", "Wrong args 3", "wrongargs3.pas", ""},
     {0, "CompErr", "Wrong args 4", "wrongargs4.pas", ""},
+    {0, "CompErr", "AnsiString in record", "lstrrec.pas", ""},
+    {0, "CompErr", "String case duplicate", "strcasedup.pas", ""},
+    {0, "CompErr", "Modify const arg", "constmod.pas", ""},
 };
 
 void runTestCases(const std::vector<TestCase *> &tc, TestResult &res, const std::string &options) {